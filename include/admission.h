@@ -0,0 +1,100 @@
+// overload protection: connection watermark and queue-delay based (CoDel style) shedding
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "config.h"
+#include "metrics.h"
+
+/*
+Two tiers of protection, both decided before any request bytes are read:
+
+1. Watermark. Connections accepted but not yet closed are counted. Past max_connections a new
+   connection is closed right after accept, which is the cheapest possible rejection.
+
+2. Queue delay. When a pool worker picks up a connection, the time it waited since accept (its
+   sojourn time) is checked the way CoDel manages a packet queue. Every interval the smallest sojourn
+   seen in that interval is compared to the target. A queue that never drained below the target is a
+   standing queue, so the controller switches to overloaded. While overloaded, connections that waited
+   longer than the target get a pre-rendered 503 with Retry-After instead of being served. Otherwise
+   only connections that waited longer than a whole interval are shed.
+
+The queue delay check only applies where the server has a queue of its own (the thread pool).
+*/
+
+/**
+ * Reads the limits from config and pre-renders the 503 response. Must be called once before any other
+ * admission_* function, and again with the new configuration after a reload. A config->max_connections
+ * of 0 is replaced by 90% of RLIMIT_NOFILE.
+ *
+ * Args:
+ *    server_config *config: server configuration
+ */
+void admission_init(server_config *config);
+
+/**
+ * Registers a freshly accepted connection.
+ *
+ * Returns:
+ *    true if it may be served (call admission_connection_closed when it is closed), false if the
+ *    watermark is exceeded and the caller must close it right away
+ */
+bool admission_connection_opened(void);
+
+/**
+ * Must be called once for every connection admission_connection_opened accepted, when it is closed.
+ */
+void admission_connection_closed(void);
+
+/**
+ * Returns:
+ *    number of connections admitted and not closed yet, including those waiting in a queue
+ */
+unsigned int admission_in_flight(void);
+
+/**
+ * Decides whether a connection picked up from the work queue should be shed. Uses the time since
+ * PHASE_ACCEPT on timing as its queue delay.
+ *
+ * Args:
+ *    const request_timing *timing: timing of the connection, PHASE_ACCEPT must be recorded
+ *
+ * Returns:
+ *    true if the connection should get send_overload_response instead of being served
+ */
+bool admission_should_shed(const request_timing *timing);
+
+/**
+ * Counts a connection that was dropped because accept() failed with EMFILE/ENFILE.
+ */
+void admission_record_fd_limit_drop(void);
+
+/**
+ * Sends the pre-rendered 503 response without blocking and stops reading from client_fd. The caller
+ * still closes client_fd.
+ *
+ * Args:
+ *    int client_fd: client connection
+ *
+ * Returns:
+ *    bytes sent, -1 on error
+ */
+ssize_t send_overload_response(int client_fd);
+
+/**
+ * Renders the admission counters. Matches metrics_section_fn.
+ *
+ * Args:
+ *    char *buf: destination buffer
+ *    size_t size: size of buf
+ *    void *ctx: unused
+ *
+ * Returns:
+ *    number of bytes written (excluding the null terminator), truncated to size - 1
+ */
+size_t admission_render_stats(char *buf, size_t size, void *ctx);
+
+#endif
@@ -0,0 +1,46 @@
+// pinning threads to CPUs, which also keeps their memory on the local NUMA node
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+/*
+With CpuAffinity set, thread i (a pool worker, or an acceptor in reuseport and io_uring mode) is
+pinned to the i-th CPU of the configured list, wrapping around. Linux places a page on the NUMA node
+of the CPU that first touches it, so a thread that is pinned before it sets up its queues, receive
+buffers and stack gets all of them from its local node without needing libnuma.
+
+Pinning is Linux only. Elsewhere the setting is ignored with a warning.
+*/
+
+#define AFFINITY_MAX_CPUS 1024
+
+/**
+ * Sets the CPU list threads started from now on are pinned to. Threads that already run keep their
+ * CPU. Safe to call again on a configuration reload.
+ *
+ * Args:
+ *    const char *spec: "none" (or NULL/empty) to disable pinning, "auto" for every CPU this process
+ *                      may run on, or a list such as "0-7,16-23"
+ *
+ * Returns:
+ *    number of CPUs in the list, 0 if pinning is disabled, -1 if spec is invalid (pinning disabled)
+ */
+int affinity_configure(const char *spec);
+
+/**
+ * Returns:
+ *    the CPU thread index is pinned to, -1 if pinning is disabled
+ */
+int affinity_cpu(unsigned int index);
+
+/**
+ * Pins the calling thread to the CPU for index.
+ *
+ * Args:
+ *    unsigned int index: thread index (wraps around the CPU list)
+ *
+ * Returns:
+ *    the CPU on success, -1 if pinning is disabled or failed
+ */
+int affinity_pin_thread(unsigned int index);
+
+#endif
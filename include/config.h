@@ -3,18 +3,50 @@
 
 #include <stdbool.h>
 
+#include "logger.h"
+#include "router.h"
 
 typedef struct {
     char *port;                // Port to listen on
     char *document_root;       // Path to web document root directory. Must end with a forward slash 
     char *cgi_bin_path;        // Path to CGI scripts directory
     char * server_name;        // Official name of the server
+    char * mime_types_file;    // mime.types file extending the built-in MIME types (NULL for only the built-in ones)
     bool enable_logging;       // Whether to enable logging
     char *log_directory;       // Directory for log files
+    log_level_t log_level;     // Lowest level that is logged
     char * dynamic_dir_name; // Name of directory containing dynamic content
     char * static_dir_name; // Name of directory containing static contant
     unsigned int thread_pool_size;  // Number of worker threads (for threaded version)
     unsigned int connection_timeout; // Connection timeout in seconds
+    unsigned int keepalive_timeout;  // Seconds a connection may sit idle before the first byte of a request
+    unsigned int header_timeout;     // Seconds from the first byte of a request to the end of its headers
+    unsigned int send_timeout;       // Seconds a response may go without write progress
+    unsigned int drain_timeout;      // Seconds in-flight connections get to finish on shutdown or upgrade
+    bool reuseport_listeners;  // One SO_REUSEPORT listening socket and acceptor per worker thread instead of a single listener
+    bool reuseport_cpu_steering; // Steer connections to the listener matching the CPU that received them (reuseport mode only)
+    bool io_uring_engine;      // Serve connections from an io_uring event loop instead of the blocking accept loop (Linux only)
+    char * cpu_affinity;       // CPUs worker threads are pinned to ("none", "auto" or a list like "0-7,16-23")
+    unsigned int path_cache_entries; // Entries of the resolved path and stat cache (0 disables it)
+    unsigned int path_cache_ttl;     // Seconds a cached stat result is trusted
+    unsigned int path_cache_missing_ttl; // Seconds a cached missing path is trusted (0 does not cache them)
+    bool path_cache_watch;     // Drop cached paths when anything below DocumentRoot changes (Linux only)
+    bool path_cache_bloom;     // Answer lookups of paths that do not exist from a bloom filter of DocumentRoot
+    char * status_uri;         // Reserved URI that serves aggregated request statistics (NULL disables it)
+    unsigned int slow_request_threshold_ms; // Requests slower than this get a full phase breakdown logged (0 disables)
+    bool admission_control;    // Shed queued connections with a 503 when the queue delay shows overload
+    unsigned int admission_target_ms;   // Acceptable queue delay
+    unsigned int admission_interval_ms; // Window the queue delay must stay above target to count as overload
+    unsigned int max_connections;       // Connections closed right after accept beyond this many (0 = 90% of the fd limit)
+    unsigned int retry_after;           // Seconds sent in the Retry-After header of shed requests
+    unsigned int listen_backlog;        // Length of the listening socket's accept queue
+    bool tcp_nodelay;                   // Disable Nagle's algorithm on client connections
+    unsigned int defer_accept;          // Seconds the kernel holds a connection until it sends data (0 disables, Linux only)
+    unsigned int fastopen_queue;        // Pending TCP Fast Open requests (0 disables)
+    unsigned int send_buffer;           // SO_SNDBUF of client connections in bytes (0 = kernel default)
+    unsigned int recv_buffer;           // SO_RCVBUF of client connections in bytes (0 = kernel default)
+    bool tcp_cork;                      // Cork client sockets while a response is written so it goes out in full segments
+    route_table * routes;      // Compiled [Routes] section plus the routes implied by DynamicDirName and StatusUri
     // Other configuration parameters
 } server_config;
 
@@ -27,4 +59,49 @@ bool config_load(server_config *config, const char *filename);
 // Free allocated resources
 void config_cleanup(server_config *config);
 
+/*
+Configuration snapshots for live reloads. Everything that serves a connection acquires the current
+snapshot when the connection is accepted and releases it when the connection is closed, so a reload
+never changes settings under a request in progress. A reload loads a whole new snapshot and
+publishes it. The previous one is freed once the last connection using it releases it.
+
+Snapshots are never modified after they are published.
+*/
+
+/**
+ * Allocates a snapshot with default values and loads filename into it.
+ *
+ * Args:
+ *    const char *filename: configuration file
+ *
+ * Returns:
+ *    unpublished snapshot, NULL if the file could not be loaded
+ */
+server_config *config_snapshot_load(const char *filename);
+
+/**
+ * Makes config the current snapshot. Takes over the caller's reference, the previous snapshot is
+ * released.
+ *
+ * Args:
+ *    server_config *config: snapshot from config_snapshot_load, NULL to drop the current one at shutdown
+ */
+void config_snapshot_publish(server_config *config);
+
+/**
+ * Returns:
+ *    a new reference to the current snapshot (pass it to config_snapshot_release when done),
+ *    NULL if none was published
+ */
+server_config *config_snapshot_acquire(void);
+
+/**
+ * Drops a reference taken by config_snapshot_load or config_snapshot_acquire. The snapshot is freed
+ * once it is neither current nor referenced.
+ *
+ * Args:
+ *    server_config *config: snapshot (may be NULL)
+ */
+void config_snapshot_release(server_config *config);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,56 @@
+// listening socket handoff between an old and a new server process (zero-downtime upgrade)
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+/*
+On SIGUSR2 the running server starts a new copy of its binary. The child inherits the listening
+sockets across fork/exec, and their descriptor numbers are passed in TURINGBOLT_LISTEN_FDS
+(comma separated). Once the new process is accepting, it writes one byte to the pipe named in
+TURINGBOLT_READY_FD. The old process then stops accepting, drains its in-flight connections and
+exits. Both processes accept from the same sockets, so connections that arrive during the switch
+wait in the kernel backlog and none are refused.
+
+If the new process fails to start or does not report ready within HANDOFF_READY_TIMEOUT_MS, the old
+process keeps serving.
+*/
+
+#define HANDOFF_LISTEN_FDS_ENV   "TURINGBOLT_LISTEN_FDS"
+#define HANDOFF_READY_FD_ENV     "TURINGBOLT_READY_FD"
+#define HANDOFF_MAX_LISTENERS    256
+#define HANDOFF_READY_TIMEOUT_MS 10000
+
+/**
+ * Collects the listening sockets passed down by a previous server process and removes the handoff
+ * variables from the environment, so CGI scripts don't see them.
+ *
+ * Args:
+ *    int *fds: receives the inherited descriptors
+ *    int max: capacity of fds
+ *
+ * Returns:
+ *    number of inherited listening sockets, 0 if this process was not started by a handoff
+ */
+int handoff_inherited_listeners(int *fds, int max);
+
+/**
+ * Tells the previous server process (if any) that this one is accepting. Safe to call when there is
+ * no previous process.
+ */
+void handoff_notify_ready(void);
+
+/**
+ * Starts executable as the successor of this process, handing it the listening sockets, and waits
+ * until it reports ready.
+ *
+ * Args:
+ *    const char *executable: absolute path of the server binary to run
+ *    char **argv: argument vector for the new process
+ *    const int *fds: listening sockets to hand over
+ *    int count: number of listening sockets
+ *
+ * Returns:
+ *    0 once the successor is accepting, -1 if it could not be started or never reported ready
+ */
+int handoff_spawn_successor(const char *executable, char **argv, const int *fds, int count);
+
+#endif
@@ -2,9 +2,14 @@
 #ifndef HTTP_PARSER
 #define HTTP_PARSER
 #include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
 
 #include "../include/config.h"
 #include "../include/rio.h"
+#include "../include/metrics.h"
+#include "../include/timer_wheel.h"
+#include "../include/mime.h"
 
 #define MAX_URI_LENGTH 4096
 
@@ -18,52 +23,96 @@ typedef enum {
     TRACE
 } HTTP_METHOD;
 
-typedef enum {
-    TEXT_HTML,
-    TEXT_PLAIN,
-    TEXT_CSS,
-    APPLICATION_JAVASCRIPT,
-    APPLICATION_JSON,
-    APPLICATION_XML,
-    APPLICATION_PDF,
-    APPLICATION_ZIP,
-    APPLICATION_POSTSCRIPT,
-    IMAGE_GIF,
-    IMAGE_PNG,
-    IMAGE_JPEG,
-    IMAGE_SVG,
-    AUDIO_MPEG,
-    AUDIO_WAV,
-    VIDEO_MP4,
-    VIDEO_WEBM,
-    FONT_WOFF,
-    FONT_WOFF2,
-    APPLICATION_OCTET_STREAM
-} MIME_TYPE;
-
 typedef enum {
     HTTP_1_0,
     HTTP_1_1
 } HTTP_VERSION;
 
+/*
+A slice of the request buffer: the parser tokenizes the request in place instead of copying tokens out.
+Not NUL terminated, and only valid as long as the buffer the request was parsed from
+*/
+typedef struct {
+    const char *data;
+    size_t length;
+} str_view;
+
+static inline bool str_view_equals(str_view view, const char *text) {
+    size_t length = strlen(text);
+    return view.length == length && memcmp(view.data, text, length) == 0;
+}
+
+#define MAX_REQUEST_HEADERS 64 // requests with more header lines are rejected
+
+/*
+Headers the server looks up by ID. Their names are recognized while the header is parsed, by a hash
+computed in the same pass that finds the colon, so a lookup is an array index instead of a scan
+*/
+typedef enum {
+    HEADER_OTHER,             // any header not listed below
+    HEADER_HOST,
+    HEADER_CONNECTION,
+    HEADER_KEEP_ALIVE,
+    HEADER_UPGRADE,
+    HEADER_CONTENT_LENGTH,
+    HEADER_CONTENT_TYPE,
+    HEADER_TRANSFER_ENCODING,
+    HEADER_EXPECT,
+    HEADER_RANGE,
+    HEADER_IF_RANGE,
+    HEADER_IF_NONE_MATCH,
+    HEADER_IF_MODIFIED_SINCE,
+    HEADER_ACCEPT,
+    HEADER_ACCEPT_ENCODING,
+    HEADER_USER_AGENT,
+    HEADER_COOKIE,
+    HEADER_REFERER,
+    HEADER_AUTHORIZATION,
+    HEADER_ID_COUNT
+} HEADER_ID;
+
+typedef struct {
+    str_view name;            // as sent by the client
+    str_view value;           // without surrounding whitespace
+    HEADER_ID id;
+} http_header;
+
+typedef struct {
+    http_header entries[MAX_REQUEST_HEADERS]; // in the order they were received
+    int count;
+    unsigned char known[HEADER_ID_COUNT];     // 1 + index in entries of the first header with that ID, 0 if absent
+} header_table;
+
 typedef struct {
     HTTP_VERSION version;
     MIME_TYPE mime_type;
+    const mime_entry *mime; // Content-Type of the path, mime_type is mime->type
     HTTP_METHOD method;
-    char* path;           // The absolute file path
-    bool is_dynamic;      // Flag indicating if this is a dynamic request
-    char** param_names;   // Array of parameter names (if dynamic)
-    char** param_values;  // Array of parameter values (if dynamic)
-    int param_count;      // Number of parameters
+    str_view method_name; // Method token of the request line
+    str_view version_name; // Version token of the request line
+    char* path;           // Decoded request path. Points into the parsed buffer, NUL terminated in place
+    str_view query;       // Query string after the '?' as sent, not decoded (empty if there is none)
+    header_table headers; // Request headers, views into the parsed buffer
+    bool is_dynamic;      // Flag indicating if this is a dynamic request (its route is a CGI route)
+    const route* route;   // Route of the path, owned by the config snapshot. NULL if none matches (served as static)
+    str_view* param_names;  // Decoded parameter names, NULL until parse_query_params is called
+    str_view* param_values; // Decoded parameter values, NULL until parse_query_params is called
+    int param_count;      // Number of parameters, 0 until parse_query_params is called
+    bool params_parsed;   // Whether parse_query_params has filled the three fields above
+    request_timing* timing; // Phase timestamps of this request. Not owned, may be NULL
+    timer_entry* deadline;  // Send-stall deadline, refreshed before every write of the response. Not owned, may be NULL
 }http_request;
 
 /*
-parses request line -  METHOD URI HTTP_VERSION. Assumes that rio_buf * request adheres to the syntax and throws an exception otherwise
+parses request line -  METHOD URI HTTP_VERSION. The request is tokenized in place: client_request is
+modified and the path and views in request point into it, so it must outlive request.
 
 Args
-    rio_buf * request : buffer in which the http request is stored
+    char * client_request : NUL terminated request read from the client
+    http_request * request : request to fill
+    server_config * config : server configuration settings
 Returns
-    
+    request on success, NULL if the request is malformed or not supported
 */
 http_request * parse_http_request(char * client_request, http_request * request, server_config * config);
 
@@ -71,13 +120,14 @@ http_request * parse_http_request(char * client_request, http_request * request,
 int parse_request_line(char * request_line, http_request * request);
 
 /**
- * Parses URI to fill the following fields of request:
+ * Parses URI in place to fill the following fields of request (they point into URI afterwards):
  * 1. path: relative path of the requested file (wrt to the server document root)
- * 2. mime_type: MIME_TYPE determines if file is dynamic or static
- * 3. is_dynamic: flag indicating if this is a dynamic request
- * 4. param_names: array of parameter names (if dynamic)
- * 5. param_values: array of parameter values (if dynamic)
- * 6. param_count: number of parameters
+ * 2. mime_type: MIME_TYPE of the requested file
+ * 3. route: route of the path in config->routes (see router.h)
+ * 4. is_dynamic: flag indicating if this is a dynamic request
+ * 5. query: query string (if any), left encoded
+ *
+ * Only the path is decoded. The parameters are not split out here, see parse_query_params.
  * 
  * Args:
  *    char *URI: URI from the HTTP request
@@ -89,11 +139,62 @@ int parse_request_line(char * request_line, http_request * request);
  */
 int parse_uri(char * URI, http_request * request, server_config * config);
 
+/**
+ * Splits request->query into decoded name/value pairs and stores them in param_names, param_values
+ * and param_count. The work is done on the first call only, later calls return the stored count.
+ * request->query itself is not modified, the parameters point into a copy owned by the request.
+ *
+ * Args:
+ *    http_request *request: request filled by parse_uri
+ *
+ * Returns:
+ *    number of parameters, -1 on error
+ */
+int parse_query_params(http_request * request);
+
+
+/**
+ * Parses the header lines that follow the request line in a single pass, up to the empty line that
+ * ends them (or the end of the string). Names and values are stored as views into headers, nothing
+ * is copied or allocated.
+ *
+ * Args:
+ *    const char *headers: first header line, NUL terminated
+ *    header_table *table: table to fill
+ *
+ * Returns:
+ *    0 on success, -1 if a line is malformed or there are more than MAX_REQUEST_HEADERS
+ */
+int parse_request_headers(const char * headers, header_table * table);
+
+/**
+ * Returns:
+ *    value of the first header with the given ID, NULL if the request has none
+ */
+static inline const str_view * get_request_header(const header_table * table, HEADER_ID id) {
+    unsigned char slot = table->known[id];
+    return slot ? &table->entries[slot - 1].value : NULL;
+}
 
-int parse_request_headers(rio_buf * request);
+/**
+ * Looks up a header that has no ID by its name (case insensitive), scanning the table.
+ *
+ * Returns:
+ *    value of the first header named name, NULL if the request has none
+ */
+const str_view * find_request_header(const header_table * table, const char * name);
 
 int url_decode(char * str);
 
+/**
+ * Normalizes a decoded request path in place: collapses "//", drops "." and resolves ".." segments.
+ *
+ * Returns:
+ *    0 on success, -1 if the path does not start with '/', contains control characters or ".."
+ *    would leave the root
+ */
+int normalize_path(char * path);
+
 /*
 Returns the MIME type of a file with the passed path
 */
@@ -102,9 +203,8 @@ MIME_TYPE get_mime_type(const char *path);
 /**
  * @brief 
  * Free's all dynamically allocated members of request : 
- * 1. path
- * 2. param_names
- * 3. param_values
+ * 1. the parameters allocated by parse_query_params (param_names and param_values)
+ * The path and the views point into the parsed buffer, which the caller owns.
  * 
  * It is assumed that request itself is statically allocated by the caller or if dynamically 
  * allocated - it is free'd by the called
@@ -44,18 +44,42 @@ typedef enum {
     LOG_ERROR
 } log_level_t;
 
-static const char* level_names[] = {
-    "DEBUG",
-    "INFO",
-    "WARN",
-    "ERROR"
-};
+// Messages below this level are dropped. Changed at runtime through log_set_level
+extern int log_min_level;
+
+/**
+ * Sets the lowest level that is logged. Safe to call while other threads log.
+ *
+ * Args:
+ *    log_level_t level: lowest level to log
+ */
+void log_set_level(log_level_t level);
+
+/**
+ * Returns:
+ *    name of level as it appears in log lines ("DEBUG", "INFO", "WARN" or "ERROR")
+ */
+const char *log_level_name(log_level_t level);
+
+/**
+ * Parses a level name (DEBUG, INFO, WARN or ERROR, case insensitive).
+ *
+ * Args:
+ *    const char *name: level name
+ *    log_level_t *level: receives the level
+ *
+ * Returns:
+ *    0 on success, -1 if name is not a level
+ */
+int log_parse_level(const char *name, log_level_t *level);
 
 #define LOG(level, fmt, ...) do { \
+    if ((int)(level) < __atomic_load_n(&log_min_level, __ATOMIC_RELAXED)) break; \
     time_t now = time(NULL); \
+    struct tm now_tm; \
     char time_str[20]; \
-    strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", localtime(&now)); \
-    fprintf(stderr, "[%s] [%s] [%s:%d] " fmt "\n", time_str, level_names[level], __func__, __LINE__, ##__VA_ARGS__); \
+    strftime(time_str, sizeof(time_str), "%Y-%m-%d %H:%M:%S", localtime_r(&now, &now_tm)); \
+    fprintf(stderr, "[%s] [%s] [%s:%d] " fmt "\n", time_str, log_level_name(level), __func__, __LINE__, ##__VA_ARGS__); \
 } while(0)
 
 #define LOG_DEBUG(fmt, ...) LOG(LOG_DEBUG, fmt, ##__VA_ARGS__)
@@ -0,0 +1,123 @@
+// per-request phase timing and aggregated server statistics
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "config.h"
+
+/*
+Points in the lifetime of a request at which a monotonic timestamp is taken.
+Order matters - each phase duration is measured from the previous recorded phase.
+*/
+typedef enum {
+    PHASE_ACCEPT,              // accept() returned the connection
+    PHASE_FIRST_BYTE,          // first bytes of the request arrived in the read buffer
+    PHASE_HEADERS_DONE,        // read_http_request found the end of the header block
+    PHASE_PARSE_DONE,          // parse_http_request returned
+    PHASE_HANDLER_START,       // static file opened or CGI process spawned
+    PHASE_FIRST_RESPONSE_BYTE, // first write of the response to the client returned
+    PHASE_LAST_BYTE,           // last write of the response to the client returned
+    PHASE_COUNT
+} request_phase;
+
+typedef struct {
+    struct timespec stamps[PHASE_COUNT];
+    bool recorded[PHASE_COUNT];
+    int status_code;           // status that was sent to the client (0 if nothing was sent)
+} request_timing;
+
+/**
+ * Resets all timestamps of timing.
+ *
+ * Args:
+ *    request_timing *timing: timing record to reset
+ */
+void timing_init(request_timing *timing);
+
+/**
+ * Records the current monotonic time for phase. Only the first call for a phase is kept so
+ * callers on different code paths can mark the same phase without coordinating.
+ * NULL timing is accepted and ignored - not every caller (e.g unit tests) tracks timing.
+ *
+ * Args:
+ *    request_timing *timing: timing record of the current request (may be NULL)
+ *    request_phase phase: phase that was just reached
+ */
+void timing_mark(request_timing *timing, request_phase phase);
+
+/**
+ * Returns nanoseconds between the accept timestamp and phase, or 0 if either was not recorded.
+ */
+uint64_t timing_offset_ns(const request_timing *timing, request_phase phase);
+
+/**
+ * Returns the name of a phase as used in log records and on the status page
+ */
+const char *timing_phase_name(request_phase phase);
+
+/**
+ * Must be called once before any other metrics_* function
+ */
+void metrics_init(void);
+
+/**
+ * Folds a completed request into the aggregated statistics and emits its per-request log record.
+ * If the total time exceeds config->slow_request_threshold_ms the full phase breakdown is logged
+ * as a warning.
+ *
+ * Args:
+ *    const request_timing *timing: timing record of the finished request
+ *    const char *path: request path (NULL if the request could not be parsed)
+ *    server_config *config: server configuration
+ */
+void metrics_record_request(const request_timing *timing, const char *path, server_config *config);
+
+/**
+ * Writes a plain text report of the aggregated statistics to buf.
+ *
+ * Args:
+ *    char *buf: destination buffer
+ *    size_t size: size of buf
+ *
+ * Returns:
+ *    number of bytes written (excluding the null terminator), truncated to size - 1
+ */
+size_t metrics_render(char *buf, size_t size);
+
+/**
+ * snprintf that appends to buf at *offset and never moves *offset past size - 1, for use by
+ * metrics_render and section renderers
+ */
+void metrics_appendf(char *buf, size_t size, size_t *offset, const char *fmt, ...);
+
+#define METRICS_MAX_SECTIONS 8
+
+/*
+Renders a module's own statistics into buf (same contract as metrics_render), ctx is the pointer
+given to metrics_add_section
+*/
+typedef size_t (*metrics_section_fn)(char *buf, size_t size, void *ctx);
+
+/**
+ * Appends the output of render to every subsequent metrics_render report. Lets modules such as the
+ * thread pool publish their counters without the metrics module knowing about them.
+ *
+ * Args:
+ *    metrics_section_fn render: section renderer
+ *    void *ctx: passed to render
+ *
+ * Returns:
+ *    0 on success, -1 if METRICS_MAX_SECTIONS sections are already registered
+ */
+int metrics_add_section(metrics_section_fn render, void *ctx);
+
+/**
+ * Removes a section registered with the same render and ctx. Must be called before ctx is freed.
+ */
+void metrics_remove_section(metrics_section_fn render, void *ctx);
+
+#endif
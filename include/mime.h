@@ -0,0 +1,94 @@
+// MIME types of served files and their Content-Type headers
+#ifndef MIME_H
+#define MIME_H
+
+#include <stddef.h>
+
+typedef enum {
+    TEXT_HTML,
+    TEXT_PLAIN,
+    TEXT_CSS,
+    APPLICATION_JAVASCRIPT,
+    APPLICATION_JSON,
+    APPLICATION_XML,
+    APPLICATION_PDF,
+    APPLICATION_ZIP,
+    APPLICATION_POSTSCRIPT,
+    IMAGE_GIF,
+    IMAGE_PNG,
+    IMAGE_JPEG,
+    IMAGE_SVG,
+    AUDIO_MPEG,
+    AUDIO_WAV,
+    VIDEO_MP4,
+    VIDEO_WEBM,
+    FONT_WOFF,
+    FONT_WOFF2,
+    APPLICATION_OCTET_STREAM,
+    MIME_OTHER // a type without a value of its own, only its mime_entry names it
+} MIME_TYPE;
+
+/*
+One MIME type with its Content-Type header line ready to be copied into a response. Entries are
+never freed while the server runs, so requests and responses keep plain pointers to them.
+*/
+typedef struct {
+    MIME_TYPE type;
+    const char *name;     // e.g. "text/html"
+    const char *header;   // "Content-Type: <name>\r\n"
+    size_t header_length;
+} mime_entry;
+
+/*
+The built-in types live in src/mime_table.c, a perfect hash over their extensions generated by
+scripts/gen_mime_table.py. A mime.types file loaded at startup adds extensions and overrides
+built-in ones.
+*/
+
+/**
+ * Looks up an extension (without the dot, case insensitive) in the loaded types, then the built-in ones.
+ *
+ * Args:
+ *    const char *extension: extension, need not be NUL terminated
+ *    size_t length: length of extension
+ *
+ * Returns:
+ *    the extension's entry, NULL if it is unknown
+ */
+const mime_entry *mime_lookup(const char *extension, size_t length);
+
+/**
+ * Returns:
+ *    entry for the extension of path, the application/octet-stream entry if it has none or it is unknown
+ */
+const mime_entry *mime_for_path(const char *path);
+
+/**
+ * Returns:
+ *    built-in entry of type, the application/octet-stream entry for MIME_OTHER
+ */
+const mime_entry *mime_for_type(MIME_TYPE type);
+
+/**
+ * Looks up an extension in the built-in types only. Generated, see scripts/gen_mime_table.py.
+ */
+const mime_entry *mime_builtin_lookup(const char *extension, size_t length);
+
+/**
+ * Loads a mime.types file ("type/subtype ext1 ext2 ...", one type per line, '#' starts a comment),
+ * replacing the types loaded before. Call it before requests are served: lookups do not lock.
+ *
+ * Args:
+ *    const char *path: file to load
+ *
+ * Returns:
+ *    number of extensions loaded, -1 on error (the previously loaded types are kept)
+ */
+int mime_load_types(const char *path);
+
+/**
+ * Frees the loaded types, lookups only see the built-in ones afterwards.
+ */
+void mime_unload_types(void);
+
+#endif
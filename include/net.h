@@ -3,6 +3,7 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netdb.h>
+#include <stdbool.h>
 
 #define BACKLOG 1024
 #define MAX_PORT_STRLEN 6 // 5 digits
@@ -17,6 +18,20 @@ typedef struct sockaddr_in sockaddr_in;
 typedef struct addrinfo addrinfo;
 typedef enum process_type process_type;
 
+/*
+Socket options applied to a listening socket before it starts listening. Accepted connections
+inherit TCP_NODELAY and the buffer sizes from it, so client sockets need no extra system calls.
+A zero leaves the kernel default in place.
+*/
+typedef struct {
+    int backlog;            // listen() backlog, BACKLOG if 0
+    bool tcp_nodelay;       // disable Nagle's algorithm on accepted connections
+    int defer_accept;       // seconds the kernel holds a connection until its first data arrives (Linux only)
+    int fastopen_queue;     // pending TCP Fast Open requests (0 disables TFO)
+    int send_buffer;        // SO_SNDBUF in bytes
+    int recv_buffer;        // SO_RCVBUF in bytes
+} listen_options;
+
 /*
 Establishes a TCP connection with a server running on host hostname and listening on port number
 Args 
@@ -30,13 +45,68 @@ int open_clientfd(char * hostname, char * port);
 
 /*
 Returns a listening descriptor that is ready to receive connection requests on port port. 
+Options the platform does not support are skipped with a warning.
 
 Args
     char * port : port number (NOT service name) on which the web server will run
+    const listen_options * options : socket options, NULL for the defaults
 Returns
     The descriptor of the listening socket on success. -1 on failure
 */
-int open_listenfd(char * port);
+int open_listenfd(char * port, const listen_options * options);
+
+/*
+Same as open_listenfd but also sets SO_REUSEPORT, so several sockets (one per worker) can listen on the
+same port and the kernel load-balances incoming connections between them.
+
+Args
+    char * port : port number (NOT service name) on which the web server will run
+    const listen_options * options : socket options, NULL for the defaults
+Returns
+    The descriptor of the listening socket on success. -1 on failure (including platforms without SO_REUSEPORT)
+*/
+int open_listenfd_reuseport(char * port, const listen_options * options);
+
+/*
+Attaches a classic BPF program to a SO_REUSEPORT group that picks the listener by the CPU that received
+the connection (cpu % group_size). With workers pinned to matching CPUs a connection stays on the core
+that processed its packets. Only needs to be attached to one socket of the group; listeners must be opened
+in CPU order. Linux only.
+
+Args
+    int listen_fd : any listening socket of the group
+    unsigned int group_size : number of listening sockets in the group
+Returns
+    0 on success, -1 on failure
+*/
+int attach_reuseport_cpu_steering(int listen_fd, unsigned int group_size);
+
+/*
+Sets SO_INCOMING_CPU on a listening socket of a SO_REUSEPORT group. Among the listeners of a group the
+kernel prefers the one whose incoming CPU matches the CPU that processed the connection's packets, so
+an acceptor pinned to that CPU (ideally the one handling the NIC RX queue IRQ) takes the connection.
+Linux only.
+
+Args
+    int listen_fd : listening socket
+    int cpu : CPU the acceptor of listen_fd is pinned to
+Returns
+    0 on success, -1 on failure
+*/
+int set_incoming_cpu(int listen_fd, int cpu);
+
+/*
+Corks or uncorks a connected TCP socket (TCP_CORK on Linux, TCP_NOPUSH on BSD/macOS). While corked
+the kernel only sends full segments, so a header and a body written separately share packets.
+Uncorking flushes what is left.
+
+Args
+    int fd : connected socket
+    bool cork : true to cork, false to uncork and flush
+Returns
+    0 on success, -1 on failure
+*/
+int set_tcp_cork(int fd, bool cork);
 
 
 #endif
\ No newline at end of file
@@ -0,0 +1,116 @@
+// cache of resolved file paths and their stat results
+#ifndef PATH_CACHE_H
+#define PATH_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/*
+Maps a document root and a normalized request path to the absolute path of the file and the result of
+its last stat, so a request for a file served a moment ago skips the string work of resolving it.
+Entries are trusted for a fixed number of seconds after they were stored. Static responses still
+take their headers from an fstat of the opened file, the cached stat result is only a hint there.
+
+Paths that do not exist are cached too, for a shorter time, so clients probing for missing files get
+their 404 without a failed open each time.
+
+The cache has a fixed number of entries in sets of four. A set is replaced oldest first, the sets are
+guarded by striped locks so worker threads rarely wait on each other. It is shared by all threads
+and configuration snapshots: the document root is part of the key.
+
+When the document root is watched (Linux only), every change below it drops all entries right away
+instead of waiting for them to expire. The watch can also keep a bloom filter of the files below the
+root, which answers most lookups of paths that never existed without touching the file system.
+*/
+
+typedef enum {
+    PATH_CACHE_MISS = 0,    // unknown, only the resolved path is filled
+    PATH_CACHE_FOUND = 1,   // the stat result is filled
+    PATH_CACHE_MISSING = 2  // the path does not exist
+} PATH_CACHE_RESULT;
+
+/**
+ * Allocates the cache. Until it is called, or with entries 0, lookups miss and stores are dropped.
+ *
+ * Args:
+ *    unsigned int entries: number of entries, rounded up to a power of two
+ *    unsigned int ttl_seconds: how long the stat result of a file is trusted
+ *    unsigned int missing_ttl_seconds: how long a missing path is trusted (0 to not cache them)
+ *
+ * Returns:
+ *    0 on success, -1 if allocation fails (the cache stays disabled)
+ */
+int path_cache_init(unsigned int entries, unsigned int ttl_seconds, unsigned int missing_ttl_seconds);
+
+/**
+ * Applies reloaded settings while lookups and stores run. The TTLs take effect right away. A different
+ * number of entries starts over with an empty table of the new size, the old one is only freed by
+ * path_cache_destroy since lookups in progress may still use it. Call it from one thread at a time.
+ *
+ * Args:
+ *    unsigned int entries: number of entries, rounded up to a power of two (0 disables the cache)
+ *    unsigned int ttl_seconds: how long the stat result of a file is trusted (0 disables the cache)
+ *    unsigned int missing_ttl_seconds: how long a missing path is trusted (0 to not cache them)
+ *
+ * Returns:
+ *    0 on success, -1 if allocation fails (the cache keeps its current size)
+ */
+int path_cache_configure(unsigned int entries, unsigned int ttl_seconds, unsigned int missing_ttl_seconds);
+
+/**
+ * Stops the watch and frees the cache, it is disabled afterwards. No lookups or stores may run
+ * concurrently.
+ */
+void path_cache_destroy(void);
+
+/**
+ * Watches root and every directory below it and drops all entries whenever one of them changes.
+ * Call it once, after path_cache_init. Other roots (e.g. of routes) still rely on expiry.
+ *
+ * Args:
+ *    const char *root: directory to watch, as passed to path_cache_lookup
+ *    bool bloom: also build a bloom filter of the files below root
+ *
+ * Returns:
+ *    0 on success, -1 if the watch cannot be set up (entries only expire then)
+ */
+int path_cache_watch(const char *root, bool bloom);
+
+/**
+ * Resolves root + path into resolved (a doubled slash where they meet is dropped) and looks it up.
+ *
+ * Args:
+ *    const char *root: document root, ends with '/'
+ *    const char *path: normalized request path, starts with '/'
+ *    char *resolved: filled with the absolute path
+ *    size_t size: size of resolved
+ *    struct stat *st: filled with the cached stat result on PATH_CACHE_FOUND
+ *
+ * Returns:
+ *    a PATH_CACHE_RESULT, -1 if the path does not fit in size bytes
+ */
+int path_cache_lookup(const char *root, const char *path, char *resolved, size_t size, struct stat *st);
+
+/**
+ * Stores the stat result of the path the last path_cache_lookup of this thread resolved, replacing
+ * an older entry for it. Dropped if the root changed since that lookup.
+ *
+ * Args:
+ *    const char *resolved: absolute path from path_cache_lookup
+ *    const struct stat *st: its stat result
+ */
+void path_cache_store(const char *resolved, const struct stat *st);
+
+/**
+ * Like path_cache_store, for a path that does not exist (open or stat failed with ENOENT or ENOTDIR).
+ */
+void path_cache_store_missing(const char *resolved);
+
+/**
+ * Renders hit and miss counters for the status page (a metrics_section_fn).
+ */
+size_t path_cache_render_stats(char *buf, size_t size, void *ctx);
+
+#endif
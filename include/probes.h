@@ -0,0 +1,49 @@
+// USDT (SystemTap / DTrace style) static tracepoints on the request lifecycle and I/O paths
+#ifndef PROBES_H
+#define PROBES_H
+
+/*
+Probes are compiled out entirely unless the server is built with -DENABLE_USDT and <sys/sdt.h> is
+available (systemtap-sdt-dev on Debian/Ubuntu, systemtap-sdt-devel on Fedora). When compiled in, a
+probe that nobody is attached to costs a single nop.
+
+All probes live in the "turingbolt" provider. List them with
+    bpftrace -l 'usdt:./executables/server:*'
+and attach, for example
+    bpftrace -e 'usdt:./executables/server:turingbolt:request__done { @us = hist(arg3 / 1000); }'
+
+Probe                         Arguments
+request__start                fd
+request__done                 fd, path, status code, total ns since accept
+parse__start                  raw request
+parse__done                   path (NULL on failure), 0 on success / -1 on failure
+static__start                 fd, request path
+static__done                  fd, request path, body bytes, status code
+cgi__spawn                    fd, absolute script path, child pid
+cgi__done                     fd, request path, body bytes, status code
+rio__read                     fd, requested bytes, result
+rio__write                    fd, requested bytes, result
+rio__fill                     fd, result
+*/
+
+#if defined(ENABLE_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define USDT_PROBES_ENABLED 1
+#endif
+#endif
+
+#ifdef USDT_PROBES_ENABLED
+#define PROBE1(name, a1) DTRACE_PROBE1(turingbolt, name, a1)
+#define PROBE2(name, a1, a2) DTRACE_PROBE2(turingbolt, name, a1, a2)
+#define PROBE3(name, a1, a2, a3) DTRACE_PROBE3(turingbolt, name, a1, a2, a3)
+#define PROBE4(name, a1, a2, a3, a4) DTRACE_PROBE4(turingbolt, name, a1, a2, a3, a4)
+#else
+// Arguments are not evaluated when probes are disabled
+#define PROBE1(name, a1) do {} while (0)
+#define PROBE2(name, a1, a2) do {} while (0)
+#define PROBE3(name, a1, a2, a3) do {} while (0)
+#define PROBE4(name, a1, a2, a3, a4) do {} while (0)
+#endif
+
+#endif
@@ -36,6 +36,7 @@ typedef struct {
     
     // Content-related headers
     char *content_type;      // MIME type of the content
+    const mime_entry *mime;  // Content-Type line from the MIME table, used when content_type is NULL
     size_t content_length;   // Length of body in bytes
     char *content_encoding;  // Optional encoding (gzip, etc.)
     char *last_modified;     // When the resource was last changed. MUST BE FREED 
@@ -108,6 +109,21 @@ int execute_request(http_request *request, int client_fd, server_config *config)
  */
 int serve_static(http_request *request, http_response * response, int client_fd, server_config *config);
 
+/**
+ * Resolves and opens the static file request refers to and fills in the status line and content headers
+ * of response. On failure response carries the error status (404, 403, 414, 503 or 500) to send.
+ * Marks PHASE_HANDLER_START once the file is open.
+ * 
+ * Args:
+ *    http_request *request: Parsed HTTP request
+ *    http_response *response: Response whose status and content headers are set
+ *    server_config *config: Server configuration
+ * 
+ * Returns:
+ *    Open descriptor of the file on success (caller closes it), -1 on error
+ */
+int open_static_file(http_request *request, http_response * response, server_config *config);
+
 /**
  * Serves dynamic content by executing the CGI script
  * 
@@ -155,6 +171,41 @@ char * generate_response_header(http_response * response);
  */
 char * get_absolute_path(http_request * request, server_config * config);
 
+/**
+ * Renders the complete error responses (header and HTML body) for 400, 403, 404, 405, 408, 413, 414,
+ * 500, 501, 503 and 505 once. Only their Date is filled in when one is sent. Called at startup,
+ * send_error_response also calls it on first use.
+ */
+void canned_responses_init(void);
+
+/**
+ * Sends a complete HTTP error response with a small HTML body explaining the error. The canned
+ * responses go out with a single writev, other codes are rendered on the spot.
+ * 
+ * Args:
+ *    int client_fd: Client connection file descriptor
+ *    int status_code: HTTP status code
+ *
+ * Returns:
+ *    0 on success, -1 if the write failed
+ */
+int send_error_response(int client_fd, int status_code);
+
+/**
+ * Writes the same complete error response as send_error_response into buf, for callers that send
+ * it themselves.
+ *
+ * Returns:
+ *    length of the response, -1 if it does not fit in size bytes
+ */
+ssize_t format_error_response(int status_code, char *buf, size_t size);
+
+/**
+ * Sends the aggregated request statistics (see metrics_render) as a text/plain response.
+ * Marks PHASE_FIRST_RESPONSE_BYTE and the status code on timing (may be NULL)
+ */
+void send_status_response(int client_fd, request_timing *timing);
+
 int get_code_from_cgi_status(char * status_line);
 
 void initialize_response(http_response * response);
@@ -2,6 +2,7 @@
 #define RIO_H
 
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <stddef.h>
 #include <stdbool.h>
 
@@ -42,6 +43,35 @@ Returns
 ssize_t rio_unbuffered_write(int fd, void * buf, size_t write_size);
 
 
+/*
+Transfers the iovcnt buffers described by iov to fd with as few writev calls as possible, resuming
+after partial writes. iov is used as scratch space: its entries are advanced past the bytes written.
+
+Args
+    int fd - file descriptor of the file we're writing to
+    struct iovec * iov - buffers to write, in order (entries may be empty)
+    int iovcnt - number of entries in iov
+Returns
+    number of bytes written on success, -1 on failure
+*/
+ssize_t rio_writev(int fd, struct iovec * iov, int iovcnt);
+
+
+/*
+Moves up to size bytes from the pipe pipe_fd to out_fd inside the kernel (splice on Linux), the
+data never passes through a user space buffer. Retries on EINTR.
+
+Args
+    int pipe_fd - read end of a pipe
+    int out_fd - descriptor we're writing to (a socket or a file)
+    size_t size - max bytes to move
+Returns
+    number of bytes moved, 0 once the pipe reached EOF, -1 on failure. errno is EINVAL or ENOSYS when
+    splicing is not supported for these descriptors, callers then fall back to read/write
+*/
+ssize_t rio_splice(int pipe_fd, int out_fd, size_t size);
+
+
 /*
 associates buffer buf with fd. No data is read into the buffer here.
 
@@ -0,0 +1,110 @@
+// maps request paths to the routes configured in the [Routes] section
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// A route is one line of the [Routes] section: a pattern and the rule requests matching it follow.
+//
+//     /about.html       = static                     exact path
+//     /assets/*         = static ./public/static/    every path starting with /assets/
+//     *.cgi             = cgi                        every path whose last segment ends in .cgi
+//     /server-status    = native status
+//     /old/*            = redirect /new/ 301
+//     /                 = static cache=no-cache
+//
+// The first word after '=' is the action, optionally followed by its target. Options may follow:
+// cache=<Cache-Control directives> (no spaces, e.g. cache=public,max-age=86400) and compress.
+//
+// An exact rule wins over an extension rule, which wins over prefix rules; among prefix rules the
+// longest one wins. A pattern listed twice keeps its first rule.
+//
+// The patterns are compiled into a byte trie when the configuration is loaded, so finding the route of
+// a path takes one step per byte of the path no matter how many routes there are.
+
+typedef enum {
+    ROUTE_STATIC,   // file below the route's root (DocumentRoot if it has none)
+    ROUTE_CGI,      // CGI script below the route's root (DocumentRoot if it has none)
+    ROUTE_NATIVE,   // handler built into the server
+    ROUTE_REDIRECT  // redirect to another location
+} ROUTE_ACTION;
+
+typedef enum {
+    MATCH_EXACT,
+    MATCH_PREFIX,
+    MATCH_EXTENSION
+} ROUTE_MATCH;
+
+// Handlers built into the server, named in the config by the strings in router.c
+typedef enum {
+    NATIVE_STATUS,  // aggregated request statistics, see send_status_response
+    NATIVE_HANDLER_COUNT
+} NATIVE_HANDLER;
+
+typedef struct {
+    char *pattern;         // as configured, e.g. "/assets/*"
+    ROUTE_MATCH match;
+    ROUTE_ACTION action;
+    char *root;            // static and CGI: directory the path is appended to (ends with '/'), NULL for DocumentRoot
+    char *location;        // redirect: target. A prefix route appends the rest of the path to a target ending in '/'
+    int redirect_status;   // redirect: 301, 302, 307 or 308
+    NATIVE_HANDLER native; // native: handler to call
+    char *cache_control;   // Cache-Control value sent with the route's responses, NULL for none
+    bool compress;         // responses of this route may be sent compressed (no encoder exists yet)
+} route;
+
+typedef struct route_table route_table;
+
+/**
+ * Returns:
+ *    an empty route table, NULL if allocation fails
+ */
+route_table *router_create(void);
+
+/**
+ * Parses one route and appends it to table. Routes added after router_compile only take effect when
+ * it is called again.
+ *
+ * Args:
+ *    route_table *table: table to add the route to
+ *    const char *pattern: "/exact", a path ending in '*' for a prefix, or "*.extension"
+ *    const char *rule: action, target and options, e.g. "static ./public/ cache=max-age=60"
+ *
+ * Returns:
+ *    0 on success, -1 if the pattern or rule is malformed (the table is unchanged) or allocation fails
+ */
+int router_add(route_table *table, const char *pattern, const char *rule);
+
+/**
+ * Builds the trie over the routes added so far.
+ *
+ * Returns:
+ *    0 on success, -1 if allocation fails (router_match finds nothing then)
+ */
+int router_compile(route_table *table);
+
+/**
+ * Finds the route of a decoded request path.
+ *
+ * Args:
+ *    const route_table *table: compiled table (may be NULL)
+ *    const char *path: request path without the query, e.g. "/assets/app.js"
+ *
+ * Returns:
+ *    the route, NULL if no route matches
+ */
+const route *router_match(const route_table *table, const char *path);
+
+/**
+ * Returns:
+ *    number of routes in table
+ */
+size_t router_count(const route_table *table);
+
+/**
+ * Frees table and its routes (may be NULL).
+ */
+void router_destroy(route_table *table);
+
+#endif
@@ -0,0 +1,63 @@
+// vectorized byte searches over request text
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+
+/*
+The parser spends most of its time looking for a handful of delimiters: CRLF, the blank line ending
+the headers, spaces in the request line, colons in header lines and escapes in the URI. On x86-64 the
+first KB of a search goes 16 (SSE2) or 32 (AVX2) bytes per step, the widest kernel the CPU supports
+is picked on first use. Longer searches continue with libc's memchr, as do all searches on other
+architectures.
+
+Every function searches [start, end), never reads outside of it and returns end if nothing matched.
+*/
+
+/**
+ * Finds the first byte equal to a or b (pass the same byte twice to look for one).
+ *
+ * Args:
+ *    const char *start: first byte to search
+ *    const char *end: one past the last byte to search
+ *    char a, char b: bytes to look for
+ *
+ * Returns:
+ *    pointer to the first match, end if there is none
+ */
+const char *scan_find_either(const char *start, const char *end, char a, char b);
+
+/**
+ * Finds the first occurrence of the two byte sequence first, second (e.g. "\r\n").
+ *
+ * Returns:
+ *    pointer to first of the first match, end if there is none
+ */
+const char *scan_find_pair(const char *start, const char *end, char first, char second);
+
+/**
+ * Finds the "\r\n\r\n" that ends a request's headers.
+ *
+ * Returns:
+ *    pointer to its first byte, end if there is none
+ */
+const char *scan_header_end(const char *start, const char *end);
+
+/**
+ * Returns:
+ *    name of the kernels in use ("avx2", "sse2" or "scalar")
+ */
+const char *scan_kernel_name(void);
+
+/**
+ * Switches to the named kernels instead of the detected ones, for benchmarks and tests.
+ *
+ * Args:
+ *    const char *name: "avx2", "sse2", "scalar", or NULL to go back to the detected ones
+ *
+ * Returns:
+ *    0 on success, -1 if this CPU or build does not support them
+ */
+int scan_select_kernel(const char *name);
+
+#endif
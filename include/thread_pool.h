@@ -0,0 +1,92 @@
+// work-stealing pool of worker threads
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stddef.h>
+
+/*
+Every worker owns a Chase-Lev deque: the owner pushes and pops at the bottom without locks, idle
+workers steal from the top of their peers' deques with a single CAS. Items submitted from outside
+the pool (the acceptor) land in the bounded lock-free MPMC inbox of one worker, which the owner
+drains in FIFO order. Idle workers steal from peer deques first and peer inboxes second, so a worker
+stuck on a long download never holds up the connections queued behind it.
+
+A mutex and condition variable are only used to park workers that found nothing to do.
+*/
+
+#define THREAD_POOL_DEQUE_CAPACITY 1024 // per-worker deque slots (power of 2)
+#define THREAD_POOL_INBOX_CAPACITY 256  // per-worker inbox slots (power of 2)
+#define THREAD_POOL_MAX_WORKERS    256  // upper bound for thread_pool_create and thread_pool_resize
+
+typedef struct thread_pool thread_pool;
+
+// Processes one submitted item on a worker thread. The handler owns the item
+typedef void (*thread_pool_handler)(void *item);
+
+// Runs first on every worker thread (e.g. to pin it to a CPU), before the worker touches its queues
+typedef void (*thread_pool_thread_init)(unsigned int index);
+
+/**
+ * Starts worker_count worker threads that pass every submitted item to handler. Each worker sets up
+ * its own queues, so they are allocated close to the CPU it runs on.
+ *
+ * Args:
+ *    unsigned int worker_count: number of worker threads (at least 1)
+ *    thread_pool_handler handler: called for each item
+ *    thread_pool_thread_init thread_init: called with the worker index when a worker thread starts (may be NULL)
+ *
+ * Returns:
+ *    pool on success, NULL on error
+ */
+thread_pool *thread_pool_create(unsigned int worker_count, thread_pool_handler handler,
+                                thread_pool_thread_init thread_init);
+
+/**
+ * Queues item for a worker. From a worker thread the item goes to the bottom of that worker's own
+ * deque, from any other thread into the inbox of the next worker in round-robin order.
+ *
+ * Args:
+ *    thread_pool *pool: pool
+ *    void *item: item passed to the handler (must not be NULL)
+ *
+ * Returns:
+ *    0 on success, -1 if every queue is full or the pool is shutting down (the caller keeps the item)
+ */
+int thread_pool_submit(thread_pool *pool, void *item);
+
+/**
+ * Changes the number of workers. New workers start right away. Workers past the new count stop
+ * taking submissions, finish the items already queued to them and exit.
+ *
+ * Args:
+ *    thread_pool *pool: pool
+ *    unsigned int worker_count: new number of worker threads (1 to THREAD_POOL_MAX_WORKERS)
+ *
+ * Returns:
+ *    0 on success, -1 on error (some of the new workers may be missing)
+ */
+int thread_pool_resize(thread_pool *pool, unsigned int worker_count);
+
+/**
+ * Stops accepting items, waits until every queued item has been handled and joins the workers.
+ *
+ * Args:
+ *    thread_pool *pool: pool to destroy (may be NULL)
+ */
+void thread_pool_destroy(thread_pool *pool);
+
+/**
+ * Renders per-worker queue lengths, handled items and steal counts. Matches metrics_section_fn so
+ * it can be registered with metrics_add_section.
+ *
+ * Args:
+ *    char *buf: destination buffer
+ *    size_t size: size of buf
+ *    void *pool: thread_pool to report on
+ *
+ * Returns:
+ *    number of bytes written (excluding the null terminator), truncated to size - 1
+ */
+size_t thread_pool_render_stats(char *buf, size_t size, void *pool);
+
+#endif
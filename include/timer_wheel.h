@@ -0,0 +1,98 @@
+// hierarchical timer wheel for connection deadlines
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+TIMER_WHEEL_LEVELS wheels of TIMER_WHEEL_SLOTS slots each. Level 0 slots are one tick wide, every
+level up is TIMER_WHEEL_SLOTS times coarser. Arming, re-arming and disarming only link or unlink
+the timer in one slot, so they are O(1) and need no system call. When a lower wheel wraps around,
+the current slot of the next level is cascaded down.
+
+With the default 100ms tick the wheel covers 2^24 ticks (about 19 days). Longer timeouts are clamped.
+A background thread advances the wheel and runs the callbacks of expired timers.
+*/
+
+#define TIMER_WHEEL_LEVELS          4
+#define TIMER_WHEEL_SLOT_BITS       6
+#define TIMER_WHEEL_SLOTS           (1 << TIMER_WHEEL_SLOT_BITS)
+#define TIMER_WHEEL_DEFAULT_TICK_MS 100
+
+typedef struct timer_wheel timer_wheel;
+typedef struct timer_entry timer_entry;
+
+/*
+Called on the timer thread when a timer expires, with the wheel locked. Must be short and must not
+call timer_* functions of the same wheel
+*/
+typedef void (*timer_callback)(timer_entry *timer);
+
+// A timer, usually embedded in the object it guards. Fields are private to the wheel
+struct timer_entry {
+    timer_entry *next;
+    timer_entry **pprev;    // address of the pointer that points to this entry, NULL if not armed
+    uint64_t expires;       // tick at which the timer fires
+    unsigned int timeout_ms; // timeout of the last timer_arm, reused by timer_refresh
+    timer_wheel *wheel;
+    timer_callback callback;
+    void *arg;
+};
+
+/**
+ * Creates a wheel and starts its timer thread.
+ *
+ * Args:
+ *    unsigned int tick_ms: resolution of the wheel in milliseconds (timers fire up to one tick late)
+ *
+ * Returns:
+ *    wheel on success, NULL on error
+ */
+timer_wheel *timer_wheel_create(unsigned int tick_ms);
+
+/**
+ * Stops the timer thread and frees the wheel. Pending timers never fire.
+ *
+ * Args:
+ *    timer_wheel *wheel: wheel to destroy (may be NULL)
+ */
+void timer_wheel_destroy(timer_wheel *wheel);
+
+/**
+ * Prepares a timer. wheel may be NULL, in which case every other timer_* call on it is a no-op.
+ *
+ * Args:
+ *    timer_entry *timer: timer to initialize
+ *    timer_wheel *wheel: wheel the timer will be armed on
+ *    timer_callback callback: called when the timer expires
+ *    void *arg: available to the callback as timer->arg
+ */
+void timer_init(timer_entry *timer, timer_wheel *wheel, timer_callback callback, void *arg);
+
+/**
+ * Arms timer to fire timeout_ms from now, replacing any earlier deadline. A timeout of 0 disarms it.
+ *
+ * Args:
+ *    timer_entry *timer: timer to arm (may be NULL)
+ *    unsigned int timeout_ms: timeout in milliseconds
+ */
+void timer_arm(timer_entry *timer, unsigned int timeout_ms);
+
+/**
+ * Pushes the deadline of timer out by the timeout it was last armed with. Used to report progress.
+ *
+ * Args:
+ *    timer_entry *timer: timer to refresh (may be NULL)
+ */
+void timer_refresh(timer_entry *timer);
+
+/**
+ * Cancels timer. Once this returns the callback is not running and will not run.
+ *
+ * Args:
+ *    timer_entry *timer: timer to cancel (may be NULL)
+ */
+void timer_disarm(timer_entry *timer);
+
+#endif
@@ -0,0 +1,38 @@
+// io_uring based server engine (Linux only)
+#ifndef URING_ENGINE_H
+#define URING_ENGINE_H
+
+#include <signal.h>
+#include "config.h"
+#include "timer_wheel.h"
+
+#define URING_QUEUE_DEPTH   256  // submission queue entries. Completion queue is twice as large
+#define URING_BUFFER_COUNT  256  // receive buffers in the provided buffer ring (power of 2)
+#define URING_BUFFER_GROUP  0    // buffer group id of the receive buffers
+
+/**
+ * Serves connections arriving on listen_fd from a single io_uring event loop until *running is cleared
+ * or the listening socket is shut down.
+ *
+ * Connections are accepted with one multishot accept, requests are received into a ring of
+ * kernel-provided buffers, and static files are streamed with alternating file read and socket send
+ * operations. Every operation queued during one loop iteration goes to the kernel in a single
+ * io_uring_enter call. Requests of CGI, native and redirect routes run the blocking handlers on a few
+ * helper threads and are closed on the loop once they are done, so a slow script only holds up its
+ * own connection. Canned error responses (400, 408) are a single small write made on the loop.
+ *
+ * Needs Linux 5.19 or newer (multishot accept and provided buffer rings). Each connection is served
+ * with the configuration snapshot current when it was accepted.
+ *
+ * Args:
+ *    int listen_fd: listening socket
+ *    timer_wheel *timers: enforces the idle, header and send timeouts of every connection (NULL disables them)
+ *    volatile sig_atomic_t *running: loop exits once this becomes 0
+ *
+ * Returns:
+ *    0 after a clean shutdown, -1 if io_uring could not be set up (nothing was accepted, the caller
+ *    can fall back to the blocking accept loop)
+ */
+int uring_engine_run(int listen_fd, timer_wheel *timers, volatile sig_atomic_t *running);
+
+#endif
@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+"""
+Generates src/mime_table.c, the built-in MIME types and a perfect hash over their extensions.
+
+Usage (from the project root, after editing TYPES below):
+    python3 scripts/gen_mime_table.py > src/mime_table.c
+
+Every extension hashes to its own slot, so a lookup is one FNV-1a pass over the extension and one
+comparison. The seed of the hash is searched for here until no two extensions share a slot.
+Extensions beyond these come from a mime.types file at startup (see MimeTypes in config.ini).
+"""
+
+import sys
+
+# (MIME_TYPE value, Content-Type, extensions). Types with their own MIME_TYPE value come first, in
+# the order of the enum in include/mime.h. MIME_OTHER types are only told apart by their name.
+TYPES = [
+    ("TEXT_HTML", "text/html", ["html", "htm"]),
+    ("TEXT_PLAIN", "text/plain", ["txt"]),
+    ("TEXT_CSS", "text/css", ["css"]),
+    ("APPLICATION_JAVASCRIPT", "application/javascript", ["js", "mjs"]),
+    ("APPLICATION_JSON", "application/json", ["json", "map"]),
+    ("APPLICATION_XML", "application/xml", ["xml"]),
+    ("APPLICATION_PDF", "application/pdf", ["pdf"]),
+    ("APPLICATION_ZIP", "application/zip", ["zip"]),
+    ("APPLICATION_POSTSCRIPT", "application/postscript", ["ps"]),
+    ("IMAGE_GIF", "image/gif", ["gif"]),
+    ("IMAGE_PNG", "image/png", ["png"]),
+    ("IMAGE_JPEG", "image/jpeg", ["jpg", "jpeg"]),
+    ("IMAGE_SVG", "image/svg+xml", ["svg"]),
+    ("AUDIO_MPEG", "audio/mpeg", ["mp3"]),
+    ("AUDIO_WAV", "audio/wav", ["wav"]),
+    ("VIDEO_MP4", "video/mp4", ["mp4", "mov"]),  # browsers can often handle .mov as video/mp4
+    ("VIDEO_WEBM", "video/webm", ["webm"]),
+    ("FONT_WOFF", "font/woff", ["woff"]),
+    ("FONT_WOFF2", "font/woff2", ["woff2"]),
+    ("APPLICATION_OCTET_STREAM", "application/octet-stream", []),
+    ("MIME_OTHER", "image/x-icon", ["ico"]),
+    ("MIME_OTHER", "image/webp", ["webp"]),
+    ("MIME_OTHER", "image/avif", ["avif"]),
+    ("MIME_OTHER", "application/wasm", ["wasm"]),
+    ("MIME_OTHER", "text/csv", ["csv"]),
+    ("MIME_OTHER", "text/markdown", ["md"]),
+    ("MIME_OTHER", "font/ttf", ["ttf"]),
+    ("MIME_OTHER", "font/otf", ["otf"]),
+    ("MIME_OTHER", "audio/ogg", ["ogg", "oga"]),
+]
+
+FNV_PRIME = 0x01000193
+
+
+def fnv1a(seed, text):
+    value = seed
+    for byte in text.encode():
+        value = ((value ^ byte) * FNV_PRIME) & 0xFFFFFFFF
+    return value
+
+
+def slot_of(seed, text, slot_count):
+    # The low bits of an FNV-1a product only depend on the low bits of its inputs, fold in the high half
+    value = fnv1a(seed, text)
+    return (value ^ (value >> 16)) & (slot_count - 1)
+
+
+def find_seed(extensions, slot_count):
+    for seed in range(1, 1 << 20):
+        slots = {slot_of(seed, ext, slot_count) for ext in extensions}
+        if len(slots) == len(extensions):
+            return seed
+    return None
+
+
+def main():
+    extensions = [(ext, index) for index, (_, _, exts) in enumerate(TYPES) for ext in exts]
+    names = [ext for ext, _ in extensions]
+    if len(set(names)) != len(names) or any(ext != ext.lower() for ext in names):
+        sys.exit("extensions must be unique and lower case")
+
+    slot_count = 1
+    while slot_count < 2 * len(extensions):
+        slot_count *= 2
+    seed = find_seed(names, slot_count)
+    while seed is None:
+        slot_count *= 2
+        seed = find_seed(names, slot_count)
+    max_length = max(len(ext) for ext in names)
+
+    slots = [None] * slot_count
+    for ext, index in extensions:
+        slots[slot_of(seed, ext, slot_count)] = (ext, index)
+
+    out = sys.stdout
+    out.write("// Generated by scripts/gen_mime_table.py, edit the table there and regenerate\n")
+    out.write('#include "mime.h"\n#include <stdint.h>\n#include <string.h>\n#include <ctype.h>\n\n')
+    out.write("#define MIME_HASH_SEED 0x%08xu\n" % seed)
+    out.write("#define MIME_SLOT_COUNT %d\n" % slot_count)
+    out.write("#define MIME_MAX_BUILTIN_EXTENSION %d\n\n" % max_length)
+
+    out.write("// Indexed by MIME_TYPE up to APPLICATION_OCTET_STREAM, then the MIME_OTHER types\n")
+    out.write("static const mime_entry entries[] = {\n")
+    for type_id, name, _ in TYPES:
+        header = "Content-Type: %s\\r\\n" % name
+        length = len("Content-Type: %s\r\n" % name)
+        out.write('    { %s, "%s", "%s", %d },\n' % (type_id, name, header, length))
+    out.write("};\n\n")
+
+    out.write("typedef struct {\n")
+    out.write("    char extension[MIME_MAX_BUILTIN_EXTENSION + 1];\n")
+    out.write("    unsigned char length; // 0 for an empty slot\n")
+    out.write("    unsigned char entry;\n")
+    out.write("} mime_slot;\n\n")
+    out.write("static const mime_slot slots[MIME_SLOT_COUNT] = {\n")
+    for position, slot in enumerate(slots):
+        if slot:
+            ext, index = slot
+            out.write('    [%d] = { "%s", %d, %d },\n' % (position, ext, len(ext), index))
+    out.write("};\n\n")
+
+    out.write("""const mime_entry *mime_builtin_lookup(const char *extension, size_t length) {
+    if (length == 0 || length > MIME_MAX_BUILTIN_EXTENSION) return NULL;
+    char lower[MIME_MAX_BUILTIN_EXTENSION];
+    uint32_t hash = MIME_HASH_SEED;
+    for (size_t i = 0; i < length; ++i) {
+        lower[i] = (char) tolower((unsigned char) extension[i]);
+        hash = (hash ^ (uint32_t) (unsigned char) lower[i]) * 0x01000193u;
+    }
+    const mime_slot *slot = &slots[(hash ^ (hash >> 16)) & (MIME_SLOT_COUNT - 1)];
+    if (slot->length != length || memcmp(slot->extension, lower, length) != 0) return NULL;
+    return &entries[slot->entry];
+}
+
+const mime_entry *mime_for_type(MIME_TYPE type) {
+    if ((unsigned) type >= (unsigned) MIME_OTHER) type = APPLICATION_OCTET_STREAM;
+    return &entries[type];
+}
+""")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,195 @@
+#include "admission.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#define NS_PER_MS UINT64_C(1000000)
+#define NS_PER_SEC UINT64_C(1000000000)
+#define OVERLOAD_RESPONSE_SIZE 512
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // macOS has no MSG_NOSIGNAL, the server ignores SIGPIPE anyway
+#endif
+
+static const char overload_body[] =
+    "<html><head><title>503 Service Unavailable</title></head>"
+    "<body><h1>503 Service Unavailable</h1><p>The server is overloaded, please retry later</p></body></html>";
+
+static struct {
+    pthread_mutex_t lock;
+    bool enabled;
+    uint64_t target_ns;
+    uint64_t interval_ns;
+    unsigned int max_connections;
+
+    // CoDel state, guarded by lock
+    uint64_t interval_start_ns;
+    uint64_t min_sojourn_ns;  // smallest queue delay seen in the current interval
+    bool overloaded;          // the previous interval never got below the target
+    uint64_t overload_periods;
+
+    char response[OVERLOAD_RESPONSE_SIZE];
+    size_t response_length;
+
+    // Updated with atomics
+    unsigned int in_flight;
+    uint64_t admitted;
+    uint64_t shed_queue_delay;
+    uint64_t shed_watermark;
+    uint64_t shed_fd_limit;
+} admission = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static uint64_t monotonic_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * NS_PER_SEC + (uint64_t)now.tv_nsec;
+}
+
+void admission_init(server_config *config) {
+    unsigned int max_connections = config->max_connections;
+    if (max_connections == 0) {
+        // Leave headroom for listening sockets, files being served, CGI pipes and logs
+        struct rlimit limit;
+        if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY) {
+            max_connections = (unsigned int)(limit.rlim_cur / 10 * 9);
+        }
+    }
+
+    // Built up front so shedding costs a single send()
+    char response[OVERLOAD_RESPONSE_SIZE];
+    int length = snprintf(response, sizeof(response),
+                          "HTTP/1.1 503 Service Unavailable\r\n"
+                          "Server: %s\r\n"
+                          "Connection: close\r\n"
+                          "Retry-After: %u\r\n"
+                          "Cache-Control: no-store\r\n"
+                          "Content-Type: text/html\r\n"
+                          "Content-Length: %zu\r\n"
+                          "\r\n"
+                          "%s",
+                          config->server_name, config->retry_after, strlen(overload_body), overload_body);
+    if (length < 0 || (size_t)length >= sizeof(admission.response)) {
+        LOG_ERROR("Overload response does not fit in %d bytes", OVERLOAD_RESPONSE_SIZE);
+        length = 0;
+    }
+
+    // A reload calls this again while connections are admitted and shed, the counters carry over
+    pthread_mutex_lock(&admission.lock);
+    __atomic_store_n(&admission.enabled, config->admission_control, __ATOMIC_RELAXED);
+    __atomic_store_n(&admission.max_connections, max_connections, __ATOMIC_RELAXED);
+    admission.target_ns = (uint64_t)config->admission_target_ms * NS_PER_MS;
+    admission.interval_ns = (uint64_t)config->admission_interval_ms * NS_PER_MS;
+    admission.interval_start_ns = monotonic_ns();
+    admission.min_sojourn_ns = UINT64_MAX;
+    admission.overloaded = false;
+    memcpy(admission.response, response, (size_t)length);
+    admission.response_length = (size_t)length;
+    pthread_mutex_unlock(&admission.lock);
+
+    LOG_INFO("Admission control %s: max_connections=%u target=%ums interval=%ums",
+             config->admission_control ? "enabled" : "disabled", max_connections,
+             config->admission_target_ms, config->admission_interval_ms);
+}
+
+bool admission_connection_opened(void) {
+    unsigned int in_flight = __atomic_add_fetch(&admission.in_flight, 1, __ATOMIC_RELAXED);
+    unsigned int max_connections = __atomic_load_n(&admission.max_connections, __ATOMIC_RELAXED);
+    if (max_connections > 0 && in_flight > max_connections) {
+        __atomic_sub_fetch(&admission.in_flight, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&admission.shed_watermark, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+    __atomic_add_fetch(&admission.admitted, 1, __ATOMIC_RELAXED);
+    return true;
+}
+
+void admission_connection_closed(void) {
+    __atomic_sub_fetch(&admission.in_flight, 1, __ATOMIC_RELEASE);
+}
+
+unsigned int admission_in_flight(void) {
+    return __atomic_load_n(&admission.in_flight, __ATOMIC_ACQUIRE);
+}
+
+bool admission_should_shed(const request_timing *timing) {
+    if (!__atomic_load_n(&admission.enabled, __ATOMIC_RELAXED) || !timing || !timing->recorded[PHASE_ACCEPT]) return false;
+
+    uint64_t now = monotonic_ns();
+    uint64_t accepted = (uint64_t)timing->stamps[PHASE_ACCEPT].tv_sec * NS_PER_SEC +
+                        (uint64_t)timing->stamps[PHASE_ACCEPT].tv_nsec;
+    uint64_t sojourn = now > accepted ? now - accepted : 0;
+
+    pthread_mutex_lock(&admission.lock);
+    if (now - admission.interval_start_ns >= admission.interval_ns) {
+        bool overloaded = admission.min_sojourn_ns != UINT64_MAX && admission.min_sojourn_ns > admission.target_ns;
+        if (overloaded && !admission.overloaded) {
+            admission.overload_periods++;
+            LOG_WARN("Queue delay stayed above %" PRIu64 "ms for %" PRIu64 "ms, shedding load",
+                     admission.target_ns / NS_PER_MS, admission.interval_ns / NS_PER_MS);
+        }
+        admission.overloaded = overloaded;
+        admission.min_sojourn_ns = UINT64_MAX;
+        admission.interval_start_ns = now;
+    }
+    if (sojourn < admission.min_sojourn_ns) {
+        admission.min_sojourn_ns = sojourn;
+    }
+    uint64_t limit = admission.overloaded ? admission.target_ns : admission.interval_ns;
+    bool shed = sojourn > limit;
+    pthread_mutex_unlock(&admission.lock);
+
+    if (shed) {
+        __atomic_add_fetch(&admission.shed_queue_delay, 1, __ATOMIC_RELAXED);
+    }
+    return shed;
+}
+
+void admission_record_fd_limit_drop(void) {
+    __atomic_add_fetch(&admission.shed_fd_limit, 1, __ATOMIC_RELAXED);
+}
+
+ssize_t send_overload_response(int client_fd) {
+    // Copied out so the send doesn't hold the lock, a reload may render a new response meanwhile
+    char response[OVERLOAD_RESPONSE_SIZE];
+    pthread_mutex_lock(&admission.lock);
+    size_t length = admission.response_length;
+    memcpy(response, admission.response, length);
+    pthread_mutex_unlock(&admission.lock);
+    ssize_t sent = send(client_fd, response, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+    // Half-close and drain what the client already sent, closing with unread data would reset the
+    // connection and could discard the 503 before the client reads it
+    shutdown(client_fd, SHUT_WR);
+    char discard[1024];
+    while (recv(client_fd, discard, sizeof(discard), MSG_DONTWAIT) > 0) {
+    }
+    return sent;
+}
+
+size_t admission_render_stats(char *buf, size_t size, void *ctx) {
+    (void) ctx;
+    if (!buf || size == 0) return 0;
+    buf[0] = '\0';
+    size_t offset = 0;
+
+    pthread_mutex_lock(&admission.lock);
+    bool overloaded = admission.overloaded;
+    uint64_t overload_periods = admission.overload_periods;
+    pthread_mutex_unlock(&admission.lock);
+
+    metrics_appendf(buf, size, &offset, "admission:\n");
+    metrics_appendf(buf, size, &offset, "in_flight: %u (max %u)\n",
+                    __atomic_load_n(&admission.in_flight, __ATOMIC_RELAXED),
+                    __atomic_load_n(&admission.max_connections, __ATOMIC_RELAXED));
+    metrics_appendf(buf, size, &offset, "overloaded: %s\n", overloaded ? "yes" : "no");
+    metrics_appendf(buf, size, &offset, "overload_periods: %" PRIu64 "\n", overload_periods);
+    metrics_appendf(buf, size, &offset, "admitted: %" PRIu64 "\n", __atomic_load_n(&admission.admitted, __ATOMIC_RELAXED));
+    metrics_appendf(buf, size, &offset, "shed_queue_delay: %" PRIu64 "\n", __atomic_load_n(&admission.shed_queue_delay, __ATOMIC_RELAXED));
+    metrics_appendf(buf, size, &offset, "shed_watermark: %" PRIu64 "\n", __atomic_load_n(&admission.shed_watermark, __ATOMIC_RELAXED));
+    metrics_appendf(buf, size, &offset, "shed_fd_limit: %" PRIu64 "\n", __atomic_load_n(&admission.shed_fd_limit, __ATOMIC_RELAXED));
+    return offset;
+}
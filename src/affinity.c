@@ -0,0 +1,132 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // pthread_setaffinity_np, sched_getaffinity
+#endif
+#include "affinity.h"
+#include "logger.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+static struct {
+    pthread_mutex_t lock;
+    int cpus[AFFINITY_MAX_CPUS];
+    unsigned int count;
+} affinity = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+/*
+Every CPU the process may run on. Returns the number of CPUs stored in cpus
+*/
+static unsigned int allowed_cpus(int *cpus) {
+    unsigned int count = 0;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE && cpu < AFFINITY_MAX_CPUS; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus[count++] = cpu;
+            }
+        }
+        return count;
+    }
+#endif
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    for (long cpu = 0; cpu < online && cpu < AFFINITY_MAX_CPUS; ++cpu) {
+        cpus[count++] = (int)cpu;
+    }
+    return count;
+}
+
+/*
+Parses a list like "0-3,8,10-11" into cpus. Returns the number of CPUs, -1 if the list is invalid
+*/
+static int parse_cpu_list(const char *spec, int *cpus) {
+    unsigned int count = 0;
+    const char *cursor = spec;
+    while (*cursor) {
+        char *end;
+        long first = strtol(cursor, &end, 10);
+        if (end == cursor || first < 0) return -1;
+        long last = first;
+        if (*end == '-') {
+            cursor = end + 1;
+            last = strtol(cursor, &end, 10);
+            if (end == cursor || last < first) return -1;
+        }
+        if (last >= AFFINITY_MAX_CPUS) return -1;
+        for (long cpu = first; cpu <= last; ++cpu) {
+            if (count == AFFINITY_MAX_CPUS) return -1;
+            cpus[count++] = (int)cpu;
+        }
+        cursor = end;
+        while (*cursor == ' ') cursor++;
+        if (*cursor == ',') {
+            cursor++;
+            while (*cursor == ' ') cursor++;
+        } else if (*cursor) {
+            return -1;
+        }
+    }
+    return (int)count;
+}
+
+int affinity_configure(const char *spec) {
+    int cpus[AFFINITY_MAX_CPUS];
+    int count = 0;
+    if (spec && spec[0] && strcmp(spec, "none") != 0) {
+        count = strcmp(spec, "auto") == 0 ? (int)allowed_cpus(cpus) : parse_cpu_list(spec, cpus);
+        if (count <= 0) {
+            LOG_WARN("Invalid CpuAffinity value: %s, threads are not pinned", spec);
+            count = -1;
+        }
+    }
+#ifndef __linux__
+    if (count > 0) {
+        LOG_WARN("CpuAffinity is only supported on Linux, threads are not pinned");
+        count = 0;
+    }
+#endif
+
+    pthread_mutex_lock(&affinity.lock);
+    affinity.count = count > 0 ? (unsigned int)count : 0;
+    if (count > 0) {
+        memcpy(affinity.cpus, cpus, (size_t)count * sizeof(int));
+    }
+    pthread_mutex_unlock(&affinity.lock);
+
+    if (count > 0) {
+        LOG_INFO("Pinning threads to %d CPUs (%s)", count, spec);
+    }
+    return count;
+}
+
+int affinity_cpu(unsigned int index) {
+    pthread_mutex_lock(&affinity.lock);
+    int cpu = affinity.count > 0 ? affinity.cpus[index % affinity.count] : -1;
+    pthread_mutex_unlock(&affinity.lock);
+    return cpu;
+}
+
+int affinity_pin_thread(unsigned int index) {
+    int cpu = affinity_cpu(index);
+    if (cpu < 0) return -1;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (error != 0) {
+        LOG_WARN("Failed to pin thread %u to CPU %d: %s", index, cpu, strerror(error));
+        return -1;
+    }
+    LOG_DEBUG("Pinned thread %u to CPU %d", index, cpu);
+    return cpu;
+#else
+    return -1;
+#endif
+}
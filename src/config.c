@@ -5,6 +5,7 @@
 #include <string.h>
 #include <ctype.h>
 #include <stdbool.h>
+#include <pthread.h>
 
 /**
  * Helper function to trim whitespace from a string
@@ -43,6 +44,27 @@ static char* safe_strdup(const char *str) {
     return strdup(str);
 }
 
+/**
+ * Adds the routes every configuration has unless [Routes] overrides them: the dynamic directory is
+ * served by CGI and the status URI by the status page. A pattern keeps its first rule, so these go
+ * after the configured ones. Then compiles the table.
+ */
+static void compile_routes(server_config *config) {
+    if (!config->routes) return;
+    if (config->dynamic_dir_name && config->dynamic_dir_name[0]) {
+        char pattern[256];
+        // "/cgi-bin" itself and everything below it
+        snprintf(pattern, sizeof(pattern), "/%s", config->dynamic_dir_name);
+        router_add(config->routes, pattern, "cgi");
+        snprintf(pattern, sizeof(pattern), "/%s/*", config->dynamic_dir_name);
+        router_add(config->routes, pattern, "cgi");
+    }
+    if (config->status_uri) {
+        router_add(config->routes, config->status_uri, "native status");
+    }
+    router_compile(config->routes);
+}
+
 /**
  * Initialize configuration with default values
  */
@@ -57,12 +79,43 @@ void config_init(server_config *config) {
     config->document_root = safe_strdup("./public/");
     config->cgi_bin_path = safe_strdup("./public/cgi-bin/");
     config->server_name = safe_strdup("TuringBolt/0.1");
+    config->mime_types_file = NULL;
     config->log_directory = safe_strdup("./logs/");
     config->dynamic_dir_name = safe_strdup("cgi-bin");
     config->static_dir_name = safe_strdup("static");
     config->thread_pool_size = 4;
     config->connection_timeout = 60;
+    config->keepalive_timeout = 0; // 0 until loaded means "same as ConnectionTimeout"
+    config->header_timeout = 0;
+    config->send_timeout = 0;
+    config->drain_timeout = 30;
+    config->reuseport_listeners = false;
+    config->reuseport_cpu_steering = false;
+    config->io_uring_engine = false;
+    config->cpu_affinity = safe_strdup("none");
+    config->path_cache_entries = 1024;
+    config->path_cache_ttl = 2;
+    config->path_cache_missing_ttl = 1;
+    config->path_cache_watch = true;
+    config->path_cache_bloom = false;
     config->enable_logging = true;
+    config->log_level = LOG_DEBUG;
+    config->status_uri = safe_strdup("/server-status");
+    config->slow_request_threshold_ms = 1000;
+    config->admission_control = true;
+    config->admission_target_ms = 5;
+    config->admission_interval_ms = 100;
+    config->max_connections = 0;
+    config->retry_after = 1;
+    config->listen_backlog = 1024;
+    config->tcp_nodelay = false;
+    config->defer_accept = 0;
+    config->fastopen_queue = 0;
+    config->send_buffer = 0;
+    config->recv_buffer = 0;
+    config->tcp_cork = false;
+    config->routes = router_create();
+    compile_routes(config);
     
     LOG_INFO("Configuration initialized with default values");
 }
@@ -86,6 +139,8 @@ bool config_load(server_config *config, const char *filename) {
     
     char line[512];
     char current_section[64] = "";
+    // Routes replace the defaults from config_init, they are compiled once the whole file is read
+    route_table *routes = router_create();
     
     while (fgets(line, sizeof(line), file)) {
         // Remove trailing newline
@@ -138,6 +193,10 @@ bool config_load(server_config *config, const char *filename) {
                 free(config->server_name);
                 config->server_name = safe_strdup(value);
             }
+            else if (strcmp(key, "MimeTypes") == 0) {
+                free(config->mime_types_file);
+                config->mime_types_file = value[0] ? safe_strdup(value) : NULL;
+            }
         }
         else if (strcmp(current_section, "Directories") == 0) {
             if (strcmp(key, "CgiBinPath") == 0) {
@@ -170,6 +229,111 @@ bool config_load(server_config *config, const char *filename) {
                     LOG_WARN("Invalid ConnectionTimeout value: %s, using default", value);
                 }
             }
+            else if (strcmp(key, "KeepAliveTimeout") == 0) {
+                int timeout = atoi(value);
+                if (timeout > 0) {
+                    config->keepalive_timeout = (unsigned int)timeout;
+                } else {
+                    LOG_WARN("Invalid KeepAliveTimeout value: %s, using ConnectionTimeout", value);
+                }
+            }
+            else if (strcmp(key, "HeaderTimeout") == 0) {
+                int timeout = atoi(value);
+                if (timeout > 0) {
+                    config->header_timeout = (unsigned int)timeout;
+                } else {
+                    LOG_WARN("Invalid HeaderTimeout value: %s, using ConnectionTimeout", value);
+                }
+            }
+            else if (strcmp(key, "SendTimeout") == 0) {
+                int timeout = atoi(value);
+                if (timeout > 0) {
+                    config->send_timeout = (unsigned int)timeout;
+                } else {
+                    LOG_WARN("Invalid SendTimeout value: %s, using ConnectionTimeout", value);
+                }
+            }
+            else if (strcmp(key, "DrainTimeout") == 0) {
+                int timeout = atoi(value);
+                if (timeout >= 0) {
+                    config->drain_timeout = (unsigned int)timeout;
+                } else {
+                    LOG_WARN("Invalid DrainTimeout value: %s, using default", value);
+                }
+            }
+            else if (strcmp(key, "ListenerMode") == 0) {
+                if (strcmp(value, "single") == 0) {
+                    config->reuseport_listeners = false;
+                } else if (strcmp(value, "reuseport") == 0) {
+                    config->reuseport_listeners = true;
+                } else {
+                    LOG_WARN("Invalid ListenerMode value: %s, using default", value);
+                }
+            }
+            else if (strcmp(key, "ReusePortCpuSteering") == 0) {
+                if (strcmp(value, "true") == 0 || strcmp(value, "1") == 0) {
+                    config->reuseport_cpu_steering = true;
+                } else if (strcmp(value, "false") == 0 || strcmp(value, "0") == 0) {
+                    config->reuseport_cpu_steering = false;
+                } else {
+                    LOG_WARN("Invalid ReusePortCpuSteering value: %s, using default", value);
+                }
+            }
+            else if (strcmp(key, "IoEngine") == 0) {
+                if (strcmp(value, "blocking") == 0) {
+                    config->io_uring_engine = false;
+                } else if (strcmp(value, "io_uring") == 0) {
+                    config->io_uring_engine = true;
+                } else {
+                    LOG_WARN("Invalid IoEngine value: %s, using default", value);
+                }
+            }
+            else if (strcmp(key, "CpuAffinity") == 0) {
+                free(config->cpu_affinity);
+                config->cpu_affinity = safe_strdup(value);
+            }
+            else if (strcmp(key, "PathCacheEntries") == 0) {
+                int entries = atoi(value);
+                if (entries >= 0) {
+                    config->path_cache_entries = (unsigned int)entries;
+                } else {
+                    LOG_WARN("Invalid PathCacheEntries value: %s, using default", value);
+                }
+            }
+            else if (strcmp(key, "PathCacheTtl") == 0) {
+                int ttl = atoi(value);
+                if (ttl > 0) {
+                    config->path_cache_ttl = (unsigned int)ttl;
+                } else {
+                    LOG_WARN("Invalid PathCacheTtl value: %s, using default", value);
+                }
+            }
+            else if (strcmp(key, "PathCacheMissingTtl") == 0) {
+                int ttl = atoi(value);
+                if (ttl >= 0) {
+                    config->path_cache_missing_ttl = (unsigned int)ttl;
+                } else {
+                    LOG_WARN("Invalid PathCacheMissingTtl value: %s, using default", value);
+                }
+            }
+            else if (strcmp(key, "PathCacheWatch") == 0) {
+                if (strcmp(value, "true") == 0 || strcmp(value, "1") == 0) {
+                    config->path_cache_watch = true;
+                } else if (strcmp(value, "false") == 0 || strcmp(value, "0") == 0) {
+                    config->path_cache_watch = false;
+                } else {
+                    LOG_WARN("Invalid PathCacheWatch value: %s, using default", value);
+                }
+            }
+            else if (strcmp(key, "PathCacheBloom") == 0) {
+                if (strcmp(value, "true") == 0 || strcmp(value, "1") == 0) {
+                    config->path_cache_bloom = true;
+                } else if (strcmp(value, "false") == 0 || strcmp(value, "0") == 0) {
+                    config->path_cache_bloom = false;
+                } else {
+                    LOG_WARN("Invalid PathCacheBloom value: %s, using default", value);
+                }
+            }
         }
         else if (strcmp(current_section, "Logging") == 0) {
             if (strcmp(key, "EnableLogging") == 0) {
@@ -185,6 +349,135 @@ bool config_load(server_config *config, const char *filename) {
                 free(config->log_directory);
                 config->log_directory = safe_strdup(value);
             }
+            else if (strcmp(key, "LogLevel") == 0) {
+                if (log_parse_level(value, &config->log_level) < 0) {
+                    LOG_WARN("Invalid LogLevel value: %s, using default", value);
+                }
+            }
+        }
+        else if (strcmp(current_section, "Monitoring") == 0) {
+            if (strcmp(key, "StatusUri") == 0) {
+                free(config->status_uri);
+                // An empty value disables the status page
+                config->status_uri = value[0] ? safe_strdup(value) : NULL;
+            }
+            else if (strcmp(key, "SlowRequestThresholdMs") == 0) {
+                int threshold = atoi(value);
+                if (threshold >= 0) {
+                    config->slow_request_threshold_ms = (unsigned int)threshold;
+                } else {
+                    LOG_WARN("Invalid SlowRequestThresholdMs value: %s, using default", value);
+                }
+            }
+        }
+        else if (strcmp(current_section, "Admission") == 0) {
+            if (strcmp(key, "AdmissionControl") == 0) {
+                if (strcmp(value, "true") == 0 || strcmp(value, "1") == 0) {
+                    config->admission_control = true;
+                } else if (strcmp(value, "false") == 0 || strcmp(value, "0") == 0) {
+                    config->admission_control = false;
+                } else {
+                    LOG_WARN("Invalid AdmissionControl value: %s, using default", value);
+                }
+            }
+            else if (strcmp(key, "QueueDelayTargetMs") == 0) {
+                int target = atoi(value);
+                if (target > 0) {
+                    config->admission_target_ms = (unsigned int)target;
+                } else {
+                    LOG_WARN("Invalid QueueDelayTargetMs value: %s, using default", value);
+                }
+            }
+            else if (strcmp(key, "QueueDelayIntervalMs") == 0) {
+                int interval = atoi(value);
+                if (interval > 0) {
+                    config->admission_interval_ms = (unsigned int)interval;
+                } else {
+                    LOG_WARN("Invalid QueueDelayIntervalMs value: %s, using default", value);
+                }
+            }
+            else if (strcmp(key, "MaxConnections") == 0) {
+                int max_connections = atoi(value);
+                if (max_connections >= 0) {
+                    config->max_connections = (unsigned int)max_connections;
+                } else {
+                    LOG_WARN("Invalid MaxConnections value: %s, using default", value);
+                }
+            }
+            else if (strcmp(key, "RetryAfter") == 0) {
+                int retry_after = atoi(value);
+                if (retry_after >= 0) {
+                    config->retry_after = (unsigned int)retry_after;
+                } else {
+                    LOG_WARN("Invalid RetryAfter value: %s, using default", value);
+                }
+            }
+        }
+        else if (strcmp(current_section, "Network") == 0) {
+            if (strcmp(key, "ListenBacklog") == 0) {
+                int backlog = atoi(value);
+                if (backlog > 0) {
+                    config->listen_backlog = (unsigned int)backlog;
+                } else {
+                    LOG_WARN("Invalid ListenBacklog value: %s, using default", value);
+                }
+            }
+            else if (strcmp(key, "TcpNoDelay") == 0) {
+                if (strcmp(value, "true") == 0 || strcmp(value, "1") == 0) {
+                    config->tcp_nodelay = true;
+                } else if (strcmp(value, "false") == 0 || strcmp(value, "0") == 0) {
+                    config->tcp_nodelay = false;
+                } else {
+                    LOG_WARN("Invalid TcpNoDelay value: %s, using default", value);
+                }
+            }
+            else if (strcmp(key, "DeferAccept") == 0) {
+                int seconds = atoi(value);
+                if (seconds >= 0) {
+                    config->defer_accept = (unsigned int)seconds;
+                } else {
+                    LOG_WARN("Invalid DeferAccept value: %s, using default", value);
+                }
+            }
+            else if (strcmp(key, "FastOpenQueue") == 0) {
+                int queue = atoi(value);
+                if (queue >= 0) {
+                    config->fastopen_queue = (unsigned int)queue;
+                } else {
+                    LOG_WARN("Invalid FastOpenQueue value: %s, using default", value);
+                }
+            }
+            else if (strcmp(key, "SendBuffer") == 0) {
+                int size = atoi(value);
+                if (size >= 0) {
+                    config->send_buffer = (unsigned int)size;
+                } else {
+                    LOG_WARN("Invalid SendBuffer value: %s, using default", value);
+                }
+            }
+            else if (strcmp(key, "RecvBuffer") == 0) {
+                int size = atoi(value);
+                if (size >= 0) {
+                    config->recv_buffer = (unsigned int)size;
+                } else {
+                    LOG_WARN("Invalid RecvBuffer value: %s, using default", value);
+                }
+            }
+            else if (strcmp(key, "TcpCork") == 0) {
+                if (strcmp(value, "true") == 0 || strcmp(value, "1") == 0) {
+                    config->tcp_cork = true;
+                } else if (strcmp(value, "false") == 0 || strcmp(value, "0") == 0) {
+                    config->tcp_cork = false;
+                } else {
+                    LOG_WARN("Invalid TcpCork value: %s, using default", value);
+                }
+            }
+        }
+        else if (strcmp(current_section, "Routes") == 0) {
+            // The key is the pattern, the value the rule
+            if (routes && router_add(routes, key, value) < 0) {
+                LOG_WARN("Route %s skipped", key);
+            }
         }
         // Unknown section or key - ignore with warning
         else {
@@ -236,6 +529,15 @@ bool config_load(server_config *config, const char *filename) {
         }
     }
     
+    // Deadlines that were not set explicitly fall back to ConnectionTimeout
+    if (config->keepalive_timeout == 0) config->keepalive_timeout = config->connection_timeout;
+    if (config->header_timeout == 0) config->header_timeout = config->connection_timeout;
+    if (config->send_timeout == 0) config->send_timeout = config->connection_timeout;
+    
+    router_destroy(config->routes);
+    config->routes = routes;
+    compile_routes(config);
+    
     if (valid) {
         LOG_INFO("Configuration loaded successfully");
     } else {
@@ -258,6 +560,10 @@ void config_cleanup(server_config *config) {
     free(config->log_directory);
     free(config->dynamic_dir_name);
     free(config->static_dir_name);
+    free(config->status_uri);
+    free(config->cpu_affinity);
+    free(config->mime_types_file);
+    router_destroy(config->routes);
     
     // Reset values to prevent use-after-free
     config->port = NULL;
@@ -267,6 +573,66 @@ void config_cleanup(server_config *config) {
     config->log_directory = NULL;
     config->dynamic_dir_name = NULL;
     config->static_dir_name = NULL;
+    config->status_uri = NULL;
+    config->cpu_affinity = NULL;
+    config->mime_types_file = NULL;
+    config->routes = NULL;
     
     LOG_INFO("Configuration resources cleaned up");
-}
\ No newline at end of file
+}
+
+/**
+ * A snapshot and its reference count. config comes first so the server_config pointer handed out
+ * converts back to its snapshot
+ */
+typedef struct {
+    server_config config;
+    unsigned int references;
+} config_snapshot;
+
+// Guards current_snapshot while a reference to it is taken, so it can't be freed in between
+static pthread_mutex_t snapshot_lock = PTHREAD_MUTEX_INITIALIZER;
+static config_snapshot *current_snapshot = NULL;
+
+server_config *config_snapshot_load(const char *filename) {
+    config_snapshot *snapshot = malloc(sizeof(config_snapshot));
+    if (!snapshot) {
+        LOG_ERROR("Failed to allocate configuration snapshot");
+        return NULL;
+    }
+    config_init(&snapshot->config);
+    snapshot->references = 1;
+    if (!config_load(&snapshot->config, filename)) {
+        config_cleanup(&snapshot->config);
+        free(snapshot);
+        return NULL;
+    }
+    return &snapshot->config;
+}
+
+void config_snapshot_publish(server_config *config) {
+    pthread_mutex_lock(&snapshot_lock);
+    config_snapshot *previous = current_snapshot;
+    current_snapshot = (config_snapshot *)config;
+    pthread_mutex_unlock(&snapshot_lock);
+    config_snapshot_release(previous ? &previous->config : NULL);
+}
+
+server_config *config_snapshot_acquire(void) {
+    pthread_mutex_lock(&snapshot_lock);
+    config_snapshot *snapshot = current_snapshot;
+    if (snapshot) {
+        __atomic_add_fetch(&snapshot->references, 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&snapshot_lock);
+    return snapshot ? &snapshot->config : NULL;
+}
+
+void config_snapshot_release(server_config *config) {
+    if (!config) return;
+    config_snapshot *snapshot = (config_snapshot *)config;
+    if (__atomic_sub_fetch(&snapshot->references, 1, __ATOMIC_ACQ_REL) == 0) {
+        config_cleanup(&snapshot->config);
+        free(snapshot);
+    }
+}
@@ -22,7 +22,7 @@ int main(int argc, char ** argv)  {
     }
     
     char * port = argv[1];
-    int listenfd =  open_listenfd(port);
+    int listenfd =  open_listenfd(port, NULL);
     struct sockaddr_storage client_addr; // ensures that all types of client addresses are compatible
     socklen_t addrlen = sizeof(struct sockaddr_storage);
     char buf[BUFFER_SIZE];
@@ -0,0 +1,172 @@
+#include "handoff.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+// Write end of the readiness pipe of the process that started this one, -1 if there is none
+static int ready_fd = -1;
+
+static bool is_listening_socket(int fd) {
+    int listening = 0;
+    socklen_t length = sizeof(listening);
+    return getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &length) == 0 && listening;
+}
+
+int handoff_inherited_listeners(int *fds, int max) {
+    const char *ready = getenv(HANDOFF_READY_FD_ENV);
+    if (ready) {
+        ready_fd = atoi(ready);
+        // Scripts started by this process must not be able to signal readiness
+        if (ready_fd > 2) {
+            fcntl(ready_fd, F_SETFD, FD_CLOEXEC);
+        } else {
+            ready_fd = -1;
+        }
+        unsetenv(HANDOFF_READY_FD_ENV);
+    }
+
+    const char *list = getenv(HANDOFF_LISTEN_FDS_ENV);
+    if (!list) return 0;
+
+    int count = 0;
+    const char *cursor = list;
+    while (*cursor && count < max) {
+        char *end = NULL;
+        long fd = strtol(cursor, &end, 10);
+        if (end == cursor) break;
+        if (fd > 2 && fd < INT32_MAX && is_listening_socket((int)fd)) {
+            fds[count++] = (int)fd;
+        } else {
+            LOG_WARN("Ignoring inherited descriptor %ld, it is not a listening socket", fd);
+        }
+        cursor = *end == ',' ? end + 1 : end;
+    }
+    unsetenv(HANDOFF_LISTEN_FDS_ENV);
+    return count;
+}
+
+void handoff_notify_ready(void) {
+    if (ready_fd < 0) return;
+    char byte = 'R';
+    if (write(ready_fd, &byte, 1) != 1) {
+        LOG_WARN("Failed to notify the previous server process: %s", strerror(errno));
+    }
+    close(ready_fd);
+    ready_fd = -1;
+}
+
+/*
+Copy of environ without earlier handoff variables, followed by extra (NULL terminated).
+Returns NULL on allocation failure
+*/
+static char **build_environment(char **extra) {
+    size_t count = 0, extra_count = 0;
+    while (environ[count]) count++;
+    while (extra[extra_count]) extra_count++;
+
+    char **env = calloc(count + extra_count + 1, sizeof(char *));
+    if (!env) return NULL;
+    size_t used = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (strncmp(environ[i], HANDOFF_LISTEN_FDS_ENV "=", sizeof(HANDOFF_LISTEN_FDS_ENV)) == 0 ||
+            strncmp(environ[i], HANDOFF_READY_FD_ENV "=", sizeof(HANDOFF_READY_FD_ENV)) == 0) {
+            continue;
+        }
+        env[used++] = environ[i];
+    }
+    for (size_t i = 0; i < extra_count; ++i) {
+        env[used++] = extra[i];
+    }
+    env[used] = NULL;
+    return env;
+}
+
+int handoff_spawn_successor(const char *executable, char **argv, const int *fds, int count) {
+    if (!executable || !argv || !fds || count <= 0) {
+        LOG_ERROR("Invalid parameters passed to handoff_spawn_successor");
+        return -1;
+    }
+
+    int ready_pipe[2];
+    if (pipe(ready_pipe) < 0) {
+        LOG_ERROR("Failed to create readiness pipe: %s", strerror(errno));
+        return -1;
+    }
+    fcntl(ready_pipe[0], F_SETFD, FD_CLOEXEC);
+
+    // Everything the child needs is prepared up front, only async-signal-safe calls are allowed
+    // between fork and exec in a multithreaded process
+    char listen_fds[HANDOFF_MAX_LISTENERS * 12 + sizeof(HANDOFF_LISTEN_FDS_ENV) + 1];
+    size_t offset = (size_t)snprintf(listen_fds, sizeof(listen_fds), "%s=", HANDOFF_LISTEN_FDS_ENV);
+    for (int i = 0; i < count && offset < sizeof(listen_fds); ++i) {
+        offset += (size_t)snprintf(listen_fds + offset, sizeof(listen_fds) - offset, i ? ",%d" : "%d", fds[i]);
+    }
+    char ready_env[sizeof(HANDOFF_READY_FD_ENV) + 16];
+    snprintf(ready_env, sizeof(ready_env), "%s=%d", HANDOFF_READY_FD_ENV, ready_pipe[1]);
+    char *extra[] = { listen_fds, ready_env, NULL };
+    char **env = build_environment(extra);
+    if (!env) {
+        LOG_ERROR("Failed to build environment for the successor");
+        close(ready_pipe[0]);
+        close(ready_pipe[1]);
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        LOG_ERROR("Failed to fork successor: %s", strerror(errno));
+        free(env);
+        close(ready_pipe[0]);
+        close(ready_pipe[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        for (int i = 0; i < count; ++i) {
+            fcntl(fds[i], F_SETFD, 0);
+        }
+        // The signal mask survives exec, the forking thread has the control signals blocked
+        sigset_t empty;
+        sigemptyset(&empty);
+        sigprocmask(SIG_SETMASK, &empty, NULL);
+        execve(executable, argv, env);
+        _exit(127);
+    }
+
+    free(env);
+    close(ready_pipe[1]);
+    LOG_INFO("Started successor %s (pid %d), waiting for it to accept", executable, (int)pid);
+
+    struct pollfd ready = { .fd = ready_pipe[0], .events = POLLIN };
+    int polled;
+    do {
+        polled = poll(&ready, 1, HANDOFF_READY_TIMEOUT_MS);
+    } while (polled < 0 && errno == EINTR);
+    char byte = 0;
+    ssize_t got = polled > 0 ? read(ready_pipe[0], &byte, 1) : 0;
+    close(ready_pipe[0]);
+
+    if (got == 1) {
+        LOG_INFO("Successor (pid %d) is accepting connections", (int)pid);
+        return 0;
+    }
+    if (polled == 0) {
+        LOG_ERROR("Successor (pid %d) did not report ready within %dms, stopping it", (int)pid, HANDOFF_READY_TIMEOUT_MS);
+        kill(pid, SIGKILL);
+    } else {
+        LOG_ERROR("Successor (pid %d) exited before accepting connections", (int)pid);
+    }
+    waitpid(pid, NULL, 0);
+    return -1;
+}
@@ -5,6 +5,8 @@
 #include "utils.h"
 #include <stdio.h>
 #include "logger.h"
+#include "probes.h"
+#include "scan.h"
 #include <stdlib.h>
 #include <ctype.h>
 #include <errno.h>
@@ -14,84 +16,95 @@
 
 
 
-/*
-TO DO:
+static http_request * parse_request(char * client_request, http_request * request, server_config * config);
 
-Implement sanitization and normalization to avoid injections. 
-Will do this probably after STAGE 3
-*/
+http_request * parse_http_request(char * client_request, http_request * request, server_config * config) {
+    PROBE1(parse__start, client_request);
+    http_request * parsed = parse_request(client_request, request, config);
+    PROBE2(parse__done, parsed ? parsed->path : NULL, parsed ? 0 : -1);
+    return parsed;
+}
 
+/*
+Returns the next run of non-blank characters before end and moves *cursor past it, like sscanf's %s.
+The view is empty if the line has no more tokens
+*/
+static str_view next_token(char ** cursor, const char * end) {
+    char * start = *cursor;
+    while (start < end && (*start == ' ' || *start == '\t')) start++;
+    char * stop = (char *) scan_find_either(start, end, ' ', '\t');
+    *cursor = stop;
+    return (str_view){ start, (size_t) (stop - start) };
+}
 
-http_request * parse_http_request(char * client_request, http_request * request, server_config * config) {
+static http_request * parse_request(char * client_request, http_request * request, server_config * config) {
     if (!request || !client_request || !config) {
         LOG_ERROR("NULL parameter passed to parse_http_request");
         return NULL;
     }
     
-    // 1. Split the stirng by \r\n pair and strip \r\n from each splitted string 
-
-    // 2. Read the HTTP method and the URI, call the respective method from request_handler.c to carry out the method on the file given by the URI
-    char * crlf = strstr(client_request, "\r\n");
-    if (!crlf) {
+    // Tokenize the request line in place: METHOD SP URI SP VERSION CRLF
+    char * request_end = client_request + strlen(client_request);
+    char * crlf = (char *) scan_find_pair(client_request, request_end, '\r', '\n');
+    if (crlf == request_end) {
         LOG_ERROR("Malformed request - no CRLF found");
         return NULL;
     }
-    ptrdiff_t line_length = crlf - client_request; 
-    if(line_length >= BUFFER_SIZE) { // We need it to be atleast one smaller than buffer size to incorporate a null character
-        LOG_ERROR("Request line length exceeds maximum allowed length");
+    // A bare CR, LF or other control byte in the request line could end up in a response header (the
+    // query of a redirect)
+    for (const char * c = client_request; c < crlf; ++c) {
+        unsigned char byte = (unsigned char) *c;
+        if ((byte < ' ' && byte != '\t') || byte == 0x7F) {
+            LOG_ERROR("Malformed request - control character in the request line");
+            return NULL;
+        }
+    }
+    char * cursor = client_request;
+    str_view METHOD = next_token(&cursor, crlf);
+    str_view URI_VIEW = next_token(&cursor, crlf);
+    str_view VERSION = next_token(&cursor, crlf);
+    if (!VERSION.length) {
+        // Handle error - malformed request
+        LOG_ERROR("Error parsing request line");
         return NULL;
     }
-    char request_line[BUFFER_SIZE];
-    strncpy(request_line, client_request, line_length);
-    request_line[line_length] = '\0';
-    
-    char METHOD[BUFFER_SIZE], URI[BUFFER_SIZE], VERSION[BUFFER_SIZE]; 
-    char sscanf_format_string[100];
-    
-
+    char * URI = client_request + (URI_VIEW.data - client_request); // writable alias of the URI token
+    char * uri_end = URI + URI_VIEW.length;
 
-    sprintf(sscanf_format_string, "%%%ds %%%ds %%%ds",
-        BUFFER_SIZE - 1,
-        BUFFER_SIZE - 1,
-        BUFFER_SIZE - 1);
-    
-    #pragma GCC diagnostic push
-    #pragma GCC diagnostic ignored "-Wformat-nonliteral"
-    int result = sscanf(request_line, sscanf_format_string, METHOD, URI, VERSION);
-    #pragma GCC diagnostic pop
-
-    if(strlen(URI) > MAX_URI_LENGTH) {
+    if(URI_VIEW.length > MAX_URI_LENGTH) {
         LOG_ERROR("URI path exceeds maximum allowed length");
         return NULL;
     }
-    // Validate parsing success
-    if (result != 3) {
-    // Handle error - malformed request
-        LOG_ERROR("Error parsing request line");
-        return NULL;
-    }
 
-    
     // Will add support for other methods soon
-    if(strcmp("GET", METHOD)) {
-        LOG_ERROR("Server only supports GET requests. Current HTTP request : %s", METHOD);
+    if(!str_view_equals(METHOD, "GET")) {
+        LOG_ERROR("Server only supports GET requests. Current HTTP request : %.*s", (int) METHOD.length, METHOD.data);
         return NULL;
     }
-    if(strcmp("HTTP/1.1", VERSION) != 0 && strcmp("HTTP/1.0", VERSION) != 0){
-        LOG_ERROR("Only supports HTTP_1_1 and HTTP_1_0. Requested HTTP Version : %s. NOT SUPPORTED", VERSION);
+    bool http_1_0 = str_view_equals(VERSION, "HTTP/1.0");
+    if(!http_1_0 && !str_view_equals(VERSION, "HTTP/1.1")){
+        LOG_ERROR("Only supports HTTP_1_1 and HTTP_1_0. Requested HTTP Version : %.*s. NOT SUPPORTED", (int) VERSION.length, VERSION.data);
         return NULL;
     }
     if(URI[0] != '/'){
         LOG_ERROR("Invalid URI format. URI must start with /. Passed URI starts with : %c", URI[0]);
         return NULL;
     }
-    // Add a check to ensure that URI fits in BUFFER_SIZE
 
-    request->version = (strcmp(VERSION, "HTTP/1.0") == 0) ? HTTP_1_0 : HTTP_1_1;
-    LOG_DEBUG("Set version to %s", VERSION);
+    request->method_name = METHOD;
+    request->version_name = VERSION;
+    request->version = http_1_0 ? HTTP_1_0 : HTTP_1_1;
+    LOG_DEBUG("Set version to %.*s", (int) VERSION.length, VERSION.data);
     request->method = GET;
-    LOG_DEBUG("Set method to %s", METHOD);
+    LOG_DEBUG("Set method to %.*s", (int) METHOD.length, METHOD.data);
     
+    if(parse_request_headers(crlf + 2, &request->headers) == -1) {
+        LOG_ERROR("Parsing failed - Malformed request headers");
+        return NULL;
+    }
+    
+    // The URI becomes a string of its own, the path is decoded in place inside it
+    *uri_end = '\0';
     if(parse_uri(URI, request, config) == -1) {
         LOG_ERROR("Parsing failed - Failed to parse URI");
         return NULL;
@@ -103,120 +116,237 @@ http_request * parse_http_request(char * client_request, http_request * request,
 
 int parse_uri(char *URI, http_request *request, server_config *config) {
     
+    /*
+    Split at the '?' before decoding, so an escaped "%3F" stays part of the path. The query is kept as
+    sent: CGI scripts get it verbatim and parse_query_params splits and decodes it only when asked to
+    */
+    char *query_string = strchr(URI, '?');
+    if (query_string) {
+        *query_string = '\0';  // Split URI at '?'
+        query_string++;        // Move pointer to start of query string
+        request->query = (str_view){ query_string, strlen(query_string) };
+    } else {
+        request->query = (str_view){ "", 0 };
+    }
+
     if(url_decode(URI)) {
         LOG_ERROR("Failed to decode URI encoding.");
         return -1;
     }
+    // After decoding, so escaped dots and slashes are normalized too
+    if(normalize_path(URI)) {
+        LOG_ERROR("Request path escapes the root or contains control characters.");
+        return -1;
+    }
 
-    char *query_string = NULL;
-    char * uri_ptr = URI;
+    // The route decides how the request is served, CGI routes are the dynamic ones
+    request->route = router_match(config->routes, URI);
+    request->is_dynamic = request->route && request->route->action == ROUTE_CGI;
+    
+    // The path is the NUL terminated part of URI before the '?', no copy needed
+    request->path = URI;
+    // Determine MIME type based on file extension
+    request->mime = mime_for_path(request->path);
+    request->mime_type = request->mime->type;
+    
+    return 0;
+}
 
-    // Check if URI contains query string. 
-    // strchr(src, target) returns pointer to the first occurrence of char target in string src or NULL if nothing is found 
-    query_string = strchr(URI, '?');
-    if (query_string) {
-        *query_string = '\0';  // Split URI at '?'
-        query_string++;        // Move pointer to start of query string
+int parse_query_params(http_request *request) {
+    if (!request) {
+        LOG_ERROR("NULL parameter passed to parse_query_params");
+        return -1;
     }
-    
-    // Determine if request is for static or dynamic content. Potential problem wouldn't uri_copy start with the backslash
-    request->is_dynamic = false;
-    uri_ptr += 1; // to skip / so that uri_ptr points to the static/dynamic directory or just '\0'
-    size_t dynamic_dir_len = strlen(config->dynamic_dir_name);
-    if (!strncmp(uri_ptr, config->dynamic_dir_name, dynamic_dir_len)) {
-        // Check if this is a complete path component by verifying that
-        // the next character is either '/' or '\0'
-        if (uri_ptr[dynamic_dir_len] == '/' || uri_ptr[dynamic_dir_len] == '\0') {
-            request->is_dynamic = true;
-        }
+    if (request->params_parsed) return request->param_count;
+
+    const char *query = request->query.data;
+    size_t length = request->query.length;
+    int count = 0;
+    if (length > 0) {
+        count = 1;
+        for (const char *c = query; (c = memchr(c, '&', length - (size_t) (c - query))); c++) count++;
     }
-    
-    
-    // Set path in request. 
-    // The strdup() function allocates sufficient memory for a copy of the string s1, does the copy, and returns a pointer to it.  The pointer may subsequently be used as an argument to the function free(3).
-    request->path = strdup(URI); 
-    if (!request->path) {
-        LOG_ERROR("Memory allocation failed for request path. ERROR : %s", strerror(errno));
+    if (count == 0) {
+        request->params_parsed = true;
+        request->param_count = 0;
+        return 0;
+    }
+
+    /*
+    A single block holds both view arrays followed by a copy of the query, which is cut at every '&'
+    and '=' and decoded piece by piece. The query in the request buffer stays as it was sent
+    */
+    size_t arrays_size = 2 * (size_t) count * sizeof(str_view);
+    str_view *block = malloc(arrays_size + length + 1);
+    if (!block) {
+        LOG_ERROR("Memory allocation failed for parameters");
         return -1;
     }
-    // Determine MIME type based on file extension
-    request->mime_type = get_mime_type(request->path);
-    
-    // Process query string for dynamic requests
-    if (request->is_dynamic && query_string) {
-        // Count parameters
-        int count = 1;  // Start with 1 for first parameter
-        for (char *c = query_string; *c; c++) {
-            if (*c == '&') {
-                count++;
-            }
-        }
-        
-        // Allocate memory for parameter arrays
-        request->param_count = count;
-        request->param_names = (char**)malloc((size_t)count * sizeof(char*));
-        request->param_values = (char**)malloc((size_t)count * sizeof(char*));
-        
-        // free(NULL) is fine and does nothing
-        if (!request->param_names || !request->param_values) {
-            LOG_ERROR("Memory allocation failed for parameters");
-            free(request->param_names);
-            free(request->param_values);
-            request->param_names = NULL;
-            request->param_values = NULL;
-            request->param_count = 0;
-            return -1;
-        }
-        
-        // Initialize arrays to NULL for proper cleanup in case of error
-        for (int i = 0; i < count; i++) {
-            request->param_names[i] = NULL;
-            request->param_values[i] = NULL;
-        }
-        // strtok() modifies the query_string in-place by inserting null terminators in-place of the passed delimeter. 
-        char *token = strtok(query_string, "&");
-        int param_index = 0;
-        
-        while (token && param_index < count) {
+    str_view *names = block;
+    str_view *values = block + count;
+    char *text = (char *) block + arrays_size;
+    memcpy(text, query, length);
+    text[length] = '\0';
+
+    // Empty parameters ("a&&b") are skipped, a parameter without '=' has an empty value
+    int param_index = 0;
+    char *token = text;
+    while (param_index < count) {
+        char *token_end = strchr(token, '&');
+        if (token_end) *token_end = '\0';
+        if (*token) {
             char *value = strchr(token, '=');
             if (value) {
-                *value = '\0';  // Split token at '='
-                value++;        // Move to value portion
-                request->param_names[param_index] = strdup(token);
-                request->param_values[param_index] = strdup(value);
-                
-                if (!request->param_names[param_index] || !request->param_values[param_index]) {
-                    LOG_ERROR("Memory allocation failed for parameter strings");
-                    // Cleanup will be handled by caller
-                    return -1;
-                }
+                *value++ = '\0';
             } else {
-                // Handle parameters without values (e.g., "flag" in "?flag")
-                request->param_names[param_index] = strdup(token);
-                request->param_values[param_index] = strdup("");  // Empty string for value
-                
-                if (!request->param_names[param_index] || !request->param_values[param_index]) {
-                    LOG_ERROR("Memory allocation failed for parameter strings");
-                    return -1;
-                }
+                value = token + strlen(token);
             }
-            
+            url_decode(token);
+            url_decode(value);
+            names[param_index] = (str_view){ token, strlen(token) };
+            values[param_index] = (str_view){ value, strlen(value) };
             param_index++;
-            token = strtok(NULL, "&");
         }
-    } else {
-        // Non-dynamic requests don't have parameters
-        request->param_count = 0;
-        request->param_names = NULL;
-        request->param_values = NULL;
+        if (!token_end) break;
+        token = token_end + 1;
+    }
+
+    request->param_names = names;
+    request->param_values = values;
+    request->param_count = param_index;
+    request->params_parsed = true;
+    return param_index;
+}
+
+/*
+FNV-1a hashes of the lower case names of the headers with an ID, computed ahead of time. A header
+name is hashed while its colon is searched, the switch in header_id turns the hash into an ID and a
+single comparison rules out collisions
+*/
+#define FNV_OFFSET_BASIS 0x811c9dc5u
+#define FNV_PRIME        0x01000193u
+
+static const char * const header_names[HEADER_ID_COUNT] = {
+    [HEADER_HOST] = "host",
+    [HEADER_CONNECTION] = "connection",
+    [HEADER_KEEP_ALIVE] = "keep-alive",
+    [HEADER_UPGRADE] = "upgrade",
+    [HEADER_CONTENT_LENGTH] = "content-length",
+    [HEADER_CONTENT_TYPE] = "content-type",
+    [HEADER_TRANSFER_ENCODING] = "transfer-encoding",
+    [HEADER_EXPECT] = "expect",
+    [HEADER_RANGE] = "range",
+    [HEADER_IF_RANGE] = "if-range",
+    [HEADER_IF_NONE_MATCH] = "if-none-match",
+    [HEADER_IF_MODIFIED_SINCE] = "if-modified-since",
+    [HEADER_ACCEPT] = "accept",
+    [HEADER_ACCEPT_ENCODING] = "accept-encoding",
+    [HEADER_USER_AGENT] = "user-agent",
+    [HEADER_COOKIE] = "cookie",
+    [HEADER_REFERER] = "referer",
+    [HEADER_AUTHORIZATION] = "authorization",
+};
+
+static HEADER_ID header_id(uint32_t hash, str_view name) {
+    HEADER_ID id;
+    switch (hash) {
+        case 0xaffea56fu: id = HEADER_HOST; break;
+        case 0x38b99ed9u: id = HEADER_CONNECTION; break;
+        case 0xe18edb80u: id = HEADER_KEEP_ALIVE; break;
+        case 0xdc97cc77u: id = HEADER_UPGRADE; break;
+        case 0x4df9451du: id = HEADER_CONTENT_LENGTH; break;
+        case 0xfcf70995u: id = HEADER_CONTENT_TYPE; break;
+        case 0xddb4744cu: id = HEADER_TRANSFER_ENCODING; break;
+        case 0x96da6b58u: id = HEADER_EXPECT; break;
+        case 0xfadc0cd2u: id = HEADER_RANGE; break;
+        case 0x8b887e3eu: id = HEADER_IF_RANGE; break;
+        case 0x972b6177u: id = HEADER_IF_NONE_MATCH; break;
+        case 0x83e879a9u: id = HEADER_IF_MODIFIED_SINCE; break;
+        case 0x08247e29u: id = HEADER_ACCEPT; break;
+        case 0xc9715a99u: id = HEADER_ACCEPT_ENCODING; break;
+        case 0x24259beeu: id = HEADER_USER_AGENT; break;
+        case 0x77a740bfu: id = HEADER_COOKIE; break;
+        case 0xec9af966u: id = HEADER_REFERER; break;
+        case 0x913657beu: id = HEADER_AUTHORIZATION; break;
+        default: return HEADER_OTHER;
+    }
+    const char *expected = header_names[id];
+    return strlen(expected) == name.length && strncasecmp(expected, name.data, name.length) == 0 ? id : HEADER_OTHER;
+}
+
+int parse_request_headers(const char *headers, header_table *table) {
+    if (!headers || !table) {
+        LOG_ERROR("NULL parameter passed to parse_request_headers");
+        return -1;
+    }
+    table->count = 0;
+    memset(table->known, 0, sizeof(table->known));
+
+    const char *end = headers + strlen(headers);
+    const char *line = headers;
+    while (line < end && *line != '\r' && *line != '\n') { // an empty line ends the headers
+        // Name: token characters up to the colon, hashed once the colon is found
+        const char *cursor = scan_find_either(line, end, ':', '\n');
+        uint32_t hash = FNV_OFFSET_BASIS;
+        const char *name_char = line;
+        for (; name_char < cursor && *name_char > ' ' && *name_char != 0x7f; ++name_char) {
+            hash = (hash ^ (uint32_t) (unsigned char) tolower((unsigned char) *name_char)) * FNV_PRIME;
+        }
+        if (cursor == end || *cursor != ':' || name_char != cursor || cursor == line) {
+            LOG_ERROR("Malformed header line: %.40s", line);
+            return -1;
+        }
+        if (table->count == MAX_REQUEST_HEADERS) {
+            LOG_ERROR("Request has more than %d headers", MAX_REQUEST_HEADERS);
+            return -1;
+        }
+        str_view name = { line, (size_t) (cursor - line) };
+
+        // Value: up to the end of the line, without surrounding spaces and tabs
+        const char *value = cursor + 1;
+        while (*value == ' ' || *value == '\t') value++;
+        const char *line_end = scan_find_either(value, end, '\n', '\n');
+        const char *value_end = line_end;
+        while (value_end > value && (value_end[-1] == '\r' || value_end[-1] == ' ' || value_end[-1] == '\t')) value_end--;
+
+        http_header *header = &table->entries[table->count++];
+        header->name = name;
+        header->value = (str_view){ value, (size_t) (value_end - value) };
+        header->id = header_id(hash, name);
+        if (header->id != HEADER_OTHER && !table->known[header->id]) {
+            table->known[header->id] = (unsigned char) table->count;
+        }
+
+        if (line_end == end) break;
+        line = line_end + 1;
     }
-    
     return 0;
 }
 
+const str_view * find_request_header(const header_table *table, const char *name) {
+    size_t length = strlen(name);
+    for (int i = 0; i < table->count; ++i) {
+        const http_header *header = &table->entries[i];
+        if (header->name.length == length && strncasecmp(header->name.data, name, length) == 0) {
+            return &header->value;
+        }
+    }
+    return NULL;
+}
+
+/*
+Value + 1 of every byte that is a hex digit, 0 for all others (including the NUL terminator)
+*/
+static const unsigned char hex_digit_values[256] = {
+    ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5, ['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+    ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+    ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+};
+
 /**
  * Decodes URL-encoded string in-place.
- * Converts %XX hex sequences to their character equivalents.
+ * Converts %XX hex sequences to their character equivalents and + to a space. A % that is not
+ * followed by two hex digits is kept as is.
  * 
  * Args:
  *    char *str: URL-encoded string to decode
@@ -227,30 +357,32 @@ int parse_uri(char *URI, http_request *request, server_config *config) {
 int url_decode(char *str) {
     if (!str) return -1;
     
-    char *dest = str;
-    char *src = str;
+    char *end = str + strlen(str);
+    // Nothing moves before the first escape, most paths have none at all
+    char *src = (char *) scan_find_either(str, end, '%', '+');
+    if (src == end) return 0;
+    char *dest = src;
     
-    while (*src) {
-        if (*src == '%' && src[1] && src[2]) {
-            // Try to convert hex sequence
-            char hex[3] = {src[1], src[2], 0};
-            char *end;
-            long value = strtol(hex, &end, 16);
-            
-            if (end != hex + 2) {
-                // Not a valid hex sequence, copy as is
-                *dest++ = *src++;
-            } else {
-                *dest++ = (char)value;
+    while (src < end) {
+        if (*src == '%') {
+            // src[2] is only looked at when src[1] is a digit, so neither read passes the terminator
+            unsigned char high = hex_digit_values[(unsigned char) src[1]];
+            unsigned char low = high ? hex_digit_values[(unsigned char) src[2]] : 0;
+            if (low) {
+                *dest++ = (char) (((high - 1) << 4) | (low - 1));
                 src += 3;
+            } else {
+                *dest++ = *src++;
             }
         } else if (*src == '+') {
-            // Convert + to space
             *dest++ = ' ';
             src++;
         } else {
-            // Copy character as is
-            *dest++ = *src++;
+            // Copy the run up to the next escape as is
+            char *next = (char *) scan_find_either(src, end, '%', '+');
+            memmove(dest, src, (size_t) (next - src));
+            dest += next - src;
+            src = next;
         }
     }
     *dest = '\0';  // Null terminate
@@ -258,6 +390,51 @@ int url_decode(char *str) {
     return 0;
 }
 
+/**
+ * Normalizes a decoded path in place: runs of '/' become one, "." segments are dropped and ".."
+ * removes the segment before it. A path that named a directory ("/a/", "/a/.", "/a/b/..") keeps
+ * its trailing slash.
+ *
+ * Args:
+ *    char *path: decoded request path
+ *
+ * Returns:
+ *    0 on success, -1 if path does not start with '/', contains a control character or ".." would
+ *    leave the root
+ */
+int normalize_path(char *path) {
+    if (!path || path[0] != '/') return -1;
+
+    // dest is the end of the normalized path, every segment written is "/segment"
+    char *dest = path;
+    const char *src = path;
+    bool directory = false;
+    while (*src) {
+        while (*src == '/') src++;
+        const char *segment = src;
+        for (; *src && *src != '/'; src++) {
+            unsigned char c = (unsigned char) *src;
+            if (c < 0x20 || c == 0x7f) return -1;
+        }
+        size_t length = (size_t) (src - segment);
+        directory = true;
+        if (length == 0 || (length == 1 && segment[0] == '.')) continue;
+        if (length == 2 && segment[0] == '.' && segment[1] == '.') {
+            if (dest == path) return -1;
+            while (*--dest != '/');
+            continue;
+        }
+        // dest trails src by at least the '/' before segment, the copy never overtakes what is read
+        *dest++ = '/';
+        memmove(dest, segment, length);
+        dest += length;
+        directory = false;
+    }
+    if (directory || dest == path) *dest++ = '/';
+    *dest = '\0';
+    return 0;
+}
+
 /**
  * Determines MIME type based on file extension.
  * 
@@ -268,90 +445,44 @@ int url_decode(char *str) {
  *    MIME_TYPE enum value
  */
 MIME_TYPE get_mime_type(const char *path) {
-    const char *ext = strrchr(path, '.');
-    
-    if (!ext) {
-        return APPLICATION_OCTET_STREAM;  // Default to plain text if no extension
-    }
-    
-    ext++;  // Move past the dot
-    
-    if (strcasecmp(ext, "html") == 0 || strcasecmp(ext, "htm") == 0) {
-        return TEXT_HTML;
-    } else if (strcasecmp(ext, "txt") == 0) {
-        return TEXT_PLAIN;
-    } else if (strcasecmp(ext, "css") == 0) {
-        return TEXT_CSS;
-    } else if (strcasecmp(ext, "js") == 0) {
-        return APPLICATION_JAVASCRIPT;
-    } else if (strcasecmp(ext, "json") == 0) {
-        return APPLICATION_JSON;
-    } else if (strcasecmp(ext, "xml") == 0) {
-        return APPLICATION_XML;
-    } else if (strcasecmp(ext, "pdf") == 0) {
-        return APPLICATION_PDF;
-    } else if (strcasecmp(ext, "zip") == 0) {
-        return APPLICATION_ZIP;
-    } else if (strcasecmp(ext, "ps") == 0) {
-        return APPLICATION_POSTSCRIPT;
-    } else if (strcasecmp(ext, "gif") == 0) {
-        return IMAGE_GIF;
-    } else if (strcasecmp(ext, "png") == 0) {
-        return IMAGE_PNG;
-    } else if (strcasecmp(ext, "jpg") == 0 || strcasecmp(ext, "jpeg") == 0) {
-        return IMAGE_JPEG;
-    } else if (strcasecmp(ext, "svg") == 0) {
-        return IMAGE_SVG;
-    } else if (strcasecmp(ext, "mp3") == 0) {
-        return AUDIO_MPEG;
-    } else if (strcasecmp(ext, "wav") == 0) {
-        return AUDIO_WAV;
-    } else if (strcasecmp(ext, "mp4") == 0) {
-        return VIDEO_MP4;
-    } else if (strcasecmp(ext, "webm") == 0) {
-        return VIDEO_WEBM;
-    } else if (strcasecmp(ext, "woff") == 0) {
-        return FONT_WOFF;
-    } else if (strcasecmp(ext, "woff2") == 0) {
-        return FONT_WOFF2;
-    } else if (strcasecmp(ext, "mov") == 0) {
-        return VIDEO_MP4;  // Browsers can often handle .mov as video/mp4
-    } else {
-        return APPLICATION_OCTET_STREAM;  // Default to plain text for unknown types
-    }
+    return mime_for_path(path)->type;
 }
 
 void destroy_request(http_request * request) {
     if(request) {
-        free(request->path); // maintain the invariant that either this has not been free'd or is NULL
-        LOG_DEBUG("Free'd request->path");
-        if(request->param_count > 0) {
-            for(int i = 0; i < request->param_count; ++i) {
-                free(request->param_names[i]);
-                free(request->param_values[i]);
-            }
-            
-            free(request->param_names);
-            LOG_DEBUG("Free'd request->param_names");
-            free(request->param_values);
-            LOG_DEBUG("Free'd request->param_values");
-        }
+        // param_names is the start of the block parse_query_params allocated, param_values points into it
+        free(request->param_names);
+        LOG_DEBUG("Free'd request parameters");
+        request->param_names = NULL; // maintain the invariant that these have not been free'd or are NULL
+        request->param_values = NULL;
+        request->param_count = 0;
+        request->params_parsed = false;
     }
 }
 
 void initialize_request(http_request *request) {
     // Set pointers to NULL
     request->path = NULL;
+    request->method_name = (str_view){ NULL, 0 };
+    request->version_name = (str_view){ NULL, 0 };
+    request->query = (str_view){ NULL, 0 };
+    request->headers.count = 0;
+    memset(request->headers.known, 0, sizeof(request->headers.known));
     request->param_names = NULL;
     request->param_values = NULL;
+    request->timing = NULL;
+    request->deadline = NULL;
     
     // Set integer values to 0
     request->param_count = 0;
+    request->params_parsed = false;
     
     // Set enum values to their default/initial states
     request->method = GET;          // Default to GET as the most common method
     request->version = HTTP_1_1;    // Default to HTTP/1.1 as the most common version
     request->mime_type = TEXT_PLAIN; // Default to plain text
+    request->mime = NULL;
+    request->route = NULL;
     
     // Set boolean values to false
     request->is_dynamic = false;    // Default to static content
@@ -0,0 +1,591 @@
+/*
+HTTP load generator built on open_clientfd and rio.
+
+clang -std=c99 -Wall -Wextra -Werror -O2 -I./include \
+  src/loadgen.c src/net.c src/rio.c src/logger.c -pthread -lm -o executables/loadgen
+
+Usage
+    ./executables/loadgen -p 8080 -c 32 -d 30 -u /static/html/index.html 2>/dev/null
+    ./executables/loadgen -p 8080 -c 16 -r 5000 -k -P 4 -f urls.txt 2>/dev/null
+
+Every connection runs on its own thread. Without -r the generator runs closed-loop: each connection
+sends its next request as soon as a response slot frees up. With -r it runs open-loop: requests are
+scheduled at a fixed rate (split evenly across connections) independent of how fast the server
+answers. Latency is then measured from the time a request was *scheduled* to be sent, not from when
+it actually went out, so a server stall is charged to every request that should have been sent
+during the stall (coordinated omission correction). The uncorrected latency is reported next to it.
+
+-P sends up to that many requests on a connection before reading the first response (pipelining).
+-k asks for keep-alive. When the server closes a connection anyway, requests that were pipelined on
+it but not answered are resent on a fresh connection with their original schedule.
+
+The URL file (-f) has one URL per line, optionally prefixed with an integer weight:
+    10 /static/css/styles.css
+    1  /cgi-bin/hello.cgi
+Lines starting with # are ignored.
+
+-t sets the send and receive timeout of every socket in seconds (10 by default, 0 waits forever). A
+request that times out counts as an error and the connection is replaced, so a stalled server can't
+hang the run.
+
+The report is written to stdout as JSON. rio and net log to stderr, redirect it to keep it quiet.
+*/
+#include "net.h"
+#include "rio.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+
+#define MAX_URLS 1024
+#define MAX_REQUEST_SIZE 4096
+#define MAX_PIPELINE_DEPTH 64
+
+/*
+Log-linear latency histogram in microseconds. Values below HIST_SUB_BUCKETS are exact, above that
+every power of two is split into HIST_SUB_BUCKETS / 2 linear buckets (under 1.6% relative error).
+*/
+#define HIST_SUB_BITS 7
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BITS)
+#define HIST_HALF_BUCKETS (HIST_SUB_BUCKETS / 2)
+#define HIST_MAX_SHIFT 40
+#define HIST_BUCKETS (HIST_SUB_BUCKETS + HIST_MAX_SHIFT * HIST_HALF_BUCKETS)
+
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t sum;
+    uint64_t max;
+} histogram;
+
+typedef struct {
+    char *path;
+    char request[MAX_REQUEST_SIZE];
+    size_t request_length;
+} target_url;
+
+typedef struct {
+    char *host;
+    char *port;
+    unsigned int connections;
+    double duration_s;
+    double rate;                // total requests per second, 0 for closed-loop
+    unsigned int pipeline_depth;
+    bool keep_alive;
+    double timeout_s;           // socket send/receive timeout, 0 for none
+    target_url urls[MAX_URLS];
+    unsigned int weights[MAX_URLS];
+    unsigned int url_count;
+    unsigned int total_weight;
+} loadgen_config;
+
+typedef struct {
+    uint64_t intended_ns;       // when the request was scheduled to go out
+    uint64_t sent_ns;           // when it actually went out
+    unsigned int url;
+} pending_request;
+
+typedef struct {
+    const loadgen_config *config;
+    unsigned int id;
+    uint64_t start_ns;
+    uint64_t end_ns;
+    uint64_t rng;
+    histogram corrected;
+    histogram uncorrected;
+    uint64_t completed;
+    uint64_t errors;
+    uint64_t timeouts;          // part of errors
+    uint64_t connects;
+    uint64_t resent;
+    uint64_t bytes;
+    uint64_t status_classes[6];
+} worker;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t deadline_ns) {
+    uint64_t now = now_ns();
+    if (deadline_ns <= now) return;
+    uint64_t wait = deadline_ns - now;
+    struct timespec ts = { (time_t)(wait / 1000000000ULL), (long)(wait % 1000000000ULL) };
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR);
+}
+
+static unsigned int hist_index(uint64_t value) {
+    if (value < HIST_SUB_BUCKETS) return (unsigned int)value;
+    unsigned int msb = 63 - (unsigned int)__builtin_clzll(value);
+    unsigned int shift = msb - (HIST_SUB_BITS - 1);
+    if (shift > HIST_MAX_SHIFT) return HIST_BUCKETS - 1;
+    return HIST_SUB_BUCKETS + (shift - 1) * HIST_HALF_BUCKETS + (unsigned int)((value >> shift) - HIST_HALF_BUCKETS);
+}
+
+// Upper bound of the values that land in bucket index
+static uint64_t hist_value(unsigned int index) {
+    if (index < HIST_SUB_BUCKETS) return index;
+    unsigned int shift = (index - HIST_SUB_BUCKETS) / HIST_HALF_BUCKETS + 1;
+    uint64_t sub = (index - HIST_SUB_BUCKETS) % HIST_HALF_BUCKETS + HIST_HALF_BUCKETS;
+    return ((sub + 1) << shift) - 1;
+}
+
+static void hist_record(histogram *hist, uint64_t value) {
+    hist->counts[hist_index(value)]++;
+    hist->total++;
+    hist->sum += value;
+    if (value > hist->max) hist->max = value;
+}
+
+static void hist_merge(histogram *into, const histogram *from) {
+    for (unsigned int i = 0; i < HIST_BUCKETS; ++i) into->counts[i] += from->counts[i];
+    into->total += from->total;
+    into->sum += from->sum;
+    if (from->max > into->max) into->max = from->max;
+}
+
+static uint64_t hist_percentile(const histogram *hist, double percentile) {
+    if (hist->total == 0) return 0;
+    uint64_t rank = (uint64_t)((percentile / 100.0) * (double)hist->total + 0.5);
+    if (rank == 0) rank = 1;
+    uint64_t seen = 0;
+    for (unsigned int i = 0; i < HIST_BUCKETS; ++i) {
+        seen += hist->counts[i];
+        if (seen >= rank) {
+            uint64_t value = hist_value(i);
+            return value < hist->max ? value : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+static uint64_t next_random(worker *w) {
+    // xorshift64*
+    w->rng ^= w->rng >> 12;
+    w->rng ^= w->rng << 25;
+    w->rng ^= w->rng >> 27;
+    return w->rng * 2685821657736338717ULL;
+}
+
+static unsigned int pick_url(worker *w) {
+    const loadgen_config *config = w->config;
+    if (config->url_count == 1) return 0;
+    uint64_t ticket = next_random(w) % config->total_weight;
+    for (unsigned int i = 0; i < config->url_count; ++i) {
+        if (ticket < config->weights[i]) return i;
+        ticket -= config->weights[i];
+    }
+    return config->url_count - 1;
+}
+
+/*
+Reads one response from conn. Returns the status code, 0 if the connection was closed before a
+response started, -1 on a malformed response or read error. *closed is set when the server will
+not send anything more on this connection.
+*/
+static int read_response(rio_buf *conn, worker *w, bool *closed) {
+    char line[BUFFER_SIZE];
+    ssize_t length = rio_buffered_readline(conn, line, sizeof(line));
+    if (length <= 0) {
+        *closed = true;
+        return length == 0 ? 0 : -1;
+    }
+
+    int status = 0;
+    if (sscanf(line, "HTTP/%*d.%*d %d", &status) != 1) {
+        *closed = true;
+        return -1;
+    }
+
+    long long content_length = -1;
+    while (true) {
+        length = rio_buffered_readline(conn, line, sizeof(line));
+        if (length <= 0) {
+            *closed = true;
+            return -1;
+        }
+        if (strcmp(line, "\r\n") == 0 || strcmp(line, "\n") == 0) break;
+        if (strncasecmp(line, "Content-Length:", 15) == 0) {
+            content_length = atoll(line + 15);
+        } else if (strncasecmp(line, "Connection:", 11) == 0 && strstr(line + 11, "close")) {
+            *closed = true;
+        }
+    }
+
+    // Without a Content-Length the body is delimited by the server closing the connection
+    char body[BUFFER_SIZE];
+    uint64_t remaining = content_length >= 0 ? (uint64_t)content_length : UINT64_MAX;
+    while (remaining > 0) {
+        size_t chunk = remaining < sizeof(body) ? (size_t)remaining : sizeof(body);
+        ssize_t read_size = rio_buffered_readb(conn, body, chunk);
+        if (read_size < 0) {
+            *closed = true;
+            return -1;
+        }
+        w->bytes += (uint64_t)read_size;
+        if ((size_t)read_size < chunk) {
+            if (content_length >= 0) {
+                *closed = true;
+                return -1; // truncated body
+            }
+            break;
+        }
+        remaining -= (uint64_t)read_size;
+    }
+    if (content_length < 0) *closed = true;
+    return status;
+}
+
+static int connect_worker(worker *w) {
+    int fd = open_clientfd(w->config->host, w->config->port);
+    if (fd < 0) return fd;
+    w->connects++;
+    if (w->config->timeout_s > 0) {
+        struct timeval timeout;
+        timeout.tv_sec = (time_t)w->config->timeout_s;
+        timeout.tv_usec = (suseconds_t)((w->config->timeout_s - (double)timeout.tv_sec) * 1e6);
+        if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0 ||
+            setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) < 0) {
+            fprintf(stderr, "Failed to set socket timeouts: %s\n", strerror(errno));
+        }
+    }
+    return fd;
+}
+
+// A read or write that failed with EAGAIN ran into the socket timeout
+static bool timed_out(void) {
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+}
+
+static void *run_worker(void *arg) {
+    worker *w = (worker *)arg;
+    const loadgen_config *config = w->config;
+
+    // Open-loop interval of this connection. Connections are staggered so they don't fire in bursts
+    uint64_t interval_ns = config->rate > 0 ? (uint64_t)(1e9 * config->connections / config->rate) : 0;
+    uint64_t next_intended = w->start_ns + (interval_ns ? interval_ns * w->id / config->connections : 0);
+
+    pending_request pending[MAX_PIPELINE_DEPTH];
+    unsigned int head = 0, count = 0, unsent = 0;
+    char send_buffer[MAX_REQUEST_SIZE * 4];
+
+    rio_buf conn;
+    int fd = -1;
+
+    while (true) {
+        uint64_t now = now_ns();
+        if (now >= w->end_ns && count == 0) break;
+
+        if (fd < 0) {
+            fd = connect_worker(w);
+            if (fd < 0) {
+                w->errors++;
+                sleep_until(now + 10000000ULL); // back off 10ms before reconnecting
+                continue;
+            }
+            rio_init_buffer(fd, &conn);
+            // Everything still pending was lost with the previous connection
+            unsent = count;
+            w->resent += count;
+        }
+
+        // Queue new requests that are due
+        while (count < config->pipeline_depth && now < w->end_ns) {
+            if (interval_ns) {
+                if (next_intended > now) break;
+            } else {
+                next_intended = now;
+            }
+            pending_request *slot = &pending[(head + count) % MAX_PIPELINE_DEPTH];
+            slot->intended_ns = next_intended;
+            slot->url = pick_url(w);
+            count++;
+            unsent++;
+            next_intended += interval_ns;
+        }
+
+        // Send everything that has not gone out on this connection in one write
+        if (unsent > 0) {
+            size_t length = 0;
+            unsigned int first = count - unsent;
+            unsigned int batched = 0;
+            for (unsigned int i = first; i < count; ++i) {
+                const target_url *url = &config->urls[pending[(head + i) % MAX_PIPELINE_DEPTH].url];
+                if (length + url->request_length > sizeof(send_buffer)) break;
+                memcpy(send_buffer + length, url->request, url->request_length);
+                length += url->request_length;
+                batched++;
+            }
+            uint64_t sent = now_ns();
+            errno = 0;
+            if (rio_unbuffered_write(fd, send_buffer, length) != (ssize_t)length) {
+                if (timed_out()) {
+                    w->errors++;
+                    w->timeouts++;
+                }
+                close(fd);
+                fd = -1;
+                continue;
+            }
+            for (unsigned int i = first; i < first + batched; ++i) {
+                pending[(head + i) % MAX_PIPELINE_DEPTH].sent_ns = sent;
+            }
+            unsent -= batched;
+        }
+
+        if (count == 0) {
+            // Open-loop and nothing outstanding: wait for the next scheduled request
+            sleep_until(next_intended < w->end_ns ? next_intended : w->end_ns);
+            continue;
+        }
+
+        bool closed = false;
+        errno = 0;
+        int status = read_response(&conn, w, &closed);
+        uint64_t done = now_ns();
+        if (status > 0) {
+            pending_request *completed = &pending[head];
+            hist_record(&w->corrected, (done - completed->intended_ns) / 1000);
+            hist_record(&w->uncorrected, (done - completed->sent_ns) / 1000);
+            w->completed++;
+            int status_class = status / 100;
+            w->status_classes[(status_class >= 1 && status_class <= 5) ? status_class : 0]++;
+            head = (head + 1) % MAX_PIPELINE_DEPTH;
+            count--;
+        } else if (status < 0) {
+            w->errors++;
+            if (timed_out()) w->timeouts++;
+        }
+
+        if (closed || status <= 0) {
+            close(fd);
+            fd = -1;
+            if (now_ns() >= w->end_ns) {
+                // Don't chase requests lost to a closed connection past the end of the run
+                w->errors += count;
+                count = 0;
+            }
+        }
+    }
+
+    if (fd >= 0) close(fd);
+    return NULL;
+}
+
+static char *trim_line(char *line) {
+    while (*line == ' ' || *line == '\t') line++;
+    size_t length = strlen(line);
+    while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r' ||
+                          line[length - 1] == ' ' || line[length - 1] == '\t')) {
+        line[--length] = '\0';
+    }
+    return line;
+}
+
+static bool add_url(loadgen_config *config, const char *path, unsigned int weight) {
+    if (config->url_count == MAX_URLS) {
+        fprintf(stderr, "Too many URLs, at most %d are supported\n", MAX_URLS);
+        return false;
+    }
+    if (path[0] != '/' || weight == 0) {
+        fprintf(stderr, "Ignoring invalid URL entry: %u %s\n", weight, path);
+        return true;
+    }
+    target_url *url = &config->urls[config->url_count];
+    int length = snprintf(url->request, sizeof(url->request),
+                          "GET %s HTTP/1.1\r\nHost: %s:%s\r\nUser-Agent: turingbolt-loadgen\r\nConnection: %s\r\n\r\n",
+                          path, config->host, config->port, config->keep_alive ? "keep-alive" : "close");
+    if (length < 0 || (size_t)length >= sizeof(url->request)) {
+        fprintf(stderr, "URL too long: %s\n", path);
+        return false;
+    }
+    url->path = strdup(path);
+    url->request_length = (size_t)length;
+    config->weights[config->url_count] = weight;
+    config->total_weight += weight;
+    config->url_count++;
+    return true;
+}
+
+static bool load_url_file(loadgen_config *config, const char *filename) {
+    FILE *file = fopen(filename, "r");
+    if (!file) {
+        fprintf(stderr, "Failed to open URL file %s: %s\n", filename, strerror(errno));
+        return false;
+    }
+    char line[MAX_REQUEST_SIZE];
+    bool ok = true;
+    while (ok && fgets(line, sizeof(line), file)) {
+        char *entry = trim_line(line);
+        if (entry[0] == '\0' || entry[0] == '#') continue;
+        unsigned int weight = 1;
+        if (entry[0] != '/') {
+            char *end;
+            weight = (unsigned int)strtoul(entry, &end, 10);
+            entry = trim_line(end);
+        }
+        ok = add_url(config, entry, weight);
+    }
+    fclose(file);
+    return ok;
+}
+
+// Prints text as a JSON string, quotes included
+static void print_json_string(const char *text) {
+    putchar('"');
+    for (const unsigned char *c = (const unsigned char *)text; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            printf("\\%c", *c);
+        } else if (*c < 0x20) {
+            printf("\\u%04x", *c);
+        } else {
+            putchar(*c);
+        }
+    }
+    putchar('"');
+}
+
+static void print_histogram(const char *name, const histogram *hist, bool last) {
+    printf("    \"%s\": {\"count\": %" PRIu64 ", \"mean\": %.1f, \"p50\": %" PRIu64 ", \"p90\": %" PRIu64
+           ", \"p99\": %" PRIu64 ", \"p99_9\": %" PRIu64 ", \"p99_99\": %" PRIu64 ", \"max\": %" PRIu64 "}%s\n",
+           name, hist->total, hist->total ? (double)hist->sum / (double)hist->total : 0.0,
+           hist_percentile(hist, 50.0), hist_percentile(hist, 90.0), hist_percentile(hist, 99.0),
+           hist_percentile(hist, 99.9), hist_percentile(hist, 99.99), hist->max, last ? "" : ",");
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-h host] [-p port] [-c connections] [-d seconds] [-r requests_per_second]\n"
+            "          [-P pipeline_depth] [-t timeout_seconds] [-k] (-u url | -f url_file)\n", prog);
+}
+
+int main(int argc, char **argv) {
+    static loadgen_config config;
+    config.host = "localhost";
+    config.port = "8080";
+    config.connections = 1;
+    config.duration_s = 10;
+    config.pipeline_depth = 1;
+    config.timeout_s = 10;
+    const char *url = NULL;
+    const char *url_file = NULL;
+
+    int option;
+    while ((option = getopt(argc, argv, "h:p:c:d:r:P:t:ku:f:")) != -1) {
+        switch (option) {
+            case 'h': config.host = optarg; break;
+            case 'p': config.port = optarg; break;
+            case 'c': config.connections = (unsigned int)atoi(optarg); break;
+            case 'd': config.duration_s = atof(optarg); break;
+            case 'r': config.rate = atof(optarg); break;
+            case 'P': config.pipeline_depth = (unsigned int)atoi(optarg); break;
+            case 't': config.timeout_s = atof(optarg); break;
+            case 'k': config.keep_alive = true; break;
+            case 'u': url = optarg; break;
+            case 'f': url_file = optarg; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if (config.connections == 0 || config.duration_s <= 0 || config.rate < 0 || config.timeout_s < 0 ||
+        config.pipeline_depth == 0 || config.pipeline_depth > MAX_PIPELINE_DEPTH || (!url && !url_file)) {
+        usage(argv[0]);
+        return 1;
+    }
+    if ((url && !add_url(&config, url, 1)) || (url_file && !load_url_file(&config, url_file))) {
+        return 1;
+    }
+    if (config.url_count == 0) {
+        fprintf(stderr, "No valid URLs to request\n");
+        return 1;
+    }
+
+    // A server closing the connection mid-write must not kill the generator
+    signal(SIGPIPE, SIG_IGN);
+
+    worker *workers = calloc(config.connections, sizeof(worker));
+    pthread_t *threads = calloc(config.connections, sizeof(pthread_t));
+    if (!workers || !threads) {
+        fprintf(stderr, "Failed to allocate %u workers\n", config.connections);
+        return 1;
+    }
+
+    uint64_t start = now_ns();
+    uint64_t end = start + (uint64_t)(config.duration_s * 1e9);
+    for (unsigned int i = 0; i < config.connections; ++i) {
+        workers[i].config = &config;
+        workers[i].id = i;
+        workers[i].start_ns = start;
+        workers[i].end_ns = end;
+        workers[i].rng = 0x9E3779B97F4A7C15ULL * (i + 1);
+        if (pthread_create(&threads[i], NULL, run_worker, &workers[i]) != 0) {
+            fprintf(stderr, "Failed to start worker %u\n", i);
+            return 1;
+        }
+    }
+
+    static histogram corrected, uncorrected;
+    uint64_t completed = 0, errors = 0, timeouts = 0, connects = 0, resent = 0, bytes = 0, status_classes[6] = {0};
+    for (unsigned int i = 0; i < config.connections; ++i) {
+        pthread_join(threads[i], NULL);
+        hist_merge(&corrected, &workers[i].corrected);
+        hist_merge(&uncorrected, &workers[i].uncorrected);
+        completed += workers[i].completed;
+        errors += workers[i].errors;
+        timeouts += workers[i].timeouts;
+        connects += workers[i].connects;
+        resent += workers[i].resent;
+        bytes += workers[i].bytes;
+        for (int c = 0; c < 6; ++c) status_classes[c] += workers[i].status_classes[c];
+    }
+    double elapsed_s = (double)(now_ns() - start) / 1e9;
+
+    printf("{\n");
+    // host, port and the paths come from the command line, everything else is a number or a fixed word
+    printf("  \"config\": {\"host\": ");
+    print_json_string(config.host);
+    printf(", \"port\": ");
+    print_json_string(config.port);
+    printf(", \"connections\": %u, \"duration_s\": %.3f, \"mode\": \"%s\", \"target_rate\": %.1f, "
+           "\"pipeline_depth\": %u, \"keep_alive\": %s, \"timeout_s\": %.3f, \"urls\": [",
+           config.connections, config.duration_s, config.rate > 0 ? "open" : "closed", config.rate,
+           config.pipeline_depth, config.keep_alive ? "true" : "false", config.timeout_s);
+    for (unsigned int i = 0; i < config.url_count; ++i) {
+        printf("%s{\"path\": ", i ? ", " : "");
+        print_json_string(config.urls[i].path);
+        printf(", \"weight\": %u}", config.weights[i]);
+    }
+    printf("]},\n");
+    printf("  \"elapsed_s\": %.3f,\n", elapsed_s);
+    printf("  \"requests\": %" PRIu64 ",\n", completed);
+    printf("  \"throughput_rps\": %.1f,\n", elapsed_s > 0 ? (double)completed / elapsed_s : 0.0);
+    printf("  \"bytes_received\": %" PRIu64 ",\n", bytes);
+    printf("  \"errors\": %" PRIu64 ",\n", errors);
+    printf("  \"timeouts\": %" PRIu64 ",\n", timeouts);
+    printf("  \"connections_opened\": %" PRIu64 ",\n", connects);
+    printf("  \"resent\": %" PRIu64 ",\n", resent);
+    printf("  \"status\": {\"1xx\": %" PRIu64 ", \"2xx\": %" PRIu64 ", \"3xx\": %" PRIu64 ", \"4xx\": %" PRIu64
+           ", \"5xx\": %" PRIu64 ", \"other\": %" PRIu64 "},\n",
+           status_classes[1], status_classes[2], status_classes[3], status_classes[4], status_classes[5], status_classes[0]);
+    printf("  \"latency_us\": {\n");
+    print_histogram("corrected", &corrected, false);
+    print_histogram("uncorrected", &uncorrected, true);
+    printf("  }\n");
+    printf("}\n");
+
+    for (unsigned int i = 0; i < config.url_count; ++i) free(config.urls[i].path);
+    free(workers);
+    free(threads);
+    return errors > 0 && completed == 0 ? 1 : 0;
+}
@@ -0,0 +1,30 @@
+#include "logger.h"
+#include <strings.h>
+
+int log_min_level = LOG_DEBUG;
+
+static const char *level_names[] = {
+    "DEBUG",
+    "INFO",
+    "WARN",
+    "ERROR"
+};
+
+void log_set_level(log_level_t level) {
+    __atomic_store_n(&log_min_level, (int)level, __ATOMIC_RELAXED);
+}
+
+const char *log_level_name(log_level_t level) {
+    return level_names[level];
+}
+
+int log_parse_level(const char *name, log_level_t *level) {
+    if (!name || !level) return -1;
+    for (int i = LOG_DEBUG; i <= LOG_ERROR; ++i) {
+        if (strcasecmp(name, level_names[i]) == 0) {
+            *level = (log_level_t)i;
+            return 0;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,225 @@
+#include "metrics.h"
+#include "logger.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <inttypes.h>
+#include <pthread.h>
+
+#define NS_PER_US UINT64_C(1000)
+#define NS_PER_MS UINT64_C(1000000)
+#define NS_PER_SEC UINT64_C(1000000000)
+
+static const char *phase_names[PHASE_COUNT] = {
+    "accept",
+    "first_byte",
+    "headers_done",
+    "parse_done",
+    "handler_start",
+    "first_response_byte",
+    "last_byte"
+};
+
+typedef struct {
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+} duration_stat;
+
+/*
+Aggregated statistics. phases[i] holds the time spent between the previously recorded phase
+and phase i, so phases[PHASE_ACCEPT] is never populated.
+*/
+static struct {
+    pthread_mutex_t lock;
+    struct timespec started;
+    uint64_t requests;
+    uint64_t slow_requests;
+    uint64_t status_classes[6]; // index 0 counts requests that got no response, 1-5 are 1xx-5xx
+    duration_stat phases[PHASE_COUNT];
+    duration_stat total;
+    struct {
+        metrics_section_fn render;
+        void *ctx;
+    } sections[METRICS_MAX_SECTIONS];
+    int section_count;
+} stats = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static uint64_t timespec_diff_ns(const struct timespec *start, const struct timespec *end) {
+    int64_t diff = (int64_t)(end->tv_sec - start->tv_sec) * (int64_t)NS_PER_SEC +
+                   (int64_t)(end->tv_nsec - start->tv_nsec);
+    return diff > 0 ? (uint64_t)diff : 0;
+}
+
+static void duration_stat_add(duration_stat *stat, uint64_t ns) {
+    stat->count++;
+    stat->total_ns += ns;
+    if (ns > stat->max_ns) {
+        stat->max_ns = ns;
+    }
+}
+
+void timing_init(request_timing *timing) {
+    if (!timing) return;
+    memset(timing, 0, sizeof(*timing));
+}
+
+void timing_mark(request_timing *timing, request_phase phase) {
+    if (!timing || phase >= PHASE_COUNT || timing->recorded[phase]) return;
+    clock_gettime(CLOCK_MONOTONIC, &timing->stamps[phase]);
+    timing->recorded[phase] = true;
+}
+
+uint64_t timing_offset_ns(const request_timing *timing, request_phase phase) {
+    if (!timing || phase >= PHASE_COUNT || !timing->recorded[PHASE_ACCEPT] || !timing->recorded[phase]) {
+        return 0;
+    }
+    return timespec_diff_ns(&timing->stamps[PHASE_ACCEPT], &timing->stamps[phase]);
+}
+
+const char *timing_phase_name(request_phase phase) {
+    return phase < PHASE_COUNT ? phase_names[phase] : "unknown";
+}
+
+void metrics_init(void) {
+    pthread_mutex_lock(&stats.lock);
+    clock_gettime(CLOCK_MONOTONIC, &stats.started);
+    pthread_mutex_unlock(&stats.lock);
+}
+
+/*
+Returns the most recent phase that was recorded, PHASE_COUNT if none was
+*/
+static request_phase last_recorded_phase(const request_timing *timing) {
+    for (int phase = PHASE_COUNT - 1; phase >= 0; --phase) {
+        if (timing->recorded[phase]) {
+            return (request_phase)phase;
+        }
+    }
+    return PHASE_COUNT;
+}
+
+void metrics_record_request(const request_timing *timing, const char *path, server_config *config) {
+    if (!timing || !timing->recorded[PHASE_ACCEPT]) return;
+
+    // Time spent in each phase, measured from the previous phase that was actually reached
+    uint64_t phase_ns[PHASE_COUNT] = {0};
+    request_phase previous = PHASE_ACCEPT;
+    for (int phase = PHASE_ACCEPT + 1; phase < PHASE_COUNT; ++phase) {
+        if (!timing->recorded[phase]) continue;
+        phase_ns[phase] = timespec_diff_ns(&timing->stamps[previous], &timing->stamps[phase]);
+        previous = (request_phase)phase;
+    }
+
+    request_phase last = last_recorded_phase(timing);
+    uint64_t total_ns = timing_offset_ns(timing, last);
+    bool slow = config && config->slow_request_threshold_ms > 0 &&
+                total_ns >= (uint64_t)config->slow_request_threshold_ms * NS_PER_MS;
+
+    pthread_mutex_lock(&stats.lock);
+    stats.requests++;
+    if (slow) stats.slow_requests++;
+    int status_class = timing->status_code / 100;
+    stats.status_classes[(status_class >= 1 && status_class <= 5) ? status_class : 0]++;
+    for (int phase = PHASE_ACCEPT + 1; phase < PHASE_COUNT; ++phase) {
+        if (timing->recorded[phase]) {
+            duration_stat_add(&stats.phases[phase], phase_ns[phase]);
+        }
+    }
+    duration_stat_add(&stats.total, total_ns);
+    pthread_mutex_unlock(&stats.lock);
+
+    LOG_INFO("Request timing: path=%s status=%d total=%" PRIu64 "us read=%" PRIu64 "us parse=%" PRIu64
+             "us handler=%" PRIu64 "us send=%" PRIu64 "us",
+             path ? path : "-", timing->status_code, total_ns / NS_PER_US,
+             (phase_ns[PHASE_FIRST_BYTE] + phase_ns[PHASE_HEADERS_DONE]) / NS_PER_US,
+             phase_ns[PHASE_PARSE_DONE] / NS_PER_US,
+             (phase_ns[PHASE_HANDLER_START] + phase_ns[PHASE_FIRST_RESPONSE_BYTE]) / NS_PER_US,
+             phase_ns[PHASE_LAST_BYTE] / NS_PER_US);
+
+    if (slow) {
+        LOG_WARN("Slow request: path=%s status=%d total=%" PRIu64 "ms (threshold %ums)",
+                 path ? path : "-", timing->status_code, total_ns / NS_PER_MS,
+                 config->slow_request_threshold_ms);
+        for (int phase = PHASE_ACCEPT + 1; phase < PHASE_COUNT; ++phase) {
+            if (timing->recorded[phase]) {
+                LOG_WARN("  %-20s +%" PRIu64 "us (at %" PRIu64 "us)", phase_names[phase],
+                         phase_ns[phase] / NS_PER_US, timing_offset_ns(timing, (request_phase)phase) / NS_PER_US);
+            } else {
+                LOG_WARN("  %-20s not reached", phase_names[phase]);
+            }
+        }
+    }
+}
+
+void metrics_appendf(char *buf, size_t size, size_t *offset, const char *fmt, ...) {
+    if (*offset + 1 >= size) return;
+    va_list args;
+    va_start(args, fmt);
+    int written = vsnprintf(buf + *offset, size - *offset, fmt, args);
+    va_end(args);
+    if (written < 0) return;
+    *offset += (size_t)written < size - *offset ? (size_t)written : size - *offset - 1;
+}
+
+static void append_duration(char *buf, size_t size, size_t *offset, const char *name, const duration_stat *stat) {
+    uint64_t mean_ns = stat->count ? stat->total_ns / stat->count : 0;
+    metrics_appendf(buf, size, offset, "%-20s count=%" PRIu64 " mean=%" PRIu64 "us max=%" PRIu64 "us\n",
+           name, stat->count, mean_ns / NS_PER_US, stat->max_ns / NS_PER_US);
+}
+
+size_t metrics_render(char *buf, size_t size) {
+    if (!buf || size == 0) return 0;
+    buf[0] = '\0';
+    size_t offset = 0;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    pthread_mutex_lock(&stats.lock);
+    metrics_appendf(buf, size, &offset, "uptime_seconds: %" PRIu64 "\n", timespec_diff_ns(&stats.started, &now) / NS_PER_SEC);
+    metrics_appendf(buf, size, &offset, "requests: %" PRIu64 "\n", stats.requests);
+    metrics_appendf(buf, size, &offset, "slow_requests: %" PRIu64 "\n", stats.slow_requests);
+    metrics_appendf(buf, size, &offset, "no_response: %" PRIu64 "\n", stats.status_classes[0]);
+    for (int status_class = 1; status_class <= 5; ++status_class) {
+        metrics_appendf(buf, size, &offset, "status_%dxx: %" PRIu64 "\n", status_class, stats.status_classes[status_class]);
+    }
+    metrics_appendf(buf, size, &offset, "\nphase durations (time since previous phase):\n");
+    for (int phase = PHASE_ACCEPT + 1; phase < PHASE_COUNT; ++phase) {
+        append_duration(buf, size, &offset, phase_names[phase], &stats.phases[phase]);
+    }
+    append_duration(buf, size, &offset, "total", &stats.total);
+    for (int i = 0; i < stats.section_count && offset + 1 < size; ++i) {
+        metrics_appendf(buf, size, &offset, "\n");
+        offset += stats.sections[i].render(buf + offset, size - offset, stats.sections[i].ctx);
+    }
+    pthread_mutex_unlock(&stats.lock);
+
+    return offset;
+}
+
+int metrics_add_section(metrics_section_fn render, void *ctx) {
+    if (!render) return -1;
+    pthread_mutex_lock(&stats.lock);
+    int status = -1;
+    if (stats.section_count < METRICS_MAX_SECTIONS) {
+        stats.sections[stats.section_count].render = render;
+        stats.sections[stats.section_count].ctx = ctx;
+        stats.section_count++;
+        status = 0;
+    }
+    pthread_mutex_unlock(&stats.lock);
+    return status;
+}
+
+void metrics_remove_section(metrics_section_fn render, void *ctx) {
+    pthread_mutex_lock(&stats.lock);
+    for (int i = 0; i < stats.section_count; ++i) {
+        if (stats.sections[i].render == render && stats.sections[i].ctx == ctx) {
+            memmove(&stats.sections[i], &stats.sections[i + 1], (size_t)(stats.section_count - i - 1) * sizeof(stats.sections[0]));
+            stats.section_count--;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&stats.lock);
+}
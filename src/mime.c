@@ -0,0 +1,208 @@
+#include "mime.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <ctype.h>
+
+#define FNV_OFFSET_BASIS 0x811c9dc5u
+#define FNV_PRIME        0x01000193u
+#define CONTENT_TYPE_PREFIX "Content-Type: "
+
+typedef struct {
+    char *extension; // lower case, NULL for an empty slot
+    size_t length;
+    const mime_entry *entry;
+} loaded_extension;
+
+/*
+Types loaded from a mime.types file. The extensions are kept in an open addressing hash table with
+linear probing that is at most half full.
+*/
+typedef struct {
+    mime_entry *entries;  // one per type line, names and headers are owned
+    size_t entry_count;
+    loaded_extension *slots;
+    size_t slot_count;    // power of two
+} loaded_table;
+
+// Written only by mime_load_types and mime_unload_types, before or after requests are served
+static loaded_table *loaded = NULL;
+
+static uint32_t extension_hash(const char *extension, size_t length) {
+    uint32_t hash = FNV_OFFSET_BASIS;
+    for (size_t i = 0; i < length; ++i) {
+        hash = (hash ^ (uint32_t) (unsigned char) tolower((unsigned char) extension[i])) * FNV_PRIME;
+    }
+    return hash ^ (hash >> 16);
+}
+
+static char *copy_lower(const char *text, size_t length) {
+    char *copy = malloc(length + 1);
+    if (!copy) return NULL;
+    for (size_t i = 0; i < length; ++i) copy[i] = (char) tolower((unsigned char) text[i]);
+    copy[length] = '\0';
+    return copy;
+}
+
+static void free_table(loaded_table *table) {
+    if (!table) return;
+    for (size_t i = 0; i < table->entry_count; ++i) {
+        free((char *) table->entries[i].name);
+        free((char *) table->entries[i].header);
+    }
+    for (size_t i = 0; i < table->slot_count; ++i) {
+        free(table->slots[i].extension);
+    }
+    free(table->entries);
+    free(table->slots);
+    free(table);
+}
+
+// Fills in entry for the type name, using the built-in MIME_TYPE value when the name has one
+static int make_entry(mime_entry *entry, const char *name, size_t length) {
+    entry->type = MIME_OTHER;
+    entry->name = copy_lower(name, length);
+    entry->header_length = strlen(CONTENT_TYPE_PREFIX) + length + 2;
+    char *header = malloc(entry->header_length + 1);
+    entry->header = header;
+    if (!entry->name || !header) return -1;
+    snprintf(header, entry->header_length + 1, CONTENT_TYPE_PREFIX "%s\r\n", entry->name);
+    for (int type = 0; type < MIME_OTHER; ++type) {
+        if (strcmp(mime_for_type((MIME_TYPE) type)->name, entry->name) == 0) {
+            entry->type = (MIME_TYPE) type;
+            break;
+        }
+    }
+    return 0;
+}
+
+// Adds an extension, a later line overrides an earlier one like in Apache's mime.types
+static void insert_extension(loaded_table *table, char *extension, size_t length, const mime_entry *entry) {
+    size_t slot = extension_hash(extension, length) & (table->slot_count - 1);
+    while (table->slots[slot].extension) {
+        if (table->slots[slot].length == length && memcmp(table->slots[slot].extension, extension, length) == 0) {
+            free(extension);
+            table->slots[slot].entry = entry;
+            return;
+        }
+        slot = (slot + 1) & (table->slot_count - 1);
+    }
+    table->slots[slot] = (loaded_extension){ extension, length, entry };
+}
+
+// Returns the next whitespace separated token of the line and moves *cursor past it, length 0 at the end
+static const char *next_word(const char **cursor, size_t *length) {
+    const char *start = *cursor;
+    while (*start && isspace((unsigned char) *start)) start++;
+    const char *stop = start;
+    while (*stop && !isspace((unsigned char) *stop) && *stop != '#') stop++;
+    *cursor = stop;
+    *length = (size_t) (stop - start);
+    return start;
+}
+
+int mime_load_types(const char *path) {
+    if (!path) {
+        LOG_ERROR("NULL path passed to mime_load_types");
+        return -1;
+    }
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        LOG_ERROR("Failed to open MIME types file %s", path);
+        return -1;
+    }
+
+    /*
+    First pass counts types and extensions so the table is allocated once, the second fills it. A
+    line longer than the buffer is read as several lines, mime.types lines are far shorter.
+    */
+    char line[1024];
+    size_t type_count = 0, extension_count = 0;
+    while (fgets(line, sizeof(line), file)) {
+        const char *cursor = line;
+        size_t length;
+        next_word(&cursor, &length);
+        if (length == 0) continue;
+        type_count++;
+        while (next_word(&cursor, &length), length > 0) extension_count++;
+    }
+
+    loaded_table *table = calloc(1, sizeof(loaded_table));
+    if (!table) {
+        fclose(file);
+        return -1;
+    }
+    table->slot_count = 16;
+    while (table->slot_count < 2 * extension_count) table->slot_count *= 2;
+    table->entries = calloc(type_count ? type_count : 1, sizeof(mime_entry));
+    table->slots = calloc(table->slot_count, sizeof(loaded_extension));
+    if (!table->entries || !table->slots) {
+        LOG_ERROR("Memory allocation failed for MIME types");
+        free_table(table);
+        fclose(file);
+        return -1;
+    }
+
+    rewind(file);
+    int loaded_extensions = 0;
+    int line_number = 0;
+    while (fgets(line, sizeof(line), file) && table->entry_count < type_count) {
+        line_number++;
+        const char *cursor = line;
+        size_t length;
+        const char *name = next_word(&cursor, &length);
+        if (length == 0) continue;
+        if (!memchr(name, '/', length)) {
+            LOG_WARN("%s:%d: \"%.*s\" is not a MIME type, line skipped", path, line_number, (int) length, name);
+            continue;
+        }
+        mime_entry *entry = &table->entries[table->entry_count++];
+        if (make_entry(entry, name, length) < 0) {
+            LOG_ERROR("Memory allocation failed for MIME types");
+            free_table(table);
+            fclose(file);
+            return -1;
+        }
+        const char *extension;
+        while (extension = next_word(&cursor, &length), length > 0 && (size_t) loaded_extensions < extension_count) {
+            char *copy = copy_lower(extension, length);
+            if (!copy) continue;
+            insert_extension(table, copy, length, entry);
+            loaded_extensions++;
+        }
+    }
+    fclose(file);
+
+    free_table(loaded);
+    loaded = table;
+    LOG_INFO("Loaded %d extensions of %zu MIME types from %s", loaded_extensions, table->entry_count, path);
+    return loaded_extensions;
+}
+
+void mime_unload_types(void) {
+    free_table(loaded);
+    loaded = NULL;
+}
+
+const mime_entry *mime_lookup(const char *extension, size_t length) {
+    if (!extension || length == 0) return NULL;
+    if (loaded) {
+        size_t slot = extension_hash(extension, length) & (loaded->slot_count - 1);
+        for (; loaded->slots[slot].extension; slot = (slot + 1) & (loaded->slot_count - 1)) {
+            if (loaded->slots[slot].length == length &&
+                strncasecmp(loaded->slots[slot].extension, extension, length) == 0) {
+                return loaded->slots[slot].entry;
+            }
+        }
+    }
+    return mime_builtin_lookup(extension, length);
+}
+
+const mime_entry *mime_for_path(const char *path) {
+    const char *dot = path ? strrchr(path, '.') : NULL;
+    const mime_entry *entry = dot ? mime_lookup(dot + 1, strlen(dot + 1)) : NULL;
+    return entry ? entry : mime_for_type(APPLICATION_OCTET_STREAM);
+}
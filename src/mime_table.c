@@ -0,0 +1,103 @@
+// Generated by scripts/gen_mime_table.py, edit the table there and regenerate
+#include "mime.h"
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+
+#define MIME_HASH_SEED 0x00000026u
+#define MIME_SLOT_COUNT 128
+#define MIME_MAX_BUILTIN_EXTENSION 5
+
+// Indexed by MIME_TYPE up to APPLICATION_OCTET_STREAM, then the MIME_OTHER types
+static const mime_entry entries[] = {
+    { TEXT_HTML, "text/html", "Content-Type: text/html\r\n", 25 },
+    { TEXT_PLAIN, "text/plain", "Content-Type: text/plain\r\n", 26 },
+    { TEXT_CSS, "text/css", "Content-Type: text/css\r\n", 24 },
+    { APPLICATION_JAVASCRIPT, "application/javascript", "Content-Type: application/javascript\r\n", 38 },
+    { APPLICATION_JSON, "application/json", "Content-Type: application/json\r\n", 32 },
+    { APPLICATION_XML, "application/xml", "Content-Type: application/xml\r\n", 31 },
+    { APPLICATION_PDF, "application/pdf", "Content-Type: application/pdf\r\n", 31 },
+    { APPLICATION_ZIP, "application/zip", "Content-Type: application/zip\r\n", 31 },
+    { APPLICATION_POSTSCRIPT, "application/postscript", "Content-Type: application/postscript\r\n", 38 },
+    { IMAGE_GIF, "image/gif", "Content-Type: image/gif\r\n", 25 },
+    { IMAGE_PNG, "image/png", "Content-Type: image/png\r\n", 25 },
+    { IMAGE_JPEG, "image/jpeg", "Content-Type: image/jpeg\r\n", 26 },
+    { IMAGE_SVG, "image/svg+xml", "Content-Type: image/svg+xml\r\n", 29 },
+    { AUDIO_MPEG, "audio/mpeg", "Content-Type: audio/mpeg\r\n", 26 },
+    { AUDIO_WAV, "audio/wav", "Content-Type: audio/wav\r\n", 25 },
+    { VIDEO_MP4, "video/mp4", "Content-Type: video/mp4\r\n", 25 },
+    { VIDEO_WEBM, "video/webm", "Content-Type: video/webm\r\n", 26 },
+    { FONT_WOFF, "font/woff", "Content-Type: font/woff\r\n", 25 },
+    { FONT_WOFF2, "font/woff2", "Content-Type: font/woff2\r\n", 26 },
+    { APPLICATION_OCTET_STREAM, "application/octet-stream", "Content-Type: application/octet-stream\r\n", 40 },
+    { MIME_OTHER, "image/x-icon", "Content-Type: image/x-icon\r\n", 28 },
+    { MIME_OTHER, "image/webp", "Content-Type: image/webp\r\n", 26 },
+    { MIME_OTHER, "image/avif", "Content-Type: image/avif\r\n", 26 },
+    { MIME_OTHER, "application/wasm", "Content-Type: application/wasm\r\n", 32 },
+    { MIME_OTHER, "text/csv", "Content-Type: text/csv\r\n", 24 },
+    { MIME_OTHER, "text/markdown", "Content-Type: text/markdown\r\n", 29 },
+    { MIME_OTHER, "font/ttf", "Content-Type: font/ttf\r\n", 24 },
+    { MIME_OTHER, "font/otf", "Content-Type: font/otf\r\n", 24 },
+    { MIME_OTHER, "audio/ogg", "Content-Type: audio/ogg\r\n", 25 },
+};
+
+typedef struct {
+    char extension[MIME_MAX_BUILTIN_EXTENSION + 1];
+    unsigned char length; // 0 for an empty slot
+    unsigned char entry;
+} mime_slot;
+
+static const mime_slot slots[MIME_SLOT_COUNT] = {
+    [2] = { "oga", 3, 28 },
+    [11] = { "mjs", 3, 3 },
+    [19] = { "png", 3, 10 },
+    [21] = { "md", 2, 25 },
+    [23] = { "ps", 2, 8 },
+    [24] = { "jpeg", 4, 11 },
+    [27] = { "csv", 3, 24 },
+    [39] = { "webm", 4, 16 },
+    [42] = { "html", 4, 0 },
+    [45] = { "gif", 3, 9 },
+    [53] = { "jpg", 3, 11 },
+    [54] = { "json", 4, 4 },
+    [55] = { "svg", 3, 12 },
+    [56] = { "css", 3, 2 },
+    [61] = { "otf", 3, 27 },
+    [65] = { "ttf", 3, 26 },
+    [69] = { "txt", 3, 1 },
+    [73] = { "js", 2, 3 },
+    [74] = { "ico", 3, 20 },
+    [84] = { "avif", 4, 22 },
+    [87] = { "wasm", 4, 23 },
+    [89] = { "mp4", 3, 15 },
+    [91] = { "xml", 3, 5 },
+    [92] = { "mp3", 3, 13 },
+    [96] = { "mov", 3, 15 },
+    [97] = { "map", 3, 4 },
+    [100] = { "ogg", 3, 28 },
+    [101] = { "zip", 3, 7 },
+    [103] = { "pdf", 3, 6 },
+    [104] = { "woff", 4, 17 },
+    [120] = { "htm", 3, 0 },
+    [122] = { "wav", 3, 14 },
+    [125] = { "woff2", 5, 18 },
+    [127] = { "webp", 4, 21 },
+};
+
+const mime_entry *mime_builtin_lookup(const char *extension, size_t length) {
+    if (length == 0 || length > MIME_MAX_BUILTIN_EXTENSION) return NULL;
+    char lower[MIME_MAX_BUILTIN_EXTENSION];
+    uint32_t hash = MIME_HASH_SEED;
+    for (size_t i = 0; i < length; ++i) {
+        lower[i] = (char) tolower((unsigned char) extension[i]);
+        hash = (hash ^ (uint32_t) (unsigned char) lower[i]) * 0x01000193u;
+    }
+    const mime_slot *slot = &slots[(hash ^ (hash >> 16)) & (MIME_SLOT_COUNT - 1)];
+    if (slot->length != length || memcmp(slot->extension, lower, length) != 0) return NULL;
+    return &entries[slot->entry];
+}
+
+const mime_entry *mime_for_type(MIME_TYPE type) {
+    if ((unsigned) type >= (unsigned) MIME_OTHER) type = APPLICATION_OCTET_STREAM;
+    return &entries[type];
+}
@@ -1,11 +1,15 @@
 #include "net.h"
 #include "logger.h"
 #include <sys/socket.h>
+#include <netinet/tcp.h>
 #include <netdb.h>
 #include <string.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <errno.h>
+#ifdef __linux__
+#include <linux/filter.h>
+#endif
 
 
 int open_clientfd(char *hostname, char *port) {
@@ -57,7 +61,124 @@ int open_clientfd(char *hostname, char *port) {
     return client_fd;
 }
 
-int open_listenfd(char * port) {
+static int open_listening_socket(char * port, bool reuseport, const listen_options * options);
+
+int open_listenfd(char * port, const listen_options * options) {
+    return open_listening_socket(port, false, options);
+}
+
+int open_listenfd_reuseport(char * port, const listen_options * options) {
+#ifdef SO_REUSEPORT
+    return open_listening_socket(port, true, options);
+#else
+    (void) options;
+    LOG_ERROR("SO_REUSEPORT is not supported on this platform");
+    return -1;
+#endif
+}
+
+int attach_reuseport_cpu_steering(int listen_fd, unsigned int group_size) {
+#if defined(__linux__) && defined(SO_ATTACH_REUSEPORT_CBPF)
+    if (group_size == 0) {
+        LOG_ERROR("Cannot steer connections to an empty SO_REUSEPORT group");
+        return -1;
+    }
+    // A = cpu the connection arrived on; return A % group_size as the index of the listener to use
+    struct sock_filter code[] = {
+        { BPF_LD | BPF_W | BPF_ABS, 0, 0, (unsigned int)(SKF_AD_OFF + SKF_AD_CPU) },
+        { BPF_ALU | BPF_MOD | BPF_K, 0, 0, group_size },
+        { BPF_RET | BPF_A, 0, 0, 0 },
+    };
+    struct sock_fprog program = { .len = sizeof(code) / sizeof(code[0]), .filter = code };
+    if (setsockopt(listen_fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program)) < 0) {
+        LOG_ERROR("Failed to attach CPU steering program to fd %d: %s", listen_fd, strerror(errno));
+        return -1;
+    }
+    LOG_INFO("Attached CPU steering program to SO_REUSEPORT group of %u listeners", group_size);
+    return 0;
+#else
+    (void) listen_fd;
+    (void) group_size;
+    LOG_ERROR("SO_REUSEPORT CPU steering is only supported on Linux");
+    return -1;
+#endif
+}
+
+int set_incoming_cpu(int listen_fd, int cpu) {
+#if defined(__linux__) && defined(SO_INCOMING_CPU)
+    if (setsockopt(listen_fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu)) < 0) {
+        LOG_ERROR("Failed to set SO_INCOMING_CPU %d on fd %d: %s", cpu, listen_fd, strerror(errno));
+        return -1;
+    }
+    LOG_DEBUG("Listener fd %d prefers connections processed on CPU %d", listen_fd, cpu);
+    return 0;
+#else
+    (void) listen_fd;
+    (void) cpu;
+    LOG_ERROR("SO_INCOMING_CPU is only supported on Linux");
+    return -1;
+#endif
+}
+
+int set_tcp_cork(int fd, bool cork) {
+#if defined(TCP_CORK) || defined(TCP_NOPUSH)
+#ifdef TCP_CORK
+    int option = TCP_CORK;
+#else
+    int option = TCP_NOPUSH;
+#endif
+    int optval = cork ? 1 : 0;
+    if (setsockopt(fd, IPPROTO_TCP, option, &optval, sizeof(optval)) < 0) {
+        LOG_DEBUG("Failed to %s fd %d: %s", cork ? "cork" : "uncork", fd, strerror(errno));
+        return -1;
+    }
+    return 0;
+#else
+    (void) fd;
+    (void) cork;
+    return -1;
+#endif
+}
+
+/*
+Applies the options that have to be in place before listen(). Failures are logged and skipped, the
+socket still works without them
+*/
+static void apply_listen_options(int server_fd, const listen_options * options) {
+    int optval = 1;
+    if (options->tcp_nodelay && setsockopt(server_fd, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof(optval)) < 0) {
+        LOG_WARN("Failed to set TCP_NODELAY on fd %d: %s", server_fd, strerror(errno));
+    }
+    // Buffer sizes must be set before listen() for the window scale to account for them
+    if (options->send_buffer > 0 &&
+        setsockopt(server_fd, SOL_SOCKET, SO_SNDBUF, &options->send_buffer, sizeof(options->send_buffer)) < 0) {
+        LOG_WARN("Failed to set SO_SNDBUF %d on fd %d: %s", options->send_buffer, server_fd, strerror(errno));
+    }
+    if (options->recv_buffer > 0 &&
+        setsockopt(server_fd, SOL_SOCKET, SO_RCVBUF, &options->recv_buffer, sizeof(options->recv_buffer)) < 0) {
+        LOG_WARN("Failed to set SO_RCVBUF %d on fd %d: %s", options->recv_buffer, server_fd, strerror(errno));
+    }
+    if (options->defer_accept > 0) {
+#ifdef TCP_DEFER_ACCEPT
+        if (setsockopt(server_fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &options->defer_accept, sizeof(options->defer_accept)) < 0) {
+            LOG_WARN("Failed to set TCP_DEFER_ACCEPT on fd %d: %s", server_fd, strerror(errno));
+        }
+#else
+        LOG_WARN("TCP_DEFER_ACCEPT is only supported on Linux, connections are accepted right away");
+#endif
+    }
+    if (options->fastopen_queue > 0) {
+#ifdef TCP_FASTOPEN
+        if (setsockopt(server_fd, IPPROTO_TCP, TCP_FASTOPEN, &options->fastopen_queue, sizeof(options->fastopen_queue)) < 0) {
+            LOG_WARN("Failed to enable TCP Fast Open on fd %d: %s", server_fd, strerror(errno));
+        }
+#else
+        LOG_WARN("TCP Fast Open is not supported on this platform");
+#endif
+    }
+}
+
+static int open_listening_socket(char * port, bool reuseport, const listen_options * options) {
     LOG_INFO("Opening listening socket on port %s", port);
     
     addrinfo hints, *results;
@@ -93,6 +214,19 @@ int open_listenfd(char * port) {
             server_fd = -1;
             continue;
         }
+#ifdef SO_REUSEPORT
+        if (reuseport && setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(int)) < 0) {
+            LOG_WARN("Failed to set SO_REUSEPORT for candidate %d: %s", candidate_counter, strerror(errno));
+            close(server_fd);
+            server_fd = -1;
+            continue;
+        }
+#else
+        (void) reuseport;
+#endif
+        if (options) {
+            apply_listen_options(server_fd, options);
+        }
         if (bind(server_fd, curr_socket_candidate->ai_addr, curr_socket_candidate->ai_addrlen)) {
             LOG_WARN("Server socket candidate %d failed to bind: %s", candidate_counter, strerror(errno));
             close(server_fd);
@@ -100,7 +234,7 @@ int open_listenfd(char * port) {
             continue;
         }
 
-        if(listen(server_fd, BACKLOG)){
+        if(listen(server_fd, options && options->backlog > 0 ? options->backlog : BACKLOG)){
             LOG_WARN("Server socket candidate %d failed to listen: %s", candidate_counter, strerror(errno));
             close(server_fd);
             server_fd = -1;
@@ -0,0 +1,559 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // nftw, FTW_PHYS, pipe2
+#endif
+#include "path_cache.h"
+#include "metrics.h"
+#include "logger.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <ftw.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#endif
+
+#define PATH_CACHE_WAYS 4   // entries per set
+#define PATH_CACHE_LOCKS 64 // set i is guarded by locks[i % PATH_CACHE_LOCKS]
+#define FNV_OFFSET_BASIS 0x811c9dc5u
+#define FNV_PRIME        0x01000193u
+#define FNV64_OFFSET_BASIS 0xcbf29ce484222325ull
+#define FNV64_PRIME        0x00000100000001b3ull
+#define BLOOM_BITS_PER_FILE 16 // with BLOOM_HASHES, about 1 in 400 missing paths passes the filter
+#define BLOOM_HASHES 4
+#define BLOOM_MIN_BITS (1u << 16)
+
+typedef struct {
+    uint32_t hash;
+    uint32_t length;     // of resolved, 0 for an empty entry
+    char *resolved;
+    struct stat st;
+    int missing;         // the path did not exist, st is unset
+    uint32_t generation; // of the watched root when the entry was looked up
+    time_t stored;       // CLOCK_MONOTONIC seconds
+} cache_entry;
+
+typedef struct cache_table {
+    cache_entry *entries;      // set i is entries[i * PATH_CACHE_WAYS, (i + 1) * PATH_CACHE_WAYS)
+    size_t set_count;          // power of two
+    struct cache_table *older; // retired table replaced before this one
+} cache_table;
+
+/*
+The table and the TTLs are replaced on reload while lookups run. A lookup uses the table it loaded
+until it is done, so a replaced table is only retired, and freed by path_cache_destroy
+*/
+static struct {
+    cache_table *table;     // NULL while the cache is disabled
+    cache_table *retired;   // replaced tables, only touched by the thread configuring the cache
+    pthread_mutex_t locks[PATH_CACHE_LOCKS]; // shared by all tables, set i takes locks[i % PATH_CACHE_LOCKS]
+
+    // Updated with atomics
+    time_t ttl;
+    time_t missing_ttl;
+    uint32_t generation;  // bumped by the watch thread on every change below the watched root
+    uint64_t hits;
+    uint64_t missing_hits;
+    uint64_t bloom_rejects;
+    uint64_t misses;
+    uint64_t stores;
+    uint64_t invalidations;
+} cache;
+
+// Generation the last lookup of this thread saw, a store for it is dropped if the root changed since
+static __thread uint32_t lookup_generation;
+
+/*
+The watched root. Set up by path_cache_watch before the watch thread starts, afterwards only the
+watch thread writes to it, apart from the bloom bits and bloom_enabled, which lookups read
+*/
+static struct {
+    char *root;             // as passed to path_cache_watch, ends with '/'
+    size_t root_length;
+    int running;            // a watch thread was started
+    int inotify_fd;
+    int stop_pipe[2];       // written to by path_cache_destroy to wake the thread
+    pthread_t thread;
+    char **directories;     // path of each watch descriptor, NULL for unused ones
+    int directory_capacity;
+
+    uint64_t *bloom;        // bloom filter of every path below root, NULL without one
+    size_t bloom_mask;      // number of bits - 1
+    int bloom_enabled;      // cleared for good once the filter may miss a file (atomic)
+
+    // State of the current walk, nftw callbacks take no argument
+    bool walk_watches;      // add a watch for every directory
+    bool walk_bloom;        // add every path to the filter
+    size_t walk_count;      // paths seen
+    bool walk_failed;
+} watch = { .inotify_fd = -1, .stop_pipe = { -1, -1 } };
+
+static time_t monotonic_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec;
+}
+
+static uint32_t path_hash(const char *text, size_t length) {
+    uint32_t hash = FNV_OFFSET_BASIS;
+    for (size_t i = 0; i < length; ++i) {
+        hash = (hash ^ (uint32_t) (unsigned char) text[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+static size_t set_of(const cache_table *table, uint32_t hash) {
+    // The low bits of an FNV-1a product only depend on the low bits of the input, fold in the high half
+    return (size_t) (hash ^ (hash >> 16)) & (table->set_count - 1);
+}
+
+/* ---------- bloom filter ---------- */
+
+// Double hashing: the BLOOM_HASHES bit positions are h1 + i * h2, both halves of one 64 bit FNV-1a hash
+static uint64_t bloom_hash(const char *path) {
+    uint64_t hash = FNV64_OFFSET_BASIS;
+    for (const unsigned char *c = (const unsigned char *) path; *c; ++c) {
+        hash = (hash ^ *c) * FNV64_PRIME;
+    }
+    return hash;
+}
+
+static void bloom_add(const char *path) {
+    uint64_t hash = bloom_hash(path);
+    uint32_t h1 = (uint32_t) hash, h2 = (uint32_t) (hash >> 32) | 1;
+    for (uint32_t i = 0; i < BLOOM_HASHES; ++i) {
+        size_t bit = (size_t) (h1 + i * h2) & watch.bloom_mask;
+        __atomic_fetch_or(&watch.bloom[bit / 64], 1ull << (bit % 64), __ATOMIC_RELAXED);
+    }
+}
+
+static bool bloom_may_contain(const char *path) {
+    uint64_t hash = bloom_hash(path);
+    uint32_t h1 = (uint32_t) hash, h2 = (uint32_t) (hash >> 32) | 1;
+    for (uint32_t i = 0; i < BLOOM_HASHES; ++i) {
+        size_t bit = (size_t) (h1 + i * h2) & watch.bloom_mask;
+        if (!(__atomic_load_n(&watch.bloom[bit / 64], __ATOMIC_RELAXED) & (1ull << (bit % 64)))) return false;
+    }
+    return true;
+}
+
+static void bloom_disable(const char *reason) {
+    if (__atomic_exchange_n(&watch.bloom_enabled, 0, __ATOMIC_RELAXED)) {
+        LOG_WARN("Path cache bloom filter disabled: %s", reason);
+    }
+}
+
+/*
+Whether path is known not to exist. Only paths below the watched root are covered, and only files and
+directories named without a trailing slash
+*/
+static bool bloom_rejects(const char *root, const char *resolved, size_t length) {
+    if (!__atomic_load_n(&watch.bloom_enabled, __ATOMIC_ACQUIRE)) return false;
+    if (resolved[length - 1] == '/' || strcmp(root, watch.root) != 0) return false;
+    return !bloom_may_contain(resolved);
+}
+
+/* ---------- cache ---------- */
+
+static pthread_once_t locks_once = PTHREAD_ONCE_INIT;
+
+// The locks outlive every table, they are never destroyed
+static void init_locks(void) {
+    for (int i = 0; i < PATH_CACHE_LOCKS; ++i) pthread_mutex_init(&cache.locks[i], NULL);
+}
+
+static void free_table(cache_table *table) {
+    for (size_t i = 0; i < table->set_count * PATH_CACHE_WAYS; ++i) free(table->entries[i].resolved);
+    free(table->entries);
+    free(table);
+}
+
+static void retire_table(void) {
+    cache_table *table = __atomic_exchange_n(&cache.table, NULL, __ATOMIC_ACQ_REL);
+    if (!table) return;
+    table->older = cache.retired;
+    cache.retired = table;
+}
+
+int path_cache_init(unsigned int entries, unsigned int ttl_seconds, unsigned int missing_ttl_seconds) {
+    path_cache_destroy();
+    return path_cache_configure(entries, ttl_seconds, missing_ttl_seconds);
+}
+
+int path_cache_configure(unsigned int entries, unsigned int ttl_seconds, unsigned int missing_ttl_seconds) {
+    pthread_once(&locks_once, init_locks);
+    __atomic_store_n(&cache.ttl, (time_t) ttl_seconds, __ATOMIC_RELAXED);
+    __atomic_store_n(&cache.missing_ttl, (time_t) missing_ttl_seconds, __ATOMIC_RELAXED);
+    if (entries == 0 || ttl_seconds == 0) {
+        LOG_INFO("Path cache disabled");
+        retire_table();
+        return 0;
+    }
+    size_t set_count = 1;
+    while (set_count * PATH_CACHE_WAYS < entries) set_count *= 2;
+    const cache_table *current = __atomic_load_n(&cache.table, __ATOMIC_ACQUIRE);
+    if (!current || current->set_count != set_count) {
+        cache_table *table = calloc(1, sizeof(cache_table));
+        cache_entry *table_entries = calloc(set_count * PATH_CACHE_WAYS, sizeof(cache_entry));
+        if (!table || !table_entries) {
+            free(table);
+            free(table_entries);
+            LOG_ERROR("Memory allocation failed for the path cache, %s", current ? "keeping its size" : "it is disabled");
+            return -1;
+        }
+        table->entries = table_entries;
+        table->set_count = set_count;
+        retire_table();
+        __atomic_store_n(&cache.table, table, __ATOMIC_RELEASE);
+    }
+    LOG_INFO("Path cache of %zu entries, valid for %u seconds (%u for missing paths)", set_count * PATH_CACHE_WAYS,
+             ttl_seconds, missing_ttl_seconds);
+    return 0;
+}
+
+static void watch_stop(void);
+
+void path_cache_destroy(void) {
+    watch_stop();
+    retire_table();
+    while (cache.retired) {
+        cache_table *older = cache.retired->older;
+        free_table(cache.retired);
+        cache.retired = older;
+    }
+}
+
+int path_cache_lookup(const char *root, const char *path, char *resolved, size_t size, struct stat *st) {
+    size_t root_length = strlen(root);
+    if (root_length > 0 && root[root_length - 1] == '/' && path[0] == '/') path++;
+    size_t path_length = strlen(path);
+    size_t length = root_length + path_length;
+    if (length + 1 > size) return -1;
+    memcpy(resolved, root, root_length);
+    memcpy(resolved + root_length, path, path_length + 1);
+
+    cache_table *table = __atomic_load_n(&cache.table, __ATOMIC_ACQUIRE);
+    if (!table || length == 0) return PATH_CACHE_MISS;
+    uint32_t generation = __atomic_load_n(&cache.generation, __ATOMIC_ACQUIRE);
+    lookup_generation = generation;
+    uint32_t hash = path_hash(resolved, length);
+    size_t set = set_of(table, hash);
+    cache_entry *ways = &table->entries[set * PATH_CACHE_WAYS];
+    time_t now = monotonic_seconds();
+    time_t ttl = __atomic_load_n(&cache.ttl, __ATOMIC_RELAXED);
+    time_t missing_ttl = __atomic_load_n(&cache.missing_ttl, __ATOMIC_RELAXED);
+    int result = PATH_CACHE_MISS;
+    pthread_mutex_t *lock = &cache.locks[set % PATH_CACHE_LOCKS];
+    pthread_mutex_lock(lock);
+    for (int i = 0; i < PATH_CACHE_WAYS; ++i) {
+        cache_entry *entry = &ways[i];
+        if (entry->hash == hash && entry->length == length && entry->generation == generation &&
+            now - entry->stored < (entry->missing ? missing_ttl : ttl) &&
+            memcmp(entry->resolved, resolved, length) == 0) {
+            if (entry->missing) {
+                result = PATH_CACHE_MISSING;
+            } else {
+                *st = entry->st;
+                result = PATH_CACHE_FOUND;
+            }
+            break;
+        }
+    }
+    pthread_mutex_unlock(lock);
+
+    if (result == PATH_CACHE_MISS && bloom_rejects(root, resolved, length)) {
+        __atomic_add_fetch(&cache.bloom_rejects, 1, __ATOMIC_RELAXED);
+        return PATH_CACHE_MISSING;
+    }
+    __atomic_add_fetch(result == PATH_CACHE_FOUND ? &cache.hits :
+                       result == PATH_CACHE_MISSING ? &cache.missing_hits : &cache.misses, 1, __ATOMIC_RELAXED);
+    return result;
+}
+
+static void store(cache_table *table, const char *resolved, const struct stat *st) {
+    // A stat taken before the root changed may be stale already
+    uint32_t generation = lookup_generation;
+    if (generation != __atomic_load_n(&cache.generation, __ATOMIC_ACQUIRE)) return;
+    size_t length = strlen(resolved);
+    uint32_t hash = path_hash(resolved, length);
+    size_t set = set_of(table, hash);
+    cache_entry *ways = &table->entries[set * PATH_CACHE_WAYS];
+    // Copied before taking the lock, the replaced copy is freed after releasing it
+    char *copy = strdup(resolved);
+    if (!copy) return;
+    char *replaced = NULL;
+    time_t now = monotonic_seconds();
+
+    pthread_mutex_t *lock = &cache.locks[set % PATH_CACHE_LOCKS];
+    pthread_mutex_lock(lock);
+    // The entry for the same path if there is one, otherwise an empty one or the oldest
+    cache_entry *victim = &ways[0];
+    for (int i = 0; i < PATH_CACHE_WAYS; ++i) {
+        if (ways[i].length == length && ways[i].hash == hash && memcmp(ways[i].resolved, resolved, length) == 0) {
+            victim = &ways[i];
+            break;
+        }
+        if (victim->length && (!ways[i].length || ways[i].stored < victim->stored)) victim = &ways[i];
+    }
+    replaced = victim->resolved;
+    victim->resolved = copy;
+    victim->hash = hash;
+    victim->length = (uint32_t) length;
+    victim->missing = st == NULL;
+    if (st) victim->st = *st;
+    victim->generation = generation;
+    victim->stored = now;
+    pthread_mutex_unlock(lock);
+
+    free(replaced);
+    __atomic_add_fetch(&cache.stores, 1, __ATOMIC_RELAXED);
+}
+
+void path_cache_store(const char *resolved, const struct stat *st) {
+    cache_table *table = __atomic_load_n(&cache.table, __ATOMIC_ACQUIRE);
+    if (!table || !resolved[0] || !st) return;
+    store(table, resolved, st);
+}
+
+void path_cache_store_missing(const char *resolved) {
+    cache_table *table = __atomic_load_n(&cache.table, __ATOMIC_ACQUIRE);
+    if (!table || !resolved[0] || !__atomic_load_n(&cache.missing_ttl, __ATOMIC_RELAXED)) return;
+    store(table, resolved, NULL);
+}
+
+size_t path_cache_render_stats(char *buf, size_t size, void *ctx) {
+    (void) ctx;
+    if (!buf || size == 0) return 0;
+    buf[0] = '\0';
+    size_t offset = 0;
+    metrics_appendf(buf, size, &offset, "path_cache:\n");
+    const cache_table *table = __atomic_load_n(&cache.table, __ATOMIC_ACQUIRE);
+    metrics_appendf(buf, size, &offset, "entries: %zu\n", table ? table->set_count * PATH_CACHE_WAYS : 0);
+    metrics_appendf(buf, size, &offset, "hits: %" PRIu64 "\n", __atomic_load_n(&cache.hits, __ATOMIC_RELAXED));
+    metrics_appendf(buf, size, &offset, "missing_hits: %" PRIu64 "\n", __atomic_load_n(&cache.missing_hits, __ATOMIC_RELAXED));
+    metrics_appendf(buf, size, &offset, "bloom_rejects: %" PRIu64 "\n", __atomic_load_n(&cache.bloom_rejects, __ATOMIC_RELAXED));
+    metrics_appendf(buf, size, &offset, "misses: %" PRIu64 "\n", __atomic_load_n(&cache.misses, __ATOMIC_RELAXED));
+    metrics_appendf(buf, size, &offset, "stores: %" PRIu64 "\n", __atomic_load_n(&cache.stores, __ATOMIC_RELAXED));
+    metrics_appendf(buf, size, &offset, "invalidations: %" PRIu64 "\n", __atomic_load_n(&cache.invalidations, __ATOMIC_RELAXED));
+    return offset;
+}
+
+/* ---------- directory watch ---------- */
+
+#ifdef __linux__
+
+// IN_MODIFY as well as IN_CLOSE_WRITE: a writer that keeps the file open (a log being appended to) changes
+// its size and mtime long before it closes it
+#define WATCH_EVENTS (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY | IN_CLOSE_WRITE | \
+                      IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF)
+
+static int add_watch(const char *directory) {
+    int wd = inotify_add_watch(watch.inotify_fd, directory, WATCH_EVENTS | IN_ONLYDIR);
+    if (wd < 0) {
+        LOG_WARN("Failed to watch %s: %s", directory, strerror(errno));
+        return -1;
+    }
+    if (wd >= watch.directory_capacity) {
+        int capacity = watch.directory_capacity ? watch.directory_capacity : 64;
+        while (capacity <= wd) capacity *= 2;
+        char **directories = realloc(watch.directories, (size_t) capacity * sizeof(char *));
+        if (!directories) return -1;
+        memset(directories + watch.directory_capacity, 0, (size_t) (capacity - watch.directory_capacity) * sizeof(char *));
+        watch.directories = directories;
+        watch.directory_capacity = capacity;
+    }
+    free(watch.directories[wd]); // a descriptor is reused when a directory is watched again
+    watch.directories[wd] = strdup(directory);
+    return watch.directories[wd] ? 0 : -1;
+}
+
+static int walk_entry(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    (void) st;
+    (void) ftw;
+    watch.walk_count++;
+    switch (type) {
+        case FTW_D:
+            // Reported before the directory's contents, a file created while they are walked is not lost
+            if (watch.walk_watches && add_watch(path) < 0) {
+                watch.walk_failed = true;
+                return FTW_STOP;
+            }
+            break;
+        case FTW_SL: {
+            // The watch does not follow links, changes behind a linked directory would go unnoticed
+            struct stat target;
+            if (stat(path, &target) == 0 && S_ISDIR(target.st_mode)) bloom_disable("a directory below the root is a symbolic link");
+            break;
+        }
+        case FTW_DNR:
+        case FTW_NS:
+            bloom_disable("a directory below the root cannot be read");
+            break;
+        default:
+            break;
+    }
+    if (watch.walk_bloom && watch.bloom) bloom_add(path);
+    return FTW_CONTINUE;
+}
+
+static int walk(const char *directory, bool watches, bool bloom) {
+    watch.walk_watches = watches;
+    watch.walk_bloom = bloom;
+    watch.walk_failed = false;
+    watch.walk_count = 0;
+    if (nftw(directory, walk_entry, 16, FTW_PHYS | FTW_ACTIONRETVAL) != 0 || watch.walk_failed) return -1;
+    return 0;
+}
+
+static void invalidate(void) {
+    __atomic_add_fetch(&cache.generation, 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&cache.invalidations, 1, __ATOMIC_RELAXED);
+}
+
+static void handle_event(const struct inotify_event *event) {
+    if (event->mask & IN_Q_OVERFLOW) {
+        bloom_disable("change notifications were lost");
+        return;
+    }
+    if (event->wd < 0 || event->wd >= watch.directory_capacity || !watch.directories[event->wd]) return;
+    if (event->mask & IN_IGNORED) {
+        // The directory is gone or no longer watched
+        free(watch.directories[event->wd]);
+        watch.directories[event->wd] = NULL;
+        return;
+    }
+    if (!event->len || !(event->mask & (IN_CREATE | IN_MOVED_TO))) return;
+
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s/%s", watch.directories[event->wd], event->name) >= (int) sizeof(path)) return;
+    if (event->mask & IN_ISDIR) {
+        // Moved in directories come with their contents
+        if (walk(path, true, true) < 0) bloom_disable("a new directory could not be watched");
+    } else if (watch.bloom) {
+        bloom_add(path);
+    }
+}
+
+static void *watch_thread_main(void *arg) {
+    (void) arg;
+    // Aligned for struct inotify_event, large enough for many events with names
+    char events[64 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd fds[2] = {
+        { .fd = watch.inotify_fd, .events = POLLIN },
+        { .fd = watch.stop_pipe[0], .events = POLLIN }
+    };
+    for (;;) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            LOG_ERROR("Path cache watch failed: %s", strerror(errno));
+            break;
+        }
+        if (fds[1].revents) break;
+        ssize_t length = read(watch.inotify_fd, events, sizeof(events));
+        if (length <= 0) continue;
+        for (char *event = events; event < events + length; ) {
+            const struct inotify_event *current = (const struct inotify_event *) event;
+            handle_event(current);
+            event += sizeof(struct inotify_event) + current->len;
+        }
+        // New files are in the filter before the entries saying they are missing are dropped
+        invalidate();
+    }
+    // Without notifications the filter and the entries could go stale
+    bloom_disable("the watch stopped");
+    return NULL;
+}
+
+int path_cache_watch(const char *root, bool bloom) {
+    if (!__atomic_load_n(&cache.table, __ATOMIC_ACQUIRE) || watch.running || !root || !root[0]) return 0;
+    watch.root_length = strlen(root);
+    watch.root = strdup(root);
+    watch.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (!watch.root || watch.inotify_fd < 0 || pipe2(watch.stop_pipe, O_CLOEXEC) < 0) {
+        LOG_WARN("Failed to set up the path cache watch: %s", strerror(errno));
+        watch_stop();
+        return -1;
+    }
+
+    // nftw names entries "<directory>/<name>", the way path_cache_lookup resolves them below root
+    char directory[PATH_MAX];
+    size_t length = watch.root_length;
+    if (length >= sizeof(directory)) length = sizeof(directory) - 1;
+    memcpy(directory, root, length);
+    while (length > 1 && directory[length - 1] == '/') length--;
+    directory[length] = '\0';
+    if (walk(directory, true, false) < 0) {
+        LOG_WARN("Failed to watch %s, path cache entries only expire", root);
+        watch_stop();
+        return -1;
+    }
+
+    if (bloom) {
+        size_t bits = BLOOM_MIN_BITS;
+        while (bits < watch.walk_count * BLOOM_BITS_PER_FILE) bits *= 2;
+        watch.bloom = calloc(bits / 64, sizeof(uint64_t));
+        if (watch.bloom) {
+            watch.bloom_mask = bits - 1;
+            watch.bloom_enabled = 1;
+            // The watches are already in place, files created from now on are added by the thread
+            walk(directory, false, true);
+            LOG_INFO("Path cache bloom filter of %zu bits over %zu paths", bits, watch.walk_count);
+        } else {
+            LOG_WARN("Memory allocation failed for the path cache bloom filter");
+        }
+    }
+
+    if (pthread_create(&watch.thread, NULL, watch_thread_main, NULL) != 0) {
+        LOG_WARN("Failed to start the path cache watch thread");
+        watch_stop();
+        return -1;
+    }
+    watch.running = 1;
+    LOG_INFO("Watching %s for changes", root);
+    return 0;
+}
+
+static void watch_stop(void) {
+    if (watch.running) {
+        ssize_t written = write(watch.stop_pipe[1], "", 1);
+        (void) written;
+        pthread_join(watch.thread, NULL);
+        watch.running = 0;
+    }
+    if (watch.inotify_fd >= 0) close(watch.inotify_fd);
+    for (int i = 0; i < 2; ++i) {
+        if (watch.stop_pipe[i] >= 0) close(watch.stop_pipe[i]);
+        watch.stop_pipe[i] = -1;
+    }
+    watch.inotify_fd = -1;
+    for (int i = 0; i < watch.directory_capacity; ++i) free(watch.directories[i]);
+    free(watch.directories);
+    watch.directories = NULL;
+    watch.directory_capacity = 0;
+    watch.bloom_enabled = 0;
+    free(watch.bloom);
+    watch.bloom = NULL;
+    free(watch.root);
+    watch.root = NULL;
+}
+
+#else
+
+int path_cache_watch(const char *root, bool bloom) {
+    (void) root;
+    (void) bloom;
+    LOG_WARN("Watching the document root needs inotify (Linux only), path cache entries only expire");
+    return -1;
+}
+
+static void watch_stop(void) {
+}
+
+#endif
@@ -1,6 +1,12 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // pipe2
+#endif
 #include "request_handler.h"
 #include "rio.h"
+#include "net.h"
 #include "logger.h"
+#include "probes.h"
+#include "path_cache.h"
 #include <limits.h>  // For PATH_MAX
 #include <fcntl.h>   // For open() flags like O_RDONLY
 #include <errno.h>
@@ -11,10 +17,18 @@
 #include <unistd.h>
 #include <stdbool.h>
 #include <signal.h>
+#include <sys/wait.h>
+#include <pthread.h>
 
 
 extern char **environ;  // Declaration of the global environ variable
 
+#define CGI_SPLICE_CHUNK (64 * 1024) // bytes moved per splice call, one full pipe buffer
+#define SERVER_SOFTWARE "TuringBolt/0.1"
+#define HTTP_DATE_FORMAT "%a, %d %b %Y %H:%M:%S GMT"
+#define HTTP_DATE_LENGTH 29           // "Sun, 06 Nov 1994 08:49:37 GMT"
+#define CANNED_RESPONSE_SIZE 512
+
 void initialize_response(http_response *response) {
     if (!response) {
         LOG_ERROR("NULL response passed to initialize_response");
@@ -26,7 +40,7 @@ void initialize_response(http_response *response) {
     response->reason = strdup("OK");  // Make dynamic
     
     // Set standard headers - all dynamic now
-    response->server = strdup("TuringBolt/0.1");
+    response->server = strdup(SERVER_SOFTWARE);
     
     // Generate current date in HTTP format
     time_t now = time(NULL);
@@ -35,11 +49,12 @@ void initialize_response(http_response *response) {
     gmtime_r(&now, &tm_info);
     
     char date_buf[64];
-    strftime(date_buf, sizeof(date_buf), "%a, %d %b %Y %H:%M:%S GMT", &tm_info);
+    strftime(date_buf, sizeof(date_buf), HTTP_DATE_FORMAT, &tm_info);
     response->date = strdup(date_buf);  // Already dynamic
     
     // Initialize content-related fields
     response->content_type = NULL;
+    response->mime = NULL;
     response->content_length = 0;
     response->content_encoding = NULL;
     response->last_modified = NULL;
@@ -61,13 +76,19 @@ void initialize_response(http_response *response) {
     response->extra_header_count = 0;
 }
 
+// A route may serve its files from a directory other than the document root
+static const char *request_root(const http_request *request, const server_config *config) {
+    return request->route && request->route->root ? request->route->root : config->document_root;
+}
+
 char * get_absolute_path(http_request * request, server_config * config) {
-    size_t document_root_path_length = strlen(config->document_root);
+    const char *document_root = request_root(request, config);
+    size_t document_root_path_length = strlen(document_root);
     size_t requested_file_path_length = strlen(request->path);
     
     // Skip the leading slash in request path if document_root ends with slash
     size_t skip_slash = (document_root_path_length > 0 && 
-                      config->document_root[document_root_path_length-1] == '/' && 
+                      document_root[document_root_path_length-1] == '/' && 
                       request->path[0] == '/') ? 1 : 0;
     
     size_t abs_path_len = document_root_path_length + requested_file_path_length - skip_slash;
@@ -77,82 +98,37 @@ char * get_absolute_path(http_request * request, server_config * config) {
     }
     
     char * abs_file_path = (char *) malloc(abs_path_len + 1);
-    strcpy(abs_file_path, config->document_root);
+    strcpy(abs_file_path, document_root);
     
     // Concatenate path, skipping leading slash if needed
     strcat(abs_file_path, request->path + skip_slash);
     
     return abs_file_path;
 }
-/**
- * Converts MIME_TYPE enum to corresponding Content-Type string
- * 
- * Args:
- *    MIME_TYPE mime_type: The MIME type enum value
- * 
- * Returns:
- *    const char*: String representation of the Content-Type
- */
-static char* mime_type_to_string(MIME_TYPE mime_type) {
-    switch (mime_type) {
-        case TEXT_HTML:
-            return "text/html";
-        case TEXT_PLAIN:
-            return "text/plain";
-        case TEXT_CSS:
-            return "text/css";
-        case APPLICATION_JAVASCRIPT:
-            return "application/javascript";
-        case APPLICATION_JSON:
-            return "application/json";
-        case APPLICATION_XML:
-            return "application/xml";
-        case APPLICATION_PDF:
-            return "application/pdf";
-        case APPLICATION_ZIP:
-            return "application/zip";
-        case APPLICATION_POSTSCRIPT:
-            return "application/postscript";
-        case IMAGE_GIF:
-            return "image/gif";
-        case IMAGE_PNG:
-            return "image/png";
-        case IMAGE_JPEG:
-            return "image/jpeg";
-        case IMAGE_SVG:
-            return "image/svg+xml";
-        case AUDIO_MPEG:
-            return "audio/mpeg";
-        case AUDIO_WAV:
-            return "audio/wav";
-        case VIDEO_MP4:
-            return "video/mp4";
-        case VIDEO_WEBM:
-            return "video/webm";
-        case FONT_WOFF:
-            return "font/woff";
-        case FONT_WOFF2:
-            return "font/woff2";
-        default:
-            return "application/octet-stream";  // Default binary type
-    }
-}
-
-
 const char *get_reason_phrase(int code) {
     switch (code) {
         case 200: return "OK";
         case 301: return "Moved Permanently";
+        case 302: return "Found";
+        case 307: return "Temporary Redirect";
+        case 308: return "Permanent Redirect";
         case 400: return "Bad Request";
         case 403: return "Forbidden";
         case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 408: return "Request Timeout";
+        case 413: return "Content Too Large";
+        case 414: return "URI Too Long";
         case 501: return "Not Implemented";
         case 505: return "HTTP Version Not Supported";
         case 500: return "Internal Server Error";
+        case 503: return "Service Unavailable";
         default:  return "Unknown Status Code";
     }
 }
 
+static int set_content_headers_from_stat(http_request *request, http_response *response, const struct stat *file_stat);
+
 int set_content_headers(int fd, http_request *request, http_response *response, const char *file_path) {
     if (!response || fd < 0 || !request) {
         LOG_ERROR("Invalid parameters passed to set_content_headers");
@@ -165,17 +141,21 @@ int set_content_headers(int fd, http_request *request, http_response *response,
         LOG_ERROR("Failed to get file stats for %s: %s", file_path, strerror(errno));
         return -1;
     }
-    
+    return set_content_headers_from_stat(request, response, &file_stat);
+}
+
+static int set_content_headers_from_stat(http_request *request, http_response *response, const struct stat *file_stat) {
     // Set Content-Length based on file size
-    response->content_length = (size_t) file_stat.st_size;
+    response->content_length = (size_t) file_stat->st_size;
     
-    // Set Content-Type based on MIME type from request - make dynamic
-    response->content_type = strdup(mime_type_to_string(request->mime_type));
+    // Content-Type header line straight from the MIME table, requests built by hand only set mime_type
+    response->mime = request->mime ? request->mime : mime_for_type(request->mime_type);
     
     // Set Last-Modified header
-    struct tm *tm_info = gmtime(&file_stat.st_mtime);
+    struct tm tm_info;
+    gmtime_r(&file_stat->st_mtime, &tm_info);
     char last_mod_buf[64];
-    strftime(last_mod_buf, sizeof(last_mod_buf), "%a, %d %b %Y %H:%M:%S GMT", tm_info);
+    strftime(last_mod_buf, sizeof(last_mod_buf), "%a, %d %b %Y %H:%M:%S GMT", &tm_info);
     
     // Free existing value if present
     if (response->last_modified) {
@@ -194,57 +174,98 @@ int set_content_headers(int fd, http_request *request, http_response *response,
     return 0;
 }
 
+static int serve_native(http_request *request, http_response *response, int client_fd, server_config *config);
+static int serve_redirect(http_request *request, http_response *response, int client_fd);
+
 int execute_request(http_request *request, int client_fd, server_config *config) {
     http_response response;
     initialize_response(&response);
     int status;
     
-    if(request->is_dynamic) {
+    // The header, the body chunks and a possible error header leave in full segments, uncorking
+    // below flushes the tail
+    bool corked = config->tcp_cork && set_tcp_cork(client_fd, true) == 0;
+    
+    const route *target = request->route;
+    if(target && target->action == ROUTE_NATIVE) {
+        status = serve_native(request, &response, client_fd, config);
+    }
+    else if(target && target->action == ROUTE_REDIRECT) {
+        status = serve_redirect(request, &response, client_fd);
+    }
+    else if(request->is_dynamic) {
         status = serve_dynamic(request, &response, client_fd, config);
     }
     else {
         status = serve_static(request, &response, client_fd, config);
     }
     
+    if(request->timing) {
+        request->timing->status_code = response.status_code;
+    }
+
     if(status == -1){
-        char * response_header = generate_response_header(&response);
-        if(response_header) {
-            if(rio_unbuffered_write(client_fd, response_header, strlen(response_header)) == -1) {
-                LOG_ERROR("Failed to write error response header");
-            }
-            free(response_header);
+        // Failures that did not set an error status are internal errors
+        if(response.status_code < 400) {
+            response.status_code = 500;
+        }
+        if(request->timing) {
+            request->timing->status_code = response.status_code;
+        }
+        timer_refresh(request->deadline);
+        if(send_error_response(client_fd, response.status_code) == -1) {
+            LOG_ERROR("Failed to write error response");
         }
         else {
-            // Could not generate response header - this is the only real failure
-            destroy_response(&response);
-            return -1;
+            timing_mark(request->timing, PHASE_FIRST_RESPONSE_BYTE);
         }
     }
     
+    if(corked) {
+        set_tcp_cork(client_fd, false);
+    }
     destroy_response(&response);
     return 0;
 }
 
+static int send_static_file(http_request *request, http_response * response, int client_fd, server_config *config);
+static int run_cgi_script(http_request *request, http_response * response, int client_fd, server_config *config);
+
 int serve_static(http_request *request, http_response * response, int client_fd, server_config *config) {
-    if (!request || !response || !config || client_fd < 0) {
-        LOG_ERROR("Invalid parameters passed to serve_dynamic");
-        response->status_code = 500;
-        free(response->reason);
-        response->reason = strdup("Internal Server Error");
-        return -1;
-    }
-    char * abs_file_path = get_absolute_path(request, config);
-    if(!abs_file_path) {
+    PROBE2(static__start, client_fd, request ? request->path : NULL);
+    int status = send_static_file(request, response, client_fd, config);
+    PROBE4(static__done, client_fd, request ? request->path : NULL, response ? response->content_length : 0,
+           response ? response->status_code : 500);
+    return status;
+}
+
+int open_static_file(http_request *request, http_response * response, server_config *config) {
+    /*
+    The cache saves resolving the path and answers paths known to be missing with a 404 right away. The
+    headers come from an fstat of the descriptor the body is sent from: a cached stat result may be up
+    to PathCacheTtl old, and a file truncated or replaced since then would get the wrong Content-Length
+    */
+    char abs_file_path[PATH_MAX];
+    struct stat file_stat;
+    int cached = path_cache_lookup(request_root(request, config), request->path, abs_file_path, sizeof(abs_file_path), &file_stat);
+    if(cached < 0) {
         response->status_code = 414;
         free(response->reason);
         response->reason = strdup("URI Too Long");
         return -1;
     }
-    int fd = open(abs_file_path, O_RDONLY);
+    int fd = -1;
+    if (cached == PATH_CACHE_MISSING) {
+        errno = ENOENT;
+    } else {
+        fd = open(abs_file_path, O_RDONLY | O_CLOEXEC);
+    }
     if (fd < 0) {
         switch (errno) {
             case ENOENT:
+            case ENOTDIR:
                 // File not found
+                if (cached != PATH_CACHE_MISSING) path_cache_store_missing(abs_file_path);
                 response->status_code = 404;
                 free(response->reason);
                 response->reason = strdup("Not Found");
@@ -270,16 +291,46 @@ int serve_static(http_request *request, http_response * response, int client_fd,
                 LOG_ERROR("Failed to open file %s: %s", abs_file_path, strerror(errno));
                 break;
         }
-        free(abs_file_path);
         return -1;
     }
-    set_content_headers(fd, request, response, abs_file_path);
-    free(abs_file_path);
+    struct stat cached_stat = file_stat;
+    if (fstat(fd, &file_stat) < 0) {
+        LOG_ERROR("Failed to get file stats for %s: %s", abs_file_path, strerror(errno));
+        close(fd);
+        response->status_code = 500;
+        free(response->reason);
+        response->reason = strdup("Internal Server Error");
+        return -1;
+    }
+    if (cached == PATH_CACHE_MISS || cached_stat.st_ino != file_stat.st_ino || cached_stat.st_size != file_stat.st_size ||
+        cached_stat.st_mtime != file_stat.st_mtime) {
+        path_cache_store(abs_file_path, &file_stat);
+    }
+    timing_mark(request->timing, PHASE_HANDLER_START);
+    set_content_headers_from_stat(request, response, &file_stat);
+    if (request->route && request->route->cache_control) {
+        free(response->cache_control);
+        response->cache_control = strdup(request->route->cache_control);
+    }
 
     response->status_code = 200;
     free(response->reason);
     response->reason = strdup("OK");
+    return fd;
+}
 
+static int send_static_file(http_request *request, http_response * response, int client_fd, server_config *config) {
+    if (!request || !response || !config || client_fd < 0) {
+        LOG_ERROR("Invalid parameters passed to serve_dynamic");
+        response->status_code = 500;
+        free(response->reason);
+        response->reason = strdup("Internal Server Error");
+        return -1;
+    }
+    int fd = open_static_file(request, response, config);
+    if (fd < 0) {
+        return -1;
+    }
     
     char * response_header = generate_response_header(response);
 
@@ -292,21 +343,42 @@ int serve_static(http_request *request, http_response * response, int client_fd,
         return -1;
     }
 
+    // The first chunk of the file goes out in the same write as the header. No more than Content-Length
+    // bytes are sent even if the file grew since the fstat
+    size_t remaining = response->content_length;
+    char read_buffer[BUFFER_SIZE];
+    ssize_t read_size = rio_unbuffered_read(fd, read_buffer, remaining < BUFFER_SIZE ? remaining : BUFFER_SIZE);
+    if(read_size < 0) {
+        response->status_code = 500;
+        free(response->reason);
+        response->reason = strdup("Internal Server Error");
+        free(response_header);
+        close(fd);
+        return -1;
+    }
+
     // Commit to the response header even if the read/write from/to file/socket fail.
 
-    if(rio_unbuffered_write(client_fd, response_header, strlen(response_header)) == -1) {
+    timer_refresh(request->deadline);
+    struct iovec iov[2] = {
+        { response_header, strlen(response_header) },
+        { read_buffer, (size_t) read_size },
+    };
+    if(rio_writev(client_fd, iov, 2) == -1) {
         response->status_code = 500;
         free(response->reason);
         response->reason = strdup("Internal Server Error");
         free(response_header);
+        close(fd);
         return -1;
     }
+    timing_mark(request->timing, PHASE_FIRST_RESPONSE_BYTE);
     free(response_header);
+    remaining -= (size_t) read_size;
 
-    char read_buffer[BUFFER_SIZE];
-    ssize_t read_size = 0;
-    do{
-        read_size = rio_unbuffered_read(fd, read_buffer, BUFFER_SIZE);
+    while(read_size > 0 && remaining > 0) {
+        read_size = rio_unbuffered_read(fd, read_buffer, remaining < BUFFER_SIZE ? remaining : BUFFER_SIZE);
+        timer_refresh(request->deadline); // each chunk that goes out counts as progress
         if(read_size < 0 || rio_unbuffered_write(client_fd, read_buffer, (size_t) read_size) == -1) { // The explicit type cast is useless here but doing it to bypass the compilation flags
             response->status_code = 500; 
             free(response->reason);
@@ -314,13 +386,75 @@ int serve_static(http_request *request, http_response * response, int client_fd,
             close(fd);
             return -1;
         }
-    }while(read_size > 0);
+        remaining -= (size_t) read_size;
+    }
+    if (remaining > 0) {
+        // The connection is closed after the response, the client sees the body end early
+        LOG_WARN("%s shrank while it was sent, %zu bytes short of its Content-Length", request->path, remaining);
+    }
     
     close(fd);
     return 0;
 }
 
 int serve_dynamic(http_request *request, http_response *response, int client_fd, server_config *config) {
+    int status = run_cgi_script(request, response, client_fd, config);
+    PROBE4(cgi__done, client_fd, request ? request->path : NULL, response ? response->content_length : 0,
+           response ? response->status_code : 500);
+    return status;
+}
+
+/**
+ * Stops a CGI script whose output is no longer needed: closes the read end of its output pipe (if
+ * still open), terminates it and reaps it. Does nothing once the pipe was closed by the caller
+ */
+static void stop_cgi_script(pid_t pid, int *pipe_fd) {
+    if (*pipe_fd < 0) {
+        return;
+    }
+    close(*pipe_fd);
+    *pipe_fd = -1;
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+}
+
+/**
+ * Moves the rest of a CGI script's output from pipe_fd to the client until the script closes it.
+ * Uses splice where the kernel supports it, otherwise (or if the socket refuses splicing) a read/write loop.
+ * Returns the number of bytes forwarded, -1 on error
+ */
+static ssize_t forward_cgi_body(http_request *request, int pipe_fd, int client_fd) {
+    size_t forwarded = 0;
+    ssize_t moved;
+    while ((moved = rio_splice(pipe_fd, client_fd, CGI_SPLICE_CHUNK)) > 0) {
+        forwarded += (size_t) moved;
+        timer_refresh(request->deadline); // each chunk that goes out counts as progress
+    }
+    if (moved == 0) {
+        return (ssize_t) forwarded;
+    }
+    if (errno != EINVAL && errno != ENOSYS) {
+        return -1;
+    }
+
+    char read_buffer[BUFFER_SIZE];
+    ssize_t bytes_read;
+    while ((bytes_read = read(pipe_fd, read_buffer, BUFFER_SIZE)) != 0) {
+        if (bytes_read < 0) {
+            if (errno == EINTR) continue;
+            LOG_ERROR("Failed to read from CGI output: %s", strerror(errno));
+            return -1;
+        }
+        timer_refresh(request->deadline);
+        if (rio_unbuffered_write(client_fd, read_buffer, (size_t) bytes_read) == -1) {
+            return -1;
+        }
+        forwarded += (size_t) bytes_read;
+    }
+    return (ssize_t) forwarded;
+}
+
+static int run_cgi_script(http_request *request, http_response *response, int client_fd, server_config *config) {
     if (!request || !response || !config || client_fd < 0) {
         LOG_ERROR("Invalid parameters passed to serve_dynamic");
         response->status_code = 500;
@@ -329,8 +463,10 @@ int serve_dynamic(http_request *request, http_response *response, int client_fd,
         return -1;
     }
 
-    char *abs_file_path = get_absolute_path(request, config);
-    if (!abs_file_path) {
+    char abs_file_path[PATH_MAX];
+    struct stat script_stat;
+    int cached = path_cache_lookup(request_root(request, config), request->path, abs_file_path, sizeof(abs_file_path), &script_stat);
+    if (cached < 0) {
         LOG_ERROR("Failed to get absolute path for CGI script");
         response->status_code = 414;
         free(response->reason);
@@ -338,22 +474,28 @@ int serve_dynamic(http_request *request, http_response *response, int client_fd,
         return -1;
     }
 
-    // Check if file exists and is executable
-    if (access(abs_file_path, F_OK) != 0) {
+    // Check if file exists and is executable, execve has the final say on the permissions
+    if (cached == PATH_CACHE_MISS) {
+        if (stat(abs_file_path, &script_stat) == 0) {
+            path_cache_store(abs_file_path, &script_stat);
+        } else {
+            if (errno == ENOENT || errno == ENOTDIR) path_cache_store_missing(abs_file_path);
+            cached = PATH_CACHE_MISSING;
+        }
+    }
+    if (cached == PATH_CACHE_MISSING) {
         LOG_ERROR("CGI script not found: %s", abs_file_path);
         response->status_code = 404;
         free(response->reason);
         response->reason = strdup("Not Found");
-        free(abs_file_path);
         return -1;
     }
 
-    if (access(abs_file_path, X_OK) != 0) {
+    if (!S_ISREG(script_stat.st_mode) || !(script_stat.st_mode & (S_IXUSR | S_IXGRP | S_IXOTH))) {
         LOG_ERROR("CGI script not executable: %s", abs_file_path);
         response->status_code = 403;
         free(response->reason);
         response->reason = strdup("Forbidden");
-        free(abs_file_path);
         return -1;
     }
 
@@ -361,18 +503,21 @@ int serve_dynamic(http_request *request, http_response *response, int client_fd,
     int pipe_to_child[2];   // Server writes to child (for POST data later)
     int pipe_from_child[2]; // Child writes to server (CGI output)
     
-    if (pipe(pipe_to_child) < 0 || pipe(pipe_from_child) < 0) {
+    // Close-on-exec so concurrent CGI children only inherit their own pipes, dup2 clears the flag on stdin/stdout
+    if (pipe2(pipe_to_child, O_CLOEXEC) < 0 || pipe2(pipe_from_child, O_CLOEXEC) < 0) {
         LOG_ERROR("Failed to create pipes for CGI communication: %s", strerror(errno));
         response->status_code = 500;
         free(response->reason);
         response->reason = strdup("Internal Server Error");
-        free(abs_file_path);
         return -1;
     }
 
     LOG_INFO("Executing CGI script: %s", abs_file_path);
 
     pid_t pid = fork();
+    if (pid > 0) {
+        timing_mark(request->timing, PHASE_HANDLER_START);
+    }
     if (pid < 0) {
         LOG_ERROR("Failed to fork for CGI execution: %s", strerror(errno));
         response->status_code = 500;
@@ -382,7 +527,6 @@ int serve_dynamic(http_request *request, http_response *response, int client_fd,
         close(pipe_to_child[1]);
         close(pipe_from_child[0]);
         close(pipe_from_child[1]);
-        free(abs_file_path);
         return -1;
     } 
     else if (pid == 0) {
@@ -399,24 +543,15 @@ int serve_dynamic(http_request *request, http_response *response, int client_fd,
         setenv("CONTENT_TYPE", "", 1);         // Empty for GET
         setenv("CONTENT_LENGTH", "0", 1);      // 0 for GET
         
-        // Set QUERY_STRING if we have parameters
-        if (request->param_count > 0) {
-            char query_string[BUFFER_SIZE] = "";
-            size_t offset = 0;
-            for (int i = 0; i < request->param_count; i++) {
-                int written = snprintf(query_string + offset, BUFFER_SIZE - offset, 
-                                    "%s%s=%s", 
-                                    i > 0 ? "&" : "", 
-                                    request->param_names[i], 
-                                    request->param_values[i]);
-                if (written < 0 || offset + written >= BUFFER_SIZE) {
-                    // Exit with specific code for query string too long
-                    exit(EXIT_QUERY_TOO_LONG);  
-                }
-                offset += written;
-            }
-            setenv("QUERY_STRING", query_string, 1);
-        } else setenv("QUERY_STRING", "", 1);
+        // QUERY_STRING is the query as the client sent it, still encoded, the script splits it itself
+        if (request->query.length >= BUFFER_SIZE) {
+            // Exit with specific code for query string too long
+            exit(EXIT_QUERY_TOO_LONG);
+        }
+        char query_string[BUFFER_SIZE];
+        if (request->query.length > 0) memcpy(query_string, request->query.data, request->query.length);
+        query_string[request->query.length] = '\0';
+        setenv("QUERY_STRING", query_string, 1);
         
 
         // Redirect stdin and stdout for CGI communication
@@ -446,27 +581,28 @@ int serve_dynamic(http_request *request, http_response *response, int client_fd,
         close(pipe_to_child[1]);   // We don't write to child's stdin (for GET)
         close(pipe_from_child[1]); // We don't write to child's stdout
         
-        free(abs_file_path);
+        PROBE3(cgi__spawn, client_fd, abs_file_path, pid);
 
-        // Read all CGI output first
-        char *cgi_output = malloc(BUFFER_SIZE * 10); // Start with 80KB buffer
+        // Buffer the output until the script exits or the buffer is full. A response that fits is
+        // checked against the exit code before anything is sent. A longer one is streamed: the header
+        // block goes out from the buffer and the rest of the body moves from the pipe to the client
+        // without being copied through user space
+        size_t output_capacity = BUFFER_SIZE * 10; // 80KB
+        char *cgi_output = malloc(output_capacity);
         if (!cgi_output) {
             LOG_ERROR("Failed to allocate memory for CGI output");
             response->status_code = 500;
             free(response->reason);
             response->reason = strdup("Internal Server Error");
-            close(pipe_from_child[0]);
-            kill(pid, SIGTERM);
-            waitpid(pid, NULL, 0);
+            stop_cgi_script(pid, &pipe_from_child[0]);
             return -1;
         }
 
         size_t total_output = 0;
-        size_t output_capacity = BUFFER_SIZE * 10;
-        char read_buffer[BUFFER_SIZE];
         ssize_t bytes_read;
-
-        while ((bytes_read = read(pipe_from_child[0], read_buffer, BUFFER_SIZE)) != 0) {
+        // One byte stays free for the terminator
+        while (total_output < output_capacity - 1 &&
+               (bytes_read = read(pipe_from_child[0], cgi_output + total_output, output_capacity - 1 - total_output)) != 0) {
             if (bytes_read < 0) {
                 if (errno == EINTR) continue;  // Just retry the read
                 
@@ -476,75 +612,56 @@ int serve_dynamic(http_request *request, http_response *response, int client_fd,
                 response->status_code = 500;
                 free(response->reason);
                 response->reason = strdup("Internal Server Error");
-                close(pipe_from_child[0]);
-                kill(pid, SIGTERM);
-                waitpid(pid, NULL, 0);
+                stop_cgi_script(pid, &pipe_from_child[0]);
                 return -1;
             }
-            
-            // Normal processing for bytes_read > 0
-            // Resize buffer if needed
-            if (total_output + bytes_read >= output_capacity) {
-                output_capacity *= 2;
-                char *new_output = realloc(cgi_output, output_capacity);
-                if (!new_output) {
-                    LOG_ERROR("Failed to reallocate memory for CGI output");
-                    free(cgi_output);
-                    response->status_code = 500;
-                    free(response->reason);
-                    response->reason = strdup("Internal Server Error");
-                    close(pipe_from_child[0]);
-                    kill(pid, SIGTERM);
-                    waitpid(pid, NULL, 0);
-                    return -1;
-                }
-                cgi_output = new_output;
-            }
-
-            memcpy(cgi_output + total_output, read_buffer, bytes_read);
-            total_output += bytes_read;
+            total_output += (size_t) bytes_read;
         }
+        bool streaming = total_output == output_capacity - 1;
 
-        close(pipe_from_child[0]);
+        if (!streaming) {
+            close(pipe_from_child[0]);
+            pipe_from_child[0] = -1;
 
-        // Wait for child process to complete
-        int status;
-        if (waitpid(pid, &status, 0) < 0) {
-            LOG_ERROR("Failed to wait for CGI process: %s", strerror(errno));
-        }
+            // Wait for child process to complete
+            int status;
+            if (waitpid(pid, &status, 0) < 0) {
+                LOG_ERROR("Failed to wait for CGI process: %s", strerror(errno));
+            }
 
-        if(!WIFEXITED(status)) {
-            LOG_ERROR("CGI script failed with status: %d", WEXITSTATUS(status));
-            response->status_code = 500;
-            free(response->reason);
-            response->reason = strdup("Internal Server Error");
-            free(cgi_output);
-            return -1;            
-        }
-        int exit_code = WEXITSTATUS(status);
-        if (exit_code == EXIT_QUERY_TOO_LONG) {
-            LOG_ERROR("CGI script failed: Query string too long");
-            response->status_code = 414;  // URI Too Long
-            free(response->reason);
-            response->reason = strdup("URI Too Long");
-            free(cgi_output);
-            return -1;
-        } else if (exit_code != 0) {
-            LOG_ERROR("CGI script failed with exit code: %d", exit_code);
-            response->status_code = 500;
-            free(response->reason);
-            response->reason = strdup("Internal Server Error");
-            free(cgi_output);
-            return -1;
-        }
+            if(!WIFEXITED(status)) {
+                LOG_ERROR("CGI script failed with status: %d", WEXITSTATUS(status));
+                response->status_code = 500;
+                free(response->reason);
+                response->reason = strdup("Internal Server Error");
+                free(cgi_output);
+                return -1;            
+            }
+            int exit_code = WEXITSTATUS(status);
+            if (exit_code == EXIT_QUERY_TOO_LONG) {
+                LOG_ERROR("CGI script failed: Query string too long");
+                response->status_code = 414;  // URI Too Long
+                free(response->reason);
+                response->reason = strdup("URI Too Long");
+                free(cgi_output);
+                return -1;
+            } else if (exit_code != 0) {
+                LOG_ERROR("CGI script failed with exit code: %d", exit_code);
+                response->status_code = 500;
+                free(response->reason);
+                response->reason = strdup("Internal Server Error");
+                free(cgi_output);
+                return -1;
+            }
 
-        if (total_output == 0) {
-            LOG_ERROR("CGI script produced no output");
-            response->status_code = 500;
-            free(response->reason);
-            response->reason = strdup("Internal Server Error");
-            free(cgi_output);
-            return -1;
+            if (total_output == 0) {
+                LOG_ERROR("CGI script produced no output");
+                response->status_code = 500;
+                free(response->reason);
+                response->reason = strdup("Internal Server Error");
+                free(cgi_output);
+                return -1;
+            }
         }
 
         // Null-terminate the output
@@ -562,6 +679,7 @@ int serve_dynamic(http_request *request, http_response *response, int client_fd,
             free(response->reason);
             response->reason = strdup("Internal Server Error");
             free(cgi_output);
+            stop_cgi_script(pid, &pipe_from_child[0]);
             return -1;
         }
 
@@ -586,6 +704,7 @@ int serve_dynamic(http_request *request, http_response *response, int client_fd,
             free(response->reason);
             response->reason = strdup("Internal Server Error");
             free(cgi_output);
+            stop_cgi_script(pid, &pipe_from_child[0]);
             return -1;
         }
         
@@ -607,13 +726,6 @@ int serve_dynamic(http_request *request, http_response *response, int client_fd,
         // Write HTTP status line
         const char *reason_phrase = get_reason_phrase(cgi_status);
         snprintf(status_line, sizeof(status_line), "HTTP/1.1 %d %s\r\n", cgi_status, reason_phrase);
-        
-        if (rio_unbuffered_write(client_fd, status_line, strlen(status_line)) == -1) {
-            LOG_ERROR("Failed to write status line to client");
-            free(headers_section);
-            free(cgi_output);
-            return -1;
-        }
 
         // Write standard server headers
         char server_headers[256];
@@ -623,16 +735,30 @@ int serve_dynamic(http_request *request, http_response *response, int client_fd,
                 "Connection: close\r\n",
                 response->date,              
                 config->server_name);
-                
-        if (rio_unbuffered_write(client_fd, server_headers, strlen(server_headers)) == -1) {
-            LOG_ERROR("Failed to write server headers to client");
+
+        // Status line, server headers, every CGI header line plus its CRLF, separator and body
+        size_t header_lines = 1;
+        for (const char *c = headers_section; *c; ++c) {
+            if (*c == '\n') header_lines++;
+        }
+        struct iovec *iov = malloc((2 * header_lines + 4) * sizeof(struct iovec));
+        if (!iov) {
+            LOG_ERROR("Failed to allocate memory for response vector");
+            response->status_code = 500;
+            free(response->reason);
+            response->reason = strdup("Internal Server Error");
             free(headers_section);
             free(cgi_output);
+            stop_cgi_script(pid, &pipe_from_child[0]);
             return -1;
         }
+        int iovcnt = 0;
+        iov[iovcnt++] = (struct iovec){ status_line, strlen(status_line) };
+        iov[iovcnt++] = (struct iovec){ server_headers, strlen(server_headers) };
 
-        // Process and write CGI headers (skip Status header)
-        char *header_line = strtok(headers_section, "\n");
+        // Process CGI headers (skip Status header)
+        char *save_ptr = NULL;
+        char *header_line = strtok_r(headers_section, "\n", &save_ptr);
         while (header_line) {
             // Remove \r if present
             char *cr = strchr(header_line, '\r');
@@ -640,46 +766,335 @@ int serve_dynamic(http_request *request, http_response *response, int client_fd,
             
             // Skip Status header as we already processed it
             if (strncmp(header_line, "Status:", 7) != 0 && strlen(header_line) > 0) {
-                if (rio_unbuffered_write(client_fd, header_line, strlen(header_line)) == -1 ||
-                    rio_unbuffered_write(client_fd, "\r\n", 2) == -1) {
-                    LOG_ERROR("Failed to write CGI header to client");
-                    free(headers_section);
-                    free(cgi_output);
-                    return -1;
-                }
+                iov[iovcnt++] = (struct iovec){ header_line, strlen(header_line) };
+                iov[iovcnt++] = (struct iovec){ "\r\n", 2 };
             }
             
-            header_line = strtok(NULL, "\n");
+            header_line = strtok_r(NULL, "\n", &save_ptr);
         }
 
-        // Write header/body separator
-        if (rio_unbuffered_write(client_fd, "\r\n", 2) == -1) {
-            LOG_ERROR("Failed to write header separator to client");
-            free(headers_section);
-            free(cgi_output);
+        // Header/body separator and the buffered part of the body
+        size_t body_len = total_output - (body_section - cgi_output);
+        iov[iovcnt++] = (struct iovec){ "\r\n", 2 };
+        iov[iovcnt++] = (struct iovec){ body_section, body_len };
+
+        timer_refresh(request->deadline);
+        ssize_t written = rio_writev(client_fd, iov, iovcnt);
+        free(iov);
+        free(headers_section);
+        free(cgi_output);
+        if (written == -1) {
+            LOG_ERROR("Failed to write CGI response to client");
+            stop_cgi_script(pid, &pipe_from_child[0]);
             return -1;
         }
+        timing_mark(request->timing, PHASE_FIRST_RESPONSE_BYTE);
+        response->status_code = cgi_status;
 
-        // Write body content
-        size_t body_len = total_output - (body_section - cgi_output);
-        if (body_len > 0) {
-            if (rio_unbuffered_write(client_fd, body_section, body_len) == -1) {
-                LOG_ERROR("Failed to write body to client");
-                free(headers_section);
-                free(cgi_output);
+        if (streaming) {
+            // The status line is already out, a script failing from here on can only cut the body short
+            ssize_t forwarded = forward_cgi_body(request, pipe_from_child[0], client_fd);
+            close(pipe_from_child[0]);
+            pipe_from_child[0] = -1;
+            if (forwarded < 0) {
+                LOG_ERROR("Failed to forward CGI body to client");
+                kill(pid, SIGTERM);
+                waitpid(pid, NULL, 0);
                 return -1;
             }
+            body_len += (size_t) forwarded;
+
+            int status;
+            if (waitpid(pid, &status, 0) < 0) {
+                LOG_ERROR("Failed to wait for CGI process: %s", strerror(errno));
+            } else if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                LOG_WARN("CGI script failed after its response was sent (status %d)", status);
+            }
         }
 
-        // Cleanup
-        free(headers_section);
-        free(cgi_output);
+        response->content_length = body_len;
         
         LOG_INFO("Successfully served dynamic content");
         return 0;
     }
 }
 
+/*
+Error responses that are sent often (404s make up much of scanner and bot traffic) are rendered once.
+Each is sent as three pieces with one writev: everything before the Date value, the current date and
+everything after it, so the rendered text is never modified and needs no lock.
+*/
+typedef struct {
+    int status_code;
+    const char *message;
+    char text[CANNED_RESPONSE_SIZE];
+    size_t length;
+    size_t date_offset; // where the Date value goes
+} canned_response;
+
+static canned_response canned_responses[] = {
+    { 400, "The request could not be understood by the server", "", 0, 0 },
+    { 403, "You do not have permission to access this resource", "", 0, 0 },
+    { 404, "The requested resource was not found on this server", "", 0, 0 },
+    { 405, "The request method is not supported for this resource", "", 0, 0 },
+    { 408, "The request was not received in time", "", 0, 0 },
+    { 413, "The request is larger than the server is willing to process", "", 0, 0 },
+    { 414, "The request URI is longer than the server is willing to process", "", 0, 0 },
+    { 500, "The server encountered an internal error", "", 0, 0 },
+    { 501, "The server does not support the requested functionality", "", 0, 0 },
+    { 503, "The server is temporarily unable to handle the request", "", 0, 0 },
+    { 505, "The HTTP version used in the request is not supported", "", 0, 0 },
+};
+#define CANNED_RESPONSE_COUNT (sizeof(canned_responses) / sizeof(canned_responses[0]))
+
+static pthread_once_t canned_responses_once = PTHREAD_ONCE_INIT;
+
+static int render_error_response(char *buf, size_t size, int status_code, const char *message, size_t *date_offset) {
+    const char *reason = get_reason_phrase(status_code);
+    char body[384];
+    int body_length = snprintf(body, sizeof(body),
+        "<html><head><title>%d %s</title></head>"
+        "<body><h1>%d %s</h1><p>%s</p></body></html>",
+        status_code, reason, status_code, reason, message);
+    int head_length = snprintf(buf, size, "HTTP/1.1 %d %s\r\nDate: ", status_code, reason);
+    if (body_length < 0 || (size_t) body_length >= sizeof(body) || head_length < 0 || (size_t) head_length >= size) {
+        return -1;
+    }
+    *date_offset = (size_t) head_length;
+    // The date is a placeholder of the right length, senders replace it
+    int length = snprintf(buf + head_length, size - (size_t) head_length,
+        "%-*s\r\n"
+        "Server: " SERVER_SOFTWARE "\r\n"
+        "Connection: close\r\n"
+        "Content-Type: text/html\r\n"
+        "Content-Length: %d\r\n"
+        "\r\n"
+        "%s",
+        HTTP_DATE_LENGTH, "", body_length, body);
+    if (length < 0 || (size_t) length >= size - (size_t) head_length) return -1;
+    return head_length + length;
+}
+
+static void render_canned_responses(void) {
+    for (size_t i = 0; i < CANNED_RESPONSE_COUNT; ++i) {
+        canned_response *canned = &canned_responses[i];
+        int length = render_error_response(canned->text, sizeof(canned->text), canned->status_code,
+                                           canned->message, &canned->date_offset);
+        if (length < 0) {
+            LOG_ERROR("Canned %d response does not fit in %d bytes", canned->status_code, CANNED_RESPONSE_SIZE);
+            continue; // length stays 0, the response is rendered per request
+        }
+        canned->length = (size_t) length;
+    }
+}
+
+void canned_responses_init(void) {
+    pthread_once(&canned_responses_once, render_canned_responses);
+}
+
+// Date header value for now, formatted once per second per thread
+static const char *current_http_date(void) {
+    static __thread time_t cached_second = -1;
+    static __thread char cached_date[HTTP_DATE_LENGTH + 1];
+    time_t now = time(NULL);
+    if (now != cached_second) {
+        struct tm tm_info;
+        gmtime_r(&now, &tm_info);
+        strftime(cached_date, sizeof(cached_date), HTTP_DATE_FORMAT, &tm_info);
+        cached_second = now;
+    }
+    return cached_date;
+}
+
+static const canned_response *find_canned_response(int status_code) {
+    canned_responses_init();
+    for (size_t i = 0; i < CANNED_RESPONSE_COUNT; ++i) {
+        if (canned_responses[i].status_code == status_code && canned_responses[i].length > 0) {
+            return &canned_responses[i];
+        }
+    }
+    return NULL;
+}
+
+ssize_t format_error_response(int status_code, char *buf, size_t size) {
+    const canned_response *canned = find_canned_response(status_code);
+    size_t date_offset;
+    ssize_t length;
+    if (canned) {
+        if (canned->length > size) return -1;
+        memcpy(buf, canned->text, canned->length);
+        date_offset = canned->date_offset;
+        length = (ssize_t) canned->length;
+    } else {
+        // Not a canned code, rendered for this request
+        int rendered = render_error_response(buf, size, status_code, "The request could not be completed", &date_offset);
+        if (rendered < 0) return -1;
+        length = rendered;
+    }
+    memcpy(buf + date_offset, current_http_date(), HTTP_DATE_LENGTH);
+    return length;
+}
+
+int send_error_response(int client_fd, int status_code) {
+    const canned_response *canned = find_canned_response(status_code);
+    if (canned) {
+        struct iovec iov[3] = {
+            { (void *) canned->text, canned->date_offset },
+            { (void *) current_http_date(), HTTP_DATE_LENGTH },
+            { (void *) (canned->text + canned->date_offset + HTTP_DATE_LENGTH),
+              canned->length - canned->date_offset - HTTP_DATE_LENGTH },
+        };
+        return rio_writev(client_fd, iov, 3) < 0 ? -1 : 0;
+    }
+
+    char text[CANNED_RESPONSE_SIZE];
+    ssize_t length = format_error_response(status_code, text, sizeof(text));
+    if (length < 0) {
+        LOG_ERROR("Failed to render %d response", status_code);
+        return -1;
+    }
+    return rio_unbuffered_write(client_fd, text, (size_t) length) < 0 ? -1 : 0;
+}
+
+/*
+Handlers built into the server, indexed by the NATIVE_HANDLER of their route. They send the whole
+response themselves
+*/
+typedef int (*native_handler)(http_request *request, http_response *response, int client_fd, server_config *config);
+
+static int serve_status_page(http_request *request, http_response *response, int client_fd, server_config *config) {
+    (void) response;
+    (void) config;
+    send_status_response(client_fd, request->timing);
+    return 0;
+}
+
+static const native_handler native_handlers[NATIVE_HANDLER_COUNT] = {
+    [NATIVE_STATUS] = serve_status_page,
+};
+
+static int serve_native(http_request *request, http_response *response, int client_fd, server_config *config) {
+    timing_mark(request->timing, PHASE_HANDLER_START);
+    return native_handlers[request->route->native](request, response, client_fd, config);
+}
+
+// Bytes a decoded path may hold as they are: the unreserved ones and the sub-delimiters of a path but '+',
+// which the parser decodes to a space
+static bool path_byte_plain(unsigned char byte) {
+    return (byte >= 'a' && byte <= 'z') || (byte >= 'A' && byte <= 'Z') || (byte >= '0' && byte <= '9') ||
+           strchr("/-._~!$&'()*,;=:@", byte) != NULL;
+}
+
+// The query is passed on as sent, escapes included, only bytes that may not appear in a header are encoded
+static bool query_byte_plain(unsigned char byte) {
+    return byte > ' ' && byte < 0x7F;
+}
+
+/*
+Percent-encodes the length bytes of text into buf, every byte plain rejects. buf is NUL terminated
+
+Returns
+    length of the encoded text, -1 if it does not fit in size bytes
+*/
+static int percent_encode(const char *text, size_t length, bool (*plain)(unsigned char), char *buf, size_t size) {
+    static const char hex_digits[] = "0123456789ABCDEF";
+    size_t encoded = 0;
+    for (const unsigned char *p = (const unsigned char *) text; p < (const unsigned char *) text + length; ++p) {
+        bool keep = *p != '\0' && plain(*p);
+        if (encoded + (keep ? 1 : 3) >= size) return -1;
+        if (keep) {
+            buf[encoded++] = (char) *p;
+        } else {
+            buf[encoded++] = '%';
+            buf[encoded++] = hex_digits[*p >> 4];
+            buf[encoded++] = hex_digits[*p & 0x0F];
+        }
+    }
+    buf[encoded] = '\0';
+    return (int) encoded;
+}
+
+static int serve_redirect(http_request *request, http_response *response, int client_fd) {
+    const route *target = request->route;
+    timing_mark(request->timing, PHASE_HANDLER_START);
+
+    // A prefix route redirecting to a directory keeps the rest of the path: /old/* -> /new/ sends /old/a to /new/a.
+    // The path was decoded by the parser, so it is encoded again. The query is kept as it was sent, but
+    // neither may put a CR or LF into the header
+    char rest[MAX_HEADER_SIZE] = "";
+    char query[MAX_HEADER_SIZE] = "";
+    size_t location_length = strlen(target->location);
+    const char *tail = "";
+    if (target->match == MATCH_PREFIX && location_length > 0 && target->location[location_length - 1] == '/') {
+        tail = request->path + strlen(target->pattern) - 1;
+        if (*tail == '/') tail++;
+    }
+    if (percent_encode(tail, strlen(tail), path_byte_plain, rest, sizeof(rest)) < 0 ||
+        (request->query.length > 0 &&
+         percent_encode(request->query.data, request->query.length, query_byte_plain, query, sizeof(query)) < 0)) {
+        LOG_ERROR("Redirect of %s does not fit in a response header", request->path);
+        response->status_code = 500;
+        return -1;
+    }
+
+    response->status_code = target->redirect_status;
+    char text[MAX_HEADER_SIZE];
+    int length = snprintf(text, sizeof(text),
+                          "HTTP/1.1 %d %s\r\n"
+                          "Date: %s\r\n"
+                          "Server: " SERVER_SOFTWARE "\r\n"
+                          "Connection: close\r\n"
+                          "%s%s%s"
+                          "Location: %s%s%s%s\r\n"
+                          "Content-Length: 0\r\n"
+                          "\r\n",
+                          target->redirect_status, get_reason_phrase(target->redirect_status),
+                          current_http_date(),
+                          target->cache_control ? "Cache-Control: " : "",
+                          target->cache_control ? target->cache_control : "",
+                          target->cache_control ? "\r\n" : "",
+                          target->location, rest, query[0] ? "?" : "", query);
+    if (length < 0 || (size_t) length >= sizeof(text)) {
+        LOG_ERROR("Redirect of %s does not fit in a response header", request->path);
+        response->status_code = 500;
+        return -1;
+    }
+    timer_refresh(request->deadline);
+    if (rio_unbuffered_write(client_fd, text, (size_t) length) < 0) {
+        return 0; // the status line may be out already, nothing else can be sent
+    }
+    timing_mark(request->timing, PHASE_FIRST_RESPONSE_BYTE);
+    return 0;
+}
+
+void send_status_response(int client_fd, request_timing *timing) {
+    char body[BUFFER_SIZE];
+    size_t body_length = metrics_render(body, sizeof(body));
+
+    http_response status_response;
+    initialize_response(&status_response);
+    status_response.content_type = strdup("text/plain");
+    status_response.cache_control = strdup("no-store");
+    status_response.content_length = body_length;
+
+    char *header = generate_response_header(&status_response);
+    if (header) {
+        struct iovec iov[2] = {
+            { header, strlen(header) },
+            { body, body_length },
+        };
+        if (rio_writev(client_fd, iov, 2) != -1) {
+            timing_mark(timing, PHASE_FIRST_RESPONSE_BYTE);
+        }
+        free(header);
+    }
+    if (timing) {
+        timing->status_code = status_response.status_code;
+    }
+
+    destroy_response(&status_response);
+}
+
 char* generate_response_header(http_response* response) {
     if (!response) {
         LOG_ERROR("NULL response passed to generate_response_header");
@@ -696,6 +1111,8 @@ char* generate_response_header(http_response* response) {
     // Add space for content-type
     if (response->content_type) 
         header_size += strlen(response->content_type) + 16; // "Content-Type: " + content
+    else if (response->mime)
+        header_size += response->mime->header_length;
     
     // Add space for other headers if they exist
     if (response->date) 
@@ -790,6 +1207,9 @@ char* generate_response_header(http_response* response) {
                 response->content_type);
         strcat(header, content_type_header);
     }
+    else if (response->mime) {
+        strcat(header, response->mime->header);
+    }
     
     // Always include Content-Length
     char content_length_header[64];
@@ -1,12 +1,21 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // splice
+#endif
 #include "rio.h"
 #include "utils.h"
 #include "logger.h"
+#include "probes.h"
 #include <unistd.h> // for read and write
+#include <fcntl.h>  // for splice
 #include <stdio.h>
 #include <errno.h>
 #include <limits.h>
 #include <string.h>
 
+#ifndef IOV_MAX
+#define IOV_MAX 1024 // Linux and macOS limit, not every libc exposes it without extensions
+#endif
+
 ssize_t rio_unbuffered_read(int fd, void * buf, size_t read_size) {
    if(read_size > SSIZE_MAX){
         LOG_ERROR("Cannot read more than %zd bytes at once", SSIZE_MAX);
@@ -23,6 +32,7 @@ ssize_t rio_unbuffered_read(int fd, void * buf, size_t read_size) {
         }
         else if(bytes_read == -1) {
             LOG_ERROR("Read failed on fd %d. Error: %s", fd, strerror(errno));
+            PROBE3(rio__read, fd, (size_t) total_bytes_read + read_size, -1);
             return -1;
         }
         else if(bytes_read == 0) {  // EOF
@@ -36,6 +46,7 @@ ssize_t rio_unbuffered_read(int fd, void * buf, size_t read_size) {
     }
 
     LOG_DEBUG("Completed unbuffered read from fd %d, total bytes read: %zu", fd, total_bytes_read);
+    PROBE3(rio__read, fd, (size_t) total_bytes_read + read_size, total_bytes_read);
     return total_bytes_read;
 }
 
@@ -55,6 +66,7 @@ ssize_t rio_unbuffered_write(int fd, void * buf, size_t write_size) {
         }
         else if(bytes_written == -1) { 
             LOG_ERROR("Write failed on fd %d. Error: %s", fd, strerror(errno));
+            PROBE3(rio__write, fd, (size_t) total_bytes_written + write_size, -1);
             return -1;
         }
         else if(bytes_written == 0) { 
@@ -67,9 +79,82 @@ ssize_t rio_unbuffered_write(int fd, void * buf, size_t write_size) {
         LOG_DEBUG("Wrote %zd bytes to fd %d, %zu bytes remaining", bytes_written, fd, write_size);
     }
     LOG_DEBUG("Completed unbuffered write to fd %d, total bytes written: %zu", fd, total_bytes_written);
+    PROBE3(rio__write, fd, (size_t) total_bytes_written + write_size, total_bytes_written);
+    return total_bytes_written;
+}
+
+ssize_t rio_writev(int fd, struct iovec * iov, int iovcnt) {
+    size_t write_size = 0;
+    for(int i = 0; i < iovcnt; ++i) {
+        write_size += iov[i].iov_len;
+    }
+    if(write_size > SSIZE_MAX){
+        LOG_ERROR("Cannot write more than %zd bytes at once", SSIZE_MAX);
+        return -1;
+    }
+    LOG_DEBUG("Starting vectored write to fd %d, requesting %zu bytes in %d buffers", fd, write_size, iovcnt);
+    ssize_t total_bytes_written = 0;
+    while(iovcnt > 0) {
+        // Empty entries would make a finished write look like a partial one
+        if(iov->iov_len == 0) {
+            iov++;
+            iovcnt--;
+            continue;
+        }
+        ssize_t bytes_written = writev(fd, iov, iovcnt < IOV_MAX ? iovcnt : IOV_MAX);
+        if(bytes_written == -1 && errno == EINTR) {
+            LOG_DEBUG("Write interrupted by signal, retrying");
+            continue;
+        }
+        else if(bytes_written == -1) {
+            LOG_ERROR("Write failed on fd %d. Error: %s", fd, strerror(errno));
+            PROBE3(rio__write, fd, write_size, -1);
+            return -1;
+        }
+        else if(bytes_written == 0) {
+            LOG_WARN("Zero bytes written to fd %d, possibly socket closed", fd);
+            break;
+        }
+        total_bytes_written += bytes_written;
+
+        // Skip the buffers that went out completely and move into the one that was cut off
+        size_t advance = (size_t) bytes_written;
+        while(iovcnt > 0 && advance >= iov->iov_len) {
+            advance -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if(advance > 0) {
+            iov->iov_base = (char *) iov->iov_base + advance;
+            iov->iov_len -= advance;
+        }
+        LOG_DEBUG("Wrote %zd bytes to fd %d, %zu bytes remaining", bytes_written, fd, write_size - (size_t) total_bytes_written);
+    }
+    LOG_DEBUG("Completed vectored write to fd %d, total bytes written: %zd", fd, total_bytes_written);
+    PROBE3(rio__write, fd, write_size, total_bytes_written);
     return total_bytes_written;
 }
 
+ssize_t rio_splice(int pipe_fd, int out_fd, size_t size) {
+#ifdef __linux__
+    ssize_t bytes_moved;
+    do {
+        bytes_moved = splice(pipe_fd, NULL, out_fd, NULL, size, SPLICE_F_MOVE | SPLICE_F_MORE);
+    } while(bytes_moved == -1 && errno == EINTR);
+    if(bytes_moved == -1 && errno != EINVAL) {
+        LOG_ERROR("Splice from fd %d to fd %d failed. Error: %s", pipe_fd, out_fd, strerror(errno));
+    }
+    PROBE3(rio__write, out_fd, size, bytes_moved);
+    return bytes_moved;
+#else
+    (void) pipe_fd;
+    (void) out_fd;
+    (void) size;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
 int rio_init_buffer(int fd, rio_buf *buf) {
     LOG_DEBUG("Initializing buffer structure for fd %d without reading data", fd);
     
@@ -94,6 +179,7 @@ ssize_t fill_buffer(rio_buf * buf) {
             LOG_ERROR("Failed to fill buffer for fd %d: %s", buf->fd, strerror(errno));
             buf->curr_buffer_size = 0;
             buf->pointer = 0;
+            PROBE2(rio__fill, buf->fd, -1);
             return -1;
         }
     }
@@ -104,6 +190,7 @@ ssize_t fill_buffer(rio_buf * buf) {
     buf->curr_buffer_size = bytes_read;
     buf->pointer = 0;
     LOG_DEBUG("Buffer filled for fd %d with %zd bytes", buf->fd, buf->curr_buffer_size);
+    PROBE2(rio__fill, buf->fd, buf->curr_buffer_size);
     return buf->curr_buffer_size;
 }
 
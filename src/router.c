@@ -0,0 +1,348 @@
+#include "router.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+
+#define PATH_ROOT 0      // trie of exact and prefix patterns
+#define EXTENSION_ROOT 1 // trie of extensions, lower case
+#define NO_ROUTE (-1)
+#define MAX_RULE_LENGTH 512
+
+static const char * const native_names[NATIVE_HANDLER_COUNT] = {
+    [NATIVE_STATUS] = "status",
+};
+
+/*
+Compiled form: node i's children are children[first_edge, first_edge + edge_count), reached by the
+bytes in labels at the same positions, sorted so a child is found with a binary search. Every node
+but the two roots is the target of exactly one edge.
+*/
+typedef struct {
+    uint32_t first_edge;
+    uint32_t edge_count;
+    int32_t exact;  // route of a key ending here, NO_ROUTE if none
+    int32_t prefix; // route of keys continuing past here (prefix patterns only), NO_ROUTE if none
+} trie_node;
+
+struct route_table {
+    route *routes;
+    size_t route_count;
+    size_t route_capacity;
+    trie_node *nodes;      // NULL until compiled
+    size_t node_count;
+    unsigned char *labels;
+    uint32_t *children;
+};
+
+// While compiling, children are kept as sorted sibling lists. Index 0 is a root, so 0 means none
+typedef struct {
+    uint32_t first_child;
+    uint32_t next_sibling;
+    int32_t exact;
+    int32_t prefix;
+    unsigned char byte;
+} build_node;
+
+typedef struct {
+    build_node *nodes;
+    size_t count;
+    size_t capacity;
+} trie_builder;
+
+route_table *router_create(void) {
+    route_table *table = calloc(1, sizeof(route_table));
+    if (!table) LOG_ERROR("Memory allocation failed for route table");
+    return table;
+}
+
+static void free_route(route *entry) {
+    free(entry->pattern);
+    free(entry->root);
+    free(entry->location);
+    free(entry->cache_control);
+}
+
+static void free_trie(route_table *table) {
+    free(table->nodes);
+    free(table->labels);
+    free(table->children);
+    table->nodes = NULL;
+    table->labels = NULL;
+    table->children = NULL;
+    table->node_count = 0;
+}
+
+void router_destroy(route_table *table) {
+    if (!table) return;
+    for (size_t i = 0; i < table->route_count; ++i) free_route(&table->routes[i]);
+    free(table->routes);
+    free_trie(table);
+    free(table);
+}
+
+size_t router_count(const route_table *table) {
+    return table ? table->route_count : 0;
+}
+
+// Returns a copy of directory that ends with '/'
+static char *directory_copy(const char *directory) {
+    size_t length = strlen(directory);
+    bool slash = length > 0 && directory[length - 1] == '/';
+    char *copy = malloc(length + (slash ? 1 : 2));
+    if (!copy) return NULL;
+    memcpy(copy, directory, length);
+    if (!slash) copy[length++] = '/';
+    copy[length] = '\0';
+    return copy;
+}
+
+// Works out how pattern matches, returns -1 if it is none of "/exact", "/prefix*" and "*.extension"
+static int pattern_match(const char *pattern, ROUTE_MATCH *match) {
+    size_t length = strlen(pattern);
+    if (length >= 3 && pattern[0] == '*' && pattern[1] == '.') {
+        if (strpbrk(pattern + 2, "/.*")) return -1;
+        *match = MATCH_EXTENSION;
+        return 0;
+    }
+    if (pattern[0] != '/') return -1;
+    char *star = strchr(pattern, '*');
+    if (star && star != pattern + length - 1) return -1;
+    *match = star ? MATCH_PREFIX : MATCH_EXACT;
+    return 0;
+}
+
+// Bytes of pattern that go into the trie
+static const char *pattern_key(const route *entry, size_t *length) {
+    *length = strlen(entry->pattern);
+    switch (entry->match) {
+        case MATCH_PREFIX: *length -= 1; return entry->pattern;
+        case MATCH_EXTENSION: *length -= 2; return entry->pattern + 2;
+        default: return entry->pattern;
+    }
+}
+
+static int parse_rule(route *entry, const char *rule) {
+    char words[MAX_RULE_LENGTH];
+    if (strlen(rule) >= sizeof(words)) return -1;
+    strcpy(words, rule);
+
+    char *saveptr = NULL;
+    char *action = strtok_r(words, " \t", &saveptr);
+    if (!action) return -1;
+    if (strcmp(action, "static") == 0) entry->action = ROUTE_STATIC;
+    else if (strcmp(action, "cgi") == 0) entry->action = ROUTE_CGI;
+    else if (strcmp(action, "native") == 0) entry->action = ROUTE_NATIVE;
+    else if (strcmp(action, "redirect") == 0) entry->action = ROUTE_REDIRECT;
+    else return -1;
+
+    bool has_target = false;
+    for (char *word = strtok_r(NULL, " \t", &saveptr); word; word = strtok_r(NULL, " \t", &saveptr)) {
+        if (strcmp(word, "compress") == 0) {
+            entry->compress = true;
+        } else if (strncmp(word, "cache=", 6) == 0 && word[6]) {
+            free(entry->cache_control);
+            entry->cache_control = strdup(word + 6);
+            if (!entry->cache_control) return -1;
+        } else if (entry->action == ROUTE_REDIRECT && has_target && isdigit((unsigned char) word[0])) {
+            entry->redirect_status = atoi(word);
+            if (entry->redirect_status != 301 && entry->redirect_status != 302 &&
+                entry->redirect_status != 307 && entry->redirect_status != 308) return -1;
+        } else if (!has_target && entry->action != ROUTE_NATIVE) {
+            if (entry->action == ROUTE_REDIRECT) entry->location = strdup(word);
+            else entry->root = directory_copy(word);
+            if (!entry->root && !entry->location) return -1;
+            has_target = true;
+        } else if (!has_target && entry->action == ROUTE_NATIVE) {
+            int handler = 0;
+            while (handler < NATIVE_HANDLER_COUNT && strcmp(native_names[handler], word) != 0) handler++;
+            if (handler == NATIVE_HANDLER_COUNT) return -1;
+            entry->native = (NATIVE_HANDLER) handler;
+            has_target = true;
+        } else {
+            return -1;
+        }
+    }
+    // A native route names its handler, a redirect its location
+    if (!has_target && (entry->action == ROUTE_NATIVE || entry->action == ROUTE_REDIRECT)) return -1;
+    return 0;
+}
+
+int router_add(route_table *table, const char *pattern, const char *rule) {
+    if (!table || !pattern || !rule) {
+        LOG_ERROR("NULL parameter passed to router_add");
+        return -1;
+    }
+    route entry = { .redirect_status = 301, .native = NATIVE_STATUS };
+    if (pattern_match(pattern, &entry.match) < 0) {
+        LOG_WARN("Invalid route pattern %s", pattern);
+        return -1;
+    }
+    if (parse_rule(&entry, rule) < 0) {
+        LOG_WARN("Invalid rule for route %s: %s", pattern, rule);
+        free_route(&entry);
+        return -1;
+    }
+    if (table->route_count == table->route_capacity) {
+        size_t capacity = table->route_capacity ? 2 * table->route_capacity : 16;
+        route *routes = realloc(table->routes, capacity * sizeof(route));
+        if (!routes) {
+            LOG_ERROR("Memory allocation failed for route %s", pattern);
+            free_route(&entry);
+            return -1;
+        }
+        table->routes = routes;
+        table->route_capacity = capacity;
+    }
+    entry.pattern = strdup(pattern);
+    if (!entry.pattern) {
+        free_route(&entry);
+        return -1;
+    }
+    table->routes[table->route_count++] = entry;
+    return 0;
+}
+
+// Appends a node, returns its index or 0 if allocation fails
+static uint32_t builder_node(trie_builder *builder, unsigned char byte) {
+    if (builder->count == builder->capacity) {
+        size_t capacity = builder->capacity ? 2 * builder->capacity : 64;
+        build_node *nodes = realloc(builder->nodes, capacity * sizeof(build_node));
+        if (!nodes) return 0;
+        builder->nodes = nodes;
+        builder->capacity = capacity;
+    }
+    builder->nodes[builder->count] = (build_node){ 0, 0, NO_ROUTE, NO_ROUTE, byte };
+    return (uint32_t) builder->count++;
+}
+
+// Walks key down from root, adding the missing nodes. Returns the node key ends at, 0 if allocation fails
+static uint32_t builder_insert(trie_builder *builder, uint32_t root, const char *key, size_t length, bool fold_case) {
+    uint32_t node = root;
+    for (size_t i = 0; i < length; ++i) {
+        unsigned char byte = (unsigned char) key[i];
+        if (fold_case) byte = (unsigned char) tolower(byte);
+        uint32_t previous = 0;
+        uint32_t child = builder->nodes[node].first_child;
+        while (child && builder->nodes[child].byte < byte) {
+            previous = child;
+            child = builder->nodes[child].next_sibling;
+        }
+        if (!child || builder->nodes[child].byte != byte) {
+            uint32_t added = builder_node(builder, byte);
+            if (!added) return 0;
+            // Indices stay valid across the realloc in builder_node, pointers would not
+            builder->nodes[added].next_sibling = child;
+            if (previous) builder->nodes[previous].next_sibling = added;
+            else builder->nodes[node].first_child = added;
+            child = added;
+        }
+        node = child;
+    }
+    return node;
+}
+
+int router_compile(route_table *table) {
+    if (!table) return -1;
+    free_trie(table);
+
+    trie_builder builder = { NULL, 0, 0 };
+    if (builder_node(&builder, 0) != PATH_ROOT || builder_node(&builder, 0) != EXTENSION_ROOT) {
+        free(builder.nodes);
+        LOG_ERROR("Memory allocation failed for route trie");
+        return -1;
+    }
+    for (size_t i = 0; i < table->route_count; ++i) {
+        const route *entry = &table->routes[i];
+        size_t length;
+        const char *key = pattern_key(entry, &length);
+        bool extension = entry->match == MATCH_EXTENSION;
+        uint32_t node = builder_insert(&builder, extension ? EXTENSION_ROOT : PATH_ROOT, key, length, extension);
+        if (!node && length > 0) {
+            free(builder.nodes);
+            LOG_ERROR("Memory allocation failed for route trie");
+            return -1;
+        }
+        int32_t *slot = entry->match == MATCH_PREFIX ? &builder.nodes[node].prefix : &builder.nodes[node].exact;
+        if (*slot == NO_ROUTE) {
+            *slot = (int32_t) i;
+        } else {
+            LOG_WARN("Route %s is listed more than once, the first rule is used", entry->pattern);
+        }
+    }
+
+    table->nodes = malloc(builder.count * sizeof(trie_node));
+    table->labels = malloc(builder.count);
+    table->children = malloc(builder.count * sizeof(uint32_t));
+    if (!table->nodes || !table->labels || !table->children) {
+        free(builder.nodes);
+        free_trie(table);
+        LOG_ERROR("Memory allocation failed for route trie");
+        return -1;
+    }
+    uint32_t edge = 0;
+    for (size_t i = 0; i < builder.count; ++i) {
+        trie_node *node = &table->nodes[i];
+        node->first_edge = edge;
+        node->exact = builder.nodes[i].exact;
+        node->prefix = builder.nodes[i].prefix;
+        for (uint32_t child = builder.nodes[i].first_child; child; child = builder.nodes[child].next_sibling) {
+            table->labels[edge] = builder.nodes[child].byte;
+            table->children[edge] = child;
+            edge++;
+        }
+        node->edge_count = edge - node->first_edge;
+    }
+    table->node_count = builder.count;
+    free(builder.nodes);
+    LOG_INFO("Compiled %zu routes into %zu trie nodes", table->route_count, table->node_count);
+    return 0;
+}
+
+// Returns the child of node reached by byte, 0 if there is none
+static uint32_t trie_child(const route_table *table, const trie_node *node, unsigned char byte) {
+    uint32_t low = node->first_edge;
+    uint32_t high = node->first_edge + node->edge_count;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        if (table->labels[middle] < byte) low = middle + 1;
+        else if (table->labels[middle] > byte) high = middle;
+        else return table->children[middle];
+    }
+    return 0;
+}
+
+const route *router_match(const route_table *table, const char *path) {
+    if (!table || !table->nodes || !path) return NULL;
+
+    // One walk finds the exact route and the longest prefix route
+    int32_t prefix = NO_ROUTE;
+    const trie_node *node = &table->nodes[PATH_ROOT];
+    const char *p = path;
+    for (;;) {
+        if (node->prefix != NO_ROUTE) prefix = node->prefix;
+        if (!*p) break;
+        uint32_t child = trie_child(table, node, (unsigned char) *p);
+        if (!child) break;
+        node = &table->nodes[child];
+        p++;
+    }
+    if (!*p && node->exact != NO_ROUTE) return &table->routes[node->exact];
+
+    // The extension is the part of the last path segment after its last dot
+    const char *segment = strrchr(path, '/');
+    const char *dot = strrchr(segment ? segment : path, '.');
+    if (dot && dot[1]) {
+        node = &table->nodes[EXTENSION_ROOT];
+        for (p = dot + 1; *p; ++p) {
+            uint32_t child = trie_child(table, node, (unsigned char) tolower((unsigned char) *p));
+            if (!child) break;
+            node = &table->nodes[child];
+        }
+        if (!*p && node->exact != NO_ROUTE) return &table->routes[node->exact];
+    }
+
+    return prefix != NO_ROUTE ? &table->routes[prefix] : NULL;
+}
@@ -0,0 +1,272 @@
+#include "scan.h"
+#include <string.h>
+#include <stdbool.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+typedef struct {
+    const char *name;
+    const char *(*find_either)(const char *start, const char *end, char a, char b);
+    const char *(*find_pair)(const char *start, const char *end, char first, char second);
+} scan_kernels;
+
+/* ---------- scalar ---------- */
+
+// Bytes one memchr call covers when two different bytes are searched, a match of either one ends the search
+#define SCALAR_EITHER_CHUNK 256
+
+/*
+libc's memchr is vectorized on every platform that matters and beats a byte loop by an order of
+magnitude, so the scalar kernels are built on it
+*/
+static const char *scalar_find_either(const char *p, const char *end, char a, char b) {
+    if (a == b) {
+        const char *found = memchr(p, a, (size_t) (end - p));
+        return found ? found : end;
+    }
+    // Searching for a over the whole range first could pass over many bs, chunks bound the extra work
+    while (p < end) {
+        const char *chunk_end = end - p > SCALAR_EITHER_CHUNK ? p + SCALAR_EITHER_CHUNK : end;
+        const char *found = memchr(p, a, (size_t) (chunk_end - p));
+        const char *limit = found ? found : chunk_end;
+        const char *other = memchr(p, b, (size_t) (limit - p));
+        if (other) return other;
+        if (found) return found;
+        p = chunk_end;
+    }
+    return end;
+}
+
+static const char *scalar_find_pair(const char *p, const char *end, char first, char second) {
+    while (end - p >= 2) {
+        const char *candidate = memchr(p, first, (size_t) (end - p - 1));
+        if (!candidate) break;
+        if (candidate[1] == second) return candidate;
+        p = candidate + 1;
+    }
+    return end;
+}
+
+#ifdef SCAN_X86
+
+// Byte loops for inputs shorter than one block, where a call into memchr costs more than it saves
+static inline const char *short_find_either(const char *p, const char *end, char a, char b) {
+    for (; p < end; ++p) {
+        if (*p == a || *p == b) return p;
+    }
+    return end;
+}
+
+static inline const char *short_find_pair(const char *p, const char *end, char first, char second) {
+    for (; end - p >= 2; ++p) {
+        if (p[0] == first && p[1] == second) return p;
+    }
+    return end;
+}
+
+// Returns the first candidate in mask (bit i = block[i] matched first) followed by second, NULL if none is
+static inline const char *verify_pair(const char *block, unsigned int mask, const char *end, char second) {
+    for (; mask; mask &= mask - 1) {
+        const char *candidate = block + __builtin_ctz(mask);
+        if (candidate + 1 < end && candidate[1] == second) return candidate;
+    }
+    return NULL;
+}
+
+/*
+The vector kernels search whole blocks and finish with one more block ending exactly at end, with the
+bytes already searched masked off, so they never read outside [start, end). Inputs shorter than one
+block go to the next narrower kernel.
+
+They only search the first VECTOR_PREFIX bytes themselves, about the headers of a browser request.
+Inlined, they beat a memchr call on those short, match-dense spans (a pair search through memchr
+stops at every first byte), but libc's unrolled memchr is faster on long runs without a match, like
+a cookie of a few KB. The rest of a longer input goes to the memchr based scalar kernels.
+*/
+#define VECTOR_PREFIX 1024
+
+/* ---------- SSE2 (baseline on x86-64) ---------- */
+
+static inline unsigned int sse2_either_mask(const char *block, __m128i va, __m128i vb) {
+    __m128i v = _mm_loadu_si128((const __m128i *)block);
+    return (unsigned int)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)));
+}
+
+static inline const char *sse2_span_either(const char *p, const char *end, char a, char b) {
+    if (end - p < 16) return short_find_either(p, end, a, b);
+    __m128i va = _mm_set1_epi8(a), vb = _mm_set1_epi8(b);
+    for (; end - p >= 16; p += 16) {
+        unsigned int mask = sse2_either_mask(p, va, vb);
+        if (mask) return p + __builtin_ctz(mask);
+    }
+    if (p == end) return end;
+    const char *last = end - 16;
+    unsigned int mask = sse2_either_mask(last, va, vb) & (~0u << (p - last));
+    return mask ? last + __builtin_ctz(mask) : end;
+}
+
+// Only the first byte is compared, its matches are checked for the second one
+static inline const char *sse2_span_pair(const char *p, const char *end, char first, char second) {
+    if (end - p < 16) return short_find_pair(p, end, first, second);
+    __m128i vfirst = _mm_set1_epi8(first);
+    const char *found;
+    for (; end - p >= 16; p += 16) {
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)p), vfirst));
+        if (mask && (found = verify_pair(p, mask, end, second))) return found;
+    }
+    if (p == end) return end;
+    const char *last = end - 16;
+    unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)last), vfirst));
+    found = verify_pair(last, mask & (~0u << (p - last)), end, second);
+    return found ? found : end;
+}
+
+/*
+---------- AVX2 (compiled for it per function, only called when the CPU has it) ----------
+
+The SSE2 kernels are inlined for short inputs so they are VEX encoded too, calling the legacy encoded
+copies with the upper halves of the registers dirty costs a state transition per call.
+*/
+
+__attribute__((target("avx2")))
+static inline unsigned int avx2_either_mask(const char *block, __m256i va, __m256i vb) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)block);
+    return (unsigned int)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, va), _mm256_cmpeq_epi8(v, vb)));
+}
+
+__attribute__((target("avx2")))
+static const char *avx2_span_either(const char *p, const char *end, char a, char b) {
+    if (end - p < 32) return sse2_span_either(p, end, a, b);
+    __m256i va = _mm256_set1_epi8(a), vb = _mm256_set1_epi8(b);
+    for (; end - p >= 32; p += 32) {
+        unsigned int mask = avx2_either_mask(p, va, vb);
+        if (mask) return p + __builtin_ctz(mask);
+    }
+    if (p == end) return end;
+    const char *last = end - 32;
+    unsigned int mask = avx2_either_mask(last, va, vb) & (~0u << (p - last));
+    return mask ? last + __builtin_ctz(mask) : end;
+}
+
+__attribute__((target("avx2")))
+static const char *avx2_span_pair(const char *p, const char *end, char first, char second) {
+    if (end - p < 32) return sse2_span_pair(p, end, first, second);
+    __m256i vfirst = _mm256_set1_epi8(first);
+    const char *found;
+    for (; end - p >= 32; p += 32) {
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)p), vfirst));
+        if (mask && (found = verify_pair(p, mask, end, second))) return found;
+    }
+    if (p == end) return end;
+    const char *last = end - 32;
+    unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)last), vfirst));
+    found = verify_pair(last, mask & (~0u << (p - last)), end, second);
+    return found ? found : end;
+}
+
+static const char *sse2_find_either(const char *p, const char *end, char a, char b) {
+    if (end - p <= VECTOR_PREFIX) return sse2_span_either(p, end, a, b);
+    const char *found = sse2_span_either(p, p + VECTOR_PREFIX, a, b);
+    return found != p + VECTOR_PREFIX ? found : scalar_find_either(found, end, a, b);
+}
+
+// A pair may start on the last byte of the prefix
+static const char *sse2_find_pair(const char *p, const char *end, char first, char second) {
+    if (end - p <= VECTOR_PREFIX) return sse2_span_pair(p, end, first, second);
+    const char *found = sse2_span_pair(p, p + VECTOR_PREFIX, first, second);
+    return found != p + VECTOR_PREFIX ? found : scalar_find_pair(found - 1, end, first, second);
+}
+
+__attribute__((target("avx2")))
+static const char *avx2_find_either(const char *p, const char *end, char a, char b) {
+    if (end - p <= VECTOR_PREFIX) return avx2_span_either(p, end, a, b);
+    const char *found = avx2_span_either(p, p + VECTOR_PREFIX, a, b);
+    return found != p + VECTOR_PREFIX ? found : scalar_find_either(found, end, a, b);
+}
+
+__attribute__((target("avx2")))
+static const char *avx2_find_pair(const char *p, const char *end, char first, char second) {
+    if (end - p <= VECTOR_PREFIX) return avx2_span_pair(p, end, first, second);
+    const char *found = avx2_span_pair(p, p + VECTOR_PREFIX, first, second);
+    return found != p + VECTOR_PREFIX ? found : scalar_find_pair(found - 1, end, first, second);
+}
+
+#endif
+
+static const scan_kernels kernel_table[] = {
+#ifdef SCAN_X86
+    { "avx2", avx2_find_either, avx2_find_pair },
+    { "sse2", sse2_find_either, sse2_find_pair },
+#endif
+    { "scalar", scalar_find_either, scalar_find_pair },
+};
+#define KERNEL_COUNT (sizeof(kernel_table) / sizeof(kernel_table[0]))
+
+static bool kernel_supported(const scan_kernels *kernels) {
+#ifdef SCAN_X86
+    if (strcmp(kernels->name, "avx2") == 0) {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    }
+#endif
+    (void) kernels;
+    return true;
+}
+
+// Kernels in use, NULL until the first search picks the widest supported ones
+static const scan_kernels *active_kernels = NULL;
+
+static const scan_kernels *kernels(void) {
+    const scan_kernels *current = __atomic_load_n(&active_kernels, __ATOMIC_ACQUIRE);
+    if (current) return current;
+    // Racing threads detect the same kernels, whichever store lands last is as good as the first
+    for (size_t i = 0; i < KERNEL_COUNT; ++i) {
+        if (kernel_supported(&kernel_table[i])) {
+            current = &kernel_table[i];
+            break;
+        }
+    }
+    __atomic_store_n(&active_kernels, current, __ATOMIC_RELEASE);
+    return current;
+}
+
+const char *scan_find_either(const char *start, const char *end, char a, char b) {
+    return kernels()->find_either(start, end, a, b);
+}
+
+const char *scan_find_pair(const char *start, const char *end, char first, char second) {
+    return kernels()->find_pair(start, end, first, second);
+}
+
+const char *scan_header_end(const char *start, const char *end) {
+    if (end - start < 4) return end;
+    // "\n\r" appears only where a line is empty, so unlike "\r\n" it does not match on every line
+    const scan_kernels *current = kernels();
+    const char *p = start + 1;
+    while ((p = current->find_pair(p, end, '\n', '\r')) != end) {
+        if (p[-1] == '\r' && end - p >= 3 && p[2] == '\n') return p - 1;
+        p += 1;
+    }
+    return end;
+}
+
+const char *scan_kernel_name(void) {
+    return kernels()->name;
+}
+
+int scan_select_kernel(const char *name) {
+    if (!name) {
+        __atomic_store_n(&active_kernels, NULL, __ATOMIC_RELEASE);
+        return 0;
+    }
+    for (size_t i = 0; i < KERNEL_COUNT; ++i) {
+        if (strcmp(kernel_table[i].name, name) == 0 && kernel_supported(&kernel_table[i])) {
+            __atomic_store_n(&active_kernels, &kernel_table[i], __ATOMIC_RELEASE);
+            return 0;
+        }
+    }
+    return -1;
+}
@@ -1,14 +1,29 @@
 /*
+Add -DENABLE_USDT to compile in the tracepoints from include/probes.h
 clang -std=c99 -Wall -Wextra -Werror -g -O0 -I./include \
-  src/server.c src/net.c src/rio.c src/http_parser.c src/request_handler.c src/config.c \
+  src/server.c src/net.c src/rio.c src/http_parser.c src/request_handler.c src/config.c src/metrics.c src/uring_engine.c src/thread_pool.c src/timer_wheel.c src/admission.c src/handoff.c src/logger.c src/affinity.c src/scan.c src/mime.c src/mime_table.c src/router.c src/path_cache.c \
   -pthread -lm -o executables/server
 */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // accept4
+#endif
 #include "net.h"
 #include "rio.h"
 #include "http_parser.h"
 #include "request_handler.h"
 #include "logger.h"
 #include "config.h"
+#include "metrics.h"
+#include "probes.h"
+#include "uring_engine.h"
+#include "thread_pool.h"
+#include "timer_wheel.h"
+#include "admission.h"
+#include "handoff.h"
+#include "affinity.h"
+#include "scan.h"
+#include "mime.h"
+#include "path_cache.h"
 #include <stdio.h>
 #include <sys/socket.h>
 #include <errno.h>
@@ -18,49 +33,80 @@ clang -std=c99 -Wall -Wextra -Werror -g -O0 -I./include \
 #include <netinet/in.h>
 #include <stdlib.h>
 #include <signal.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <time.h>
+
+// How long an idle accept loop waits before checking server_running again
+#define ACCEPT_POLL_TIMEOUT_MS 500
+// How often a drain checks whether connections are left
+#define DRAIN_POLL_INTERVAL_MS 50
+
+// Advances the deadlines of every connection. NULL if the timer thread could not be started
+static timer_wheel *connection_timers = NULL;
 
 /**
- * Send a simple HTTP error response to the client
+ * Stage a connection is in, decides which timeout applies and how an expiry is enforced
  */
-void send_error_response(int client_fd, int status_code, const char *reason, const char *message) {
-    http_response error_response;
-    initialize_response(&error_response);
-    
-    error_response.status_code = status_code;
-    free(error_response.reason);
-    error_response.reason = strdup(reason);
-    
-    // Create simple HTML error page
-    char error_body[512];
-    snprintf(error_body, sizeof(error_body),
-        "<html><head><title>%d %s</title></head>"
-        "<body><h1>%d %s</h1><p>%s</p></body></html>",
-        status_code, reason, status_code, reason, message);
-    
-    error_response.content_type = strdup("text/html");
-    error_response.content_length = strlen(error_body);
-    
-    // Generate and send header
-    char *header = generate_response_header(&error_response);
-    if (header) {
-        rio_unbuffered_write(client_fd, header, strlen(header));
-        free(header);
-    }
-    
-    // Send body
-    rio_unbuffered_write(client_fd, error_body, strlen(error_body));
-    
-    destroy_response(&error_response);
+typedef enum {
+    DEADLINE_IDLE,    // waiting for the first byte of a request (KeepAliveTimeout)
+    DEADLINE_HEADER,  // reading the rest of the request headers (HeaderTimeout)
+    DEADLINE_SEND     // handling the request and writing the response (SendTimeout)
+} deadline_stage;
+
+typedef struct {
+    timer_entry timer;
+    int client_fd;
+    deadline_stage stage;
+    int expired;
+} connection_deadline;
+
+/**
+ * Timer callback. Expiries while reading shut down only the read side, so the blocked read returns
+ * and a 408 can still be sent. A stalled send shuts down both directions
+ */
+static void expire_connection(timer_entry *timer) {
+    connection_deadline *deadline = (connection_deadline *)timer->arg;
+    deadline_stage stage = __atomic_load_n(&deadline->stage, __ATOMIC_RELAXED);
+    __atomic_store_n(&deadline->expired, 1, __ATOMIC_RELEASE);
+    LOG_WARN("Connection fd=%d timed out while %s", deadline->client_fd,
+             stage == DEADLINE_IDLE ? "idle" : stage == DEADLINE_HEADER ? "reading headers" : "sending");
+    shutdown(deadline->client_fd, stage == DEADLINE_SEND ? SHUT_RDWR : SHUT_RD);
+}
+
+/**
+ * Moves the connection to stage and restarts its deadline with the matching timeout
+ */
+static void arm_deadline(connection_deadline *deadline, deadline_stage stage, server_config *config) {
+    if (!deadline) return;
+    unsigned int seconds = stage == DEADLINE_IDLE ? config->keepalive_timeout :
+                           stage == DEADLINE_HEADER ? config->header_timeout : config->send_timeout;
+    __atomic_store_n(&deadline->stage, stage, __ATOMIC_RELAXED);
+    timer_arm(&deadline->timer, seconds * 1000);
 }
 
 /**
  * Read complete HTTP request from client socket
+ * Marks PHASE_FIRST_BYTE and PHASE_HEADERS_DONE on timing (may be NULL) and switches deadline
+ * (may be NULL) from the idle to the header timeout once the first bytes arrive
  * Returns 0 on success, -1 on error
  */
-int read_http_request(int client_fd, char *request_buffer, size_t buffer_size) {
+int read_http_request(int client_fd, char *request_buffer, size_t buffer_size, server_config *config,
+                      request_timing *timing, connection_deadline *deadline) {
     rio_buf rio_buf;
     rio_init_buffer(client_fd, &rio_buf);
     
+    // Fill the buffer up front so the arrival of the first bytes can be timed separately from the rest of the headers
+    if (fill_buffer(&rio_buf) <= 0) {
+        LOG_ERROR("Failed to read HTTP request line");
+        return -1;
+    }
+    timing_mark(timing, PHASE_FIRST_BYTE);
+    arm_deadline(deadline, DEADLINE_HEADER, config);
+    
     size_t total_read = 0;
     char line[BUFFER_SIZE];
     
@@ -83,18 +129,20 @@ int read_http_request(int client_fd, char *request_buffer, size_t buffer_size) {
         memcpy(request_buffer + total_read, line, line_length);
         total_read += line_length;
         
-        // Check if we've reached the end of headers (\r\n\r\n)
-        if (total_read >= 4) {
-            if (strstr(request_buffer, "\r\n\r\n")) {
-                request_buffer[total_read] = '\0';
-                LOG_DEBUG("Complete HTTP request read (%zu bytes)", total_read);
-                return 0;
-            }
+        // Check if we've reached the end of headers (\r\n\r\n). Only the new line, together with the
+        // 3 bytes before it, can complete it
+        size_t scan_from = total_read - (size_t)line_length > 3 ? total_read - (size_t)line_length - 3 : 0;
+        if (scan_header_end(request_buffer + scan_from, request_buffer + total_read) != request_buffer + total_read) {
+            request_buffer[total_read] = '\0';
+            timing_mark(timing, PHASE_HEADERS_DONE);
+            LOG_DEBUG("Complete HTTP request read (%zu bytes)", total_read);
+            return 0;
         }
         
         // Safety check: if we read just \r\n, this might be the end
         if (line_length == 2 && line[0] == '\r' && line[1] == '\n') {
             request_buffer[total_read] = '\0';
+            timing_mark(timing, PHASE_HEADERS_DONE);
             LOG_DEBUG("Complete HTTP request read (%zu bytes)", total_read);
             return 0;
         }
@@ -104,35 +152,61 @@ int read_http_request(int client_fd, char *request_buffer, size_t buffer_size) {
     return -1;
 }
 
+/**
+ * Mark the end of a request and report it to the metrics module and tracepoints
+ */
+static void finish_request(int client_fd, const char *path, server_config *config, request_timing *timing) {
+    timing_mark(timing, PHASE_LAST_BYTE);
+    metrics_record_request(timing, path, config);
+    PROBE4(request__done, client_fd, path, timing->status_code, timing_offset_ns(timing, PHASE_LAST_BYTE));
+    (void) client_fd; // only used by the tracepoint
+}
+
 /**
  * Handle a single client connection
+ * timing must already have PHASE_ACCEPT marked. The remaining phases are marked here and the
+ * finished request is reported to the metrics module. deadline (may be NULL) must be armed with
+ * the idle timeout
  */
-void handle_client(int client_fd, server_config *config) {
+void handle_client(int client_fd, server_config *config, request_timing *timing, connection_deadline *deadline) {
     char request_buffer[BUFFER_SIZE * 4]; // 32KB buffer for HTTP request
     
     LOG_INFO("Handling client request on fd %d", client_fd);
+    PROBE1(request__start, client_fd);
     
     // Read the complete HTTP request
-    if (read_http_request(client_fd, request_buffer, sizeof(request_buffer)) < 0) {
-        LOG_ERROR("Failed to read HTTP request from client");
-        send_error_response(client_fd, 400, "Bad Request", 
-                          "Malformed HTTP request or request too large");
+    if (read_http_request(client_fd, request_buffer, sizeof(request_buffer), config, timing, deadline) < 0) {
+        arm_deadline(deadline, DEADLINE_SEND, config);
+        if (deadline && __atomic_load_n(&deadline->expired, __ATOMIC_ACQUIRE)) {
+            send_error_response(client_fd, 408);
+            timing->status_code = 408;
+        } else {
+            LOG_ERROR("Failed to read HTTP request from client");
+            send_error_response(client_fd, 400);
+            timing->status_code = 400;
+        }
+        finish_request(client_fd, NULL, config, timing);
         return;
     }
+    arm_deadline(deadline, DEADLINE_SEND, config);
     
     LOG_DEBUG("Raw HTTP request: %.200s...", request_buffer);
     
     // Initialize request structure
     http_request request;
     initialize_request(&request);
+    request.timing = timing;
+    request.deadline = deadline ? &deadline->timer : NULL;
     
     // Parse the HTTP request
     http_request *parsed_request = parse_http_request(request_buffer, &request, config);
+    timing_mark(timing, PHASE_PARSE_DONE);
     
     if (parsed_request == NULL) {
         LOG_ERROR("Failed to parse HTTP request");
-        send_error_response(client_fd, 400, "Bad Request", 
-                          "Invalid HTTP request format");
+        send_error_response(client_fd, 400);
+        timing->status_code = 400;
+        finish_request(client_fd, NULL, config, timing);
         destroy_request(&request);
         return;
     }
@@ -141,7 +215,7 @@ void handle_client(int client_fd, server_config *config) {
              request.method == GET ? "GET" : "UNKNOWN",
              request.path ? request.path : "NULL");
     
-    // Execute the request
+    // Execute the request, its route picks the handler (the status page is a native route)
     int execution_result = execute_request(parsed_request, client_fd, config);
     
     if (execution_result < 0) {
@@ -151,137 +225,626 @@ void handle_client(int client_fd, server_config *config) {
         LOG_INFO("Request executed successfully");
     }
     
+    finish_request(client_fd, request.path, config, timing);
+    
     // Cleanup
     destroy_request(&request);
 }
 
 /**
- * Signal handler for graceful shutdown
+ * Signal handler. SIGINT/SIGTERM stop accepting and drain, SIGUSR2 asks for a binary upgrade and
+ * SIGHUP for a configuration reload
  */
 volatile sig_atomic_t server_running = 1;
+static volatile sig_atomic_t upgrade_requested = 0;
+static volatile sig_atomic_t reload_requested = 0;
 
 void signal_handler(int sig) {
-    (void)sig; // Suppress unused parameter warning
+    if (sig == SIGUSR2) {
+        upgrade_requested = 1;
+        return;
+    }
+    if (sig == SIGHUP) {
+        reload_requested = 1;
+        return;
+    }
     LOG_INFO("Received shutdown signal, stopping server...");
     server_running = 0;
 }
 
+/**
+ * Block the control signals on the calling thread, saving the old mask in previous_mask. Threads
+ * started meanwhile inherit the mask, which leaves the signals to the main thread
+ */
+static void block_control_signals(sigset_t *previous_mask) {
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGUSR2);
+    sigaddset(&signals, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &signals, previous_mask);
+}
+
+/**
+ * Log the peer of a freshly accepted connection, handle its request and close it. Releases config,
+ * the snapshot acquired for the connection
+ */
+static void serve_connection(int client_fd, struct sockaddr_storage *client_addr, socklen_t addr_len,
+                             server_config *config, request_timing *timing) {
+    // Get client address information
+    char client_ip[INET6_ADDRSTRLEN];
+    char client_port[MAX_PORT_STRLEN];
+    
+    int gni_result = getnameinfo(
+        (struct sockaddr *)client_addr, addr_len,
+        client_ip, sizeof(client_ip),
+        client_port, sizeof(client_port),
+        NI_NUMERICHOST | NI_NUMERICSERV
+    );
+    
+    if (gni_result == 0) {
+        LOG_INFO("Connection accepted from %s:%s (fd=%d)", client_ip, client_port, client_fd);
+    } else {
+        LOG_INFO("Connection accepted from unknown client (fd=%d)", client_fd);
+        LOG_WARN("getnameinfo failed: %s", gai_strerror(gni_result));
+    }
+    
+    connection_deadline deadline = { .client_fd = client_fd, .stage = DEADLINE_IDLE, .expired = 0 };
+    timer_init(&deadline.timer, connection_timers, expire_connection, &deadline);
+    arm_deadline(&deadline, DEADLINE_IDLE, config);
+    
+    handle_client(client_fd, config, timing, &deadline);
+    
+    // The timer must not fire once the descriptor is closed and possibly reused
+    timer_disarm(&deadline.timer);
+    
+    // Close client connection
+    if (close(client_fd) < 0) {
+        LOG_ERROR("Failed to close client connection (fd=%d): %s", client_fd, strerror(errno));
+    } else {
+        LOG_INFO("Client connection closed (fd=%d)", client_fd);
+    }
+    admission_connection_closed();
+    config_snapshot_release(config);
+}
+
+/**
+ * An accepted connection waiting in the thread pool for a worker
+ */
+typedef struct {
+    int fd;
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    request_timing timing;
+    server_config *config;
+} pending_connection;
+
+static void pool_serve_connection(void *item) {
+    pending_connection *conn = (pending_connection *)item;
+    // Shed before reading anything if the connection waited in the queue for too long
+    if (admission_should_shed(&conn->timing)) {
+        LOG_WARN("Shedding connection fd=%d after %" PRIu64 "us in the queue", conn->fd,
+                 timing_offset_ns(&conn->timing, PHASE_ACCEPT) / 1000);
+        if (send_overload_response(conn->fd) > 0) {
+            conn->timing.status_code = 503;
+        }
+        finish_request(conn->fd, NULL, conn->config, &conn->timing);
+        close(conn->fd);
+        admission_connection_closed();
+        config_snapshot_release(conn->config);
+        free(conn);
+        return;
+    }
+    serve_connection(conn->fd, &conn->addr, conn->addr_len, conn->config, &conn->timing);
+    free(conn);
+}
+
+/**
+ * Hand an accepted connection to the thread pool. Returns 0 on success, -1 if it must be served inline
+ */
+static int dispatch_connection(thread_pool *pool, int client_fd, struct sockaddr_storage *client_addr,
+                               socklen_t addr_len, server_config *config, request_timing *timing) {
+    pending_connection *conn = malloc(sizeof(pending_connection));
+    if (!conn) {
+        return -1;
+    }
+    conn->fd = client_fd;
+    memcpy(&conn->addr, client_addr, addr_len);
+    conn->addr_len = addr_len;
+    conn->timing = *timing;
+    conn->config = config;
+    if (thread_pool_submit(pool, conn) < 0) {
+        free(conn);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Accept connections on listen_fd until server_running is cleared. Connections are handed to pool,
+ * or served one at a time on this thread if pool is NULL (or all of its queues are full)
+ */
+static void accept_loop(int listen_fd, thread_pool *pool) {
+    // Spare descriptor given up on EMFILE/ENFILE so the pending connection can be accepted and closed
+    // instead of staying in the backlog and making accept() fail in a loop
+    int reserve_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    
+    while (server_running) {
+        struct sockaddr_storage client_addr;
+        socklen_t addr_len = sizeof(client_addr);
+        
+        // Accept incoming connection. Close-on-exec, CGI children of other connections must not keep it open
+        int client_fd = accept4(listen_fd, (struct sockaddr *)&client_addr, &addr_len, SOCK_CLOEXEC);
+        request_timing timing;
+        timing_init(&timing);
+        timing_mark(&timing, PHASE_ACCEPT);
+        
+        if (client_fd < 0) {
+            if (!server_running) {
+                LOG_INFO("Stopped accepting connections on fd %d", listen_fd);
+                break;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // The listener is non-blocking so this loop notices server_running without the socket
+                // being shut down, which would also break it for a successor sharing it
+                struct pollfd readable = { .fd = listen_fd, .events = POLLIN };
+                poll(&readable, 1, ACCEPT_POLL_TIMEOUT_MS);
+                continue;
+            }
+            if (errno == EINTR || errno == ECONNABORTED) {
+                // Otherwise just retry accept
+                continue;
+            }
+            if ((errno == EMFILE || errno == ENFILE) && reserve_fd >= 0) {
+                LOG_WARN("Out of file descriptors, dropping a pending connection");
+                close(reserve_fd);
+                int dropped_fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+                if (dropped_fd >= 0) {
+                    close(dropped_fd);
+                    admission_record_fd_limit_drop();
+                }
+                reserve_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+                continue;
+            }
+            LOG_ERROR("Failed to accept connection: %s", strerror(errno));
+            continue;
+        }
+        
+#ifndef __linux__
+        // BSD derived systems let accepted sockets inherit O_NONBLOCK from the listener
+        fcntl(client_fd, F_SETFL, fcntl(client_fd, F_GETFL) & ~O_NONBLOCK);
+#endif
+        
+        // A connection accepted while stopping is still served, the drain waits for it
+        // Past the high watermark, closing right away is the cheapest way to say no
+        if (!admission_connection_opened()) {
+            LOG_WARN("Too many open connections, closing fd %d", client_fd);
+            close(client_fd);
+            continue;
+        }
+        
+        // The connection keeps the configuration current at accept even if a reload happens meanwhile
+        server_config *config = config_snapshot_acquire();
+        if (pool && dispatch_connection(pool, client_fd, &client_addr, addr_len, config, &timing) == 0) {
+            continue;
+        }
+        serve_connection(client_fd, &client_addr, addr_len, config, &timing);
+    }
+    
+    if (reserve_fd >= 0) {
+        close(reserve_fd);
+    }
+}
+
+/**
+ * Serve connections on listen_fd with the configured I/O engine until server_running is cleared.
+ * The blocking engine hands connections to pool if it is not NULL
+ */
+static void serve_listener(int listen_fd, server_config *config, thread_pool *pool) {
+    if (config->io_uring_engine) {
+        if (uring_engine_run(listen_fd, connection_timers, &server_running) == 0) {
+            return;
+        }
+        LOG_WARN("io_uring engine unavailable, falling back to blocking I/O");
+    }
+    accept_loop(listen_fd, pool);
+}
+
+/**
+ * An acceptor thread: owns one listening socket. Single mode runs one that hands connections to the
+ * thread pool, reuseport mode one per SO_REUSEPORT listener
+ */
+typedef struct {
+    int listen_fd;
+    unsigned int index;
+    server_config *config;
+    thread_pool *pool;
+    pthread_t thread;
+    bool started;
+} acceptor;
+
+static void *acceptor_main(void *arg) {
+    acceptor *self = (acceptor *)arg;
+    // Without a pool the acceptor serves its connections itself, so it is the thread to pin
+    if (!self->pool) {
+        int cpu = affinity_pin_thread(self->index);
+        if (cpu >= 0 && self->config->reuseport_listeners) {
+            set_incoming_cpu(self->listen_fd, cpu);
+        }
+    }
+    serve_listener(self->listen_fd, self->config, self->pool);
+    return NULL;
+}
+
+/**
+ * Pool thread_init: pins worker index before it allocates anything
+ */
+static void pin_worker(unsigned int index) {
+    affinity_pin_thread(index);
+}
+
+/**
+ * Fill fds with the listening sockets: the ones handed over by the previous server process after an
+ * upgrade, otherwise freshly opened ones (thread_pool_size of them in reuseport mode).
+ * Returns the number of sockets, -1 on error
+ */
+static int open_listeners(server_config *config, int *fds, int max) {
+    listen_options options = {
+        .backlog = (int)config->listen_backlog,
+        .tcp_nodelay = config->tcp_nodelay,
+        .defer_accept = (int)config->defer_accept,
+        .fastopen_queue = (int)config->fastopen_queue,
+        .send_buffer = (int)config->send_buffer,
+        .recv_buffer = (int)config->recv_buffer,
+    };
+    // Inherited sockets keep the options the previous process set up
+    int count = handoff_inherited_listeners(fds, max);
+    if (count > 0) {
+        LOG_INFO("Took over %d listening socket(s) from the previous server process", count);
+    } else if (config->reuseport_listeners) {
+        count = config->thread_pool_size < (unsigned int)max ? (int)config->thread_pool_size : max;
+        for (int i = 0; i < count; ++i) {
+            fds[i] = open_listenfd_reuseport(config->port, &options);
+            if (fds[i] < 0) {
+                LOG_ERROR("Failed to open SO_REUSEPORT listener %d on port %s", i, config->port);
+                while (i-- > 0) {
+                    close(fds[i]);
+                }
+                return -1;
+            }
+        }
+        if (config->reuseport_cpu_steering && attach_reuseport_cpu_steering(fds[0], (unsigned int)count) < 0) {
+            LOG_WARN("Continuing without CPU steering, the kernel will hash connections across listeners");
+        }
+    } else {
+        fds[0] = open_listenfd(config->port, &options);
+        if (fds[0] < 0) {
+            LOG_ERROR("Failed to open listening socket on port %s", config->port);
+            return -1;
+        }
+        count = 1;
+    }
+    
+    for (int i = 0; i < count; ++i) {
+        int flags = fcntl(fds[i], F_GETFL);
+        if (flags < 0 || fcntl(fds[i], F_SETFL, flags | O_NONBLOCK) < 0) {
+            LOG_WARN("Failed to make listening socket %d non-blocking: %s", fds[i], strerror(errno));
+        }
+        // Only a successor started by an upgrade gets the listening sockets, not every CGI script
+        fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+    }
+    return count;
+}
+
+/**
+ * Wait up to DrainTimeout seconds (from the current configuration) for the admitted connections to
+ * finish. Returns true once all of them are closed, false if some were still open at the deadline
+ */
+static bool drain_connections(void) {
+    unsigned int remaining = admission_in_flight();
+    if (remaining == 0) {
+        return true;
+    }
+    server_config *config = config_snapshot_acquire();
+    unsigned int drain_timeout = config->drain_timeout;
+    config_snapshot_release(config);
+    LOG_INFO("Draining %u in-flight connection(s) for up to %us", remaining, drain_timeout);
+    
+    struct timespec start, now;
+    struct timespec pause = { 0, DRAIN_POLL_INTERVAL_MS * 1000000L };
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while ((remaining = admission_in_flight()) > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec - start.tv_sec >= (time_t)drain_timeout) {
+            LOG_WARN("Drain timed out with %u connection(s) still open", remaining);
+            return false;
+        }
+        nanosleep(&pause, NULL);
+    }
+    LOG_INFO("All in-flight connections finished");
+    return true;
+}
+
+// Command line and resolved binary of this process, used to start a successor on SIGUSR2
+static char **saved_argv = NULL;
+static char *executable_path = NULL;
+
+// Configuration file found at startup, read again on SIGHUP
+static const char *config_file = NULL;
+
+/**
+ * Load config_file into a new snapshot and publish it. Connections accepted from then on use it, the
+ * ones in progress finish on the snapshot they started with. startup holds the settings the listeners
+ * were set up with, those only change with a restart or an upgrade
+ */
+static void reload_configuration(server_config *startup, thread_pool *pool) {
+    LOG_INFO("Reloading configuration from %s", config_file);
+    server_config *config = config_snapshot_load(config_file);
+    if (!config) {
+        LOG_ERROR("Failed to reload %s, keeping the current configuration", config_file);
+        return;
+    }
+    
+    if (strcmp(config->port, startup->port) != 0 ||
+        config->reuseport_listeners != startup->reuseport_listeners ||
+        config->reuseport_cpu_steering != startup->reuseport_cpu_steering ||
+        config->io_uring_engine != startup->io_uring_engine) {
+        LOG_WARN("Port, ListenerMode, ReusePortCpuSteering and IoEngine only change with a restart or upgrade (SIGUSR2)");
+    }
+    if (config->listen_backlog != startup->listen_backlog || config->tcp_nodelay != startup->tcp_nodelay ||
+        config->defer_accept != startup->defer_accept || config->fastopen_queue != startup->fastopen_queue ||
+        config->send_buffer != startup->send_buffer || config->recv_buffer != startup->recv_buffer) {
+        LOG_WARN("Listening socket options in [Network] only change with a restart");
+    }
+    if ((config->mime_types_file == NULL) != (startup->mime_types_file == NULL) ||
+        (config->mime_types_file && strcmp(config->mime_types_file, startup->mime_types_file) != 0)) {
+        LOG_WARN("MimeTypes only changes with a restart or upgrade (SIGUSR2)");
+    }
+    if (!pool && config->thread_pool_size != startup->thread_pool_size) {
+        LOG_WARN("ThreadPoolSize only changes with a restart or upgrade without a thread pool");
+    }
+    if (config->path_cache_watch != startup->path_cache_watch || config->path_cache_bloom != startup->path_cache_bloom ||
+        (config->path_cache_watch && strcmp(config->document_root, startup->document_root) != 0)) {
+        LOG_WARN("PathCacheWatch, PathCacheBloom and the watched DocumentRoot only change with a restart or upgrade (SIGUSR2)");
+    }
+    
+    log_set_level(config->log_level);
+    affinity_configure(config->cpu_affinity);
+    admission_init(config);
+    path_cache_configure(config->path_cache_entries, config->path_cache_ttl, config->path_cache_missing_ttl);
+    if (pool && thread_pool_resize(pool, config->thread_pool_size) < 0) {
+        LOG_WARN("Failed to resize the thread pool to %u workers", config->thread_pool_size);
+    }
+    config_snapshot_publish(config);
+    LOG_INFO("Configuration reloaded");
+}
+
+/**
+ * Runs one acceptor thread per listening socket while the main thread waits for signals. SIGHUP
+ * reloads the configuration. SIGINT and SIGTERM stop accepting. SIGUSR2 first starts a successor
+ * from the binary on disk and hands it the listening sockets, this process only stops accepting once
+ * the successor does. Either way the connections already accepted get DrainTimeout seconds to finish.
+ * Returns 0 after a complete drain, 1 if connections were still open at the deadline, -1 if the
+ * acceptors could not be started
+ */
+static int run_server(server_config *config, int *fds, int count, thread_pool *pool) {
+    acceptor *acceptors = calloc((size_t)count, sizeof(acceptor));
+    if (!acceptors) {
+        LOG_ERROR("Failed to allocate %d acceptors", count);
+        return -1;
+    }
+    
+    // Signals must reach the main thread, which is the one waiting for them
+    sigset_t previous_mask;
+    block_control_signals(&previous_mask);
+    
+    int status = 0;
+    for (int i = 0; i < count; ++i) {
+        acceptors[i].listen_fd = fds[i];
+        acceptors[i].index = (unsigned int)i;
+        acceptors[i].config = config;
+        acceptors[i].pool = pool;
+        if (pthread_create(&acceptors[i].thread, NULL, acceptor_main, &acceptors[i]) != 0) {
+            LOG_ERROR("Failed to start acceptor thread %d", i);
+            status = -1;
+            break;
+        }
+        acceptors[i].started = true;
+    }
+    
+    if (status == 0) {
+        LOG_INFO("Server listening on port %s with %d acceptor(s)", config->port, count);
+        LOG_INFO("Server ready to accept connections...");
+        handoff_notify_ready();
+        // sigsuspend atomically unblocks the signals and waits, so a signal can't slip in between the check and the wait
+        while (server_running) {
+            sigsuspend(&previous_mask);
+            if (reload_requested) {
+                reload_requested = 0;
+                reload_configuration(config, pool);
+            }
+            if (!upgrade_requested) {
+                continue;
+            }
+            upgrade_requested = 0;
+            if (!executable_path) {
+                LOG_ERROR("Upgrade requested, but the server binary could not be located at startup");
+            } else if (handoff_spawn_successor(executable_path, saved_argv, fds, count) == 0) {
+                LOG_INFO("Listening sockets handed over, stopping to accept");
+                server_running = 0;
+            } else {
+                LOG_ERROR("Upgrade failed, this process keeps serving");
+            }
+        }
+    } else {
+        server_running = 0;
+    }
+    pthread_sigmask(SIG_SETMASK, &previous_mask, NULL);
+    
+    // Acceptors notice server_running within ACCEPT_POLL_TIMEOUT_MS, connections they accepted in
+    // the meantime are counted by the drain
+    if (status == 0 && !drain_connections()) {
+        // The remaining connections still use acceptors and config, exiting ends them
+        return 1;
+    }
+    for (int i = 0; i < count; ++i) {
+        if (acceptors[i].started) {
+            pthread_join(acceptors[i].thread, NULL);
+        }
+    }
+    free(acceptors);
+    return status;
+}
+
 /**
  * Main server function
  */
 int main(int argc, char **argv) {
-    (void) argv;
-    LOG_INFO("Starting Sequential HTTP Server (Stage 2)");
+    LOG_INFO("Starting HTTP Server");
+    
+    // Resolved now, a successor is started from the same path even if the binary was replaced since.
+    // argv[0] has no directory when the server was found through $PATH, Linux knows the binary anyway
+    saved_argv = argv;
+#ifdef __linux__
+    const char *self = "/proc/self/exe";
+#else
+    const char *self = argv[0];
+#endif
+    executable_path = realpath(self, NULL);
+    if (!executable_path) {
+        LOG_WARN("Failed to resolve %s, binary upgrades are disabled: %s", self, strerror(errno));
+    }
     
-    // Set up signal handlers for graceful shutdown
+    // Set up signal handlers for graceful shutdown, upgrades and reloads
     struct sigaction sa;
     sa.sa_handler = signal_handler;
     sigemptyset(&sa.sa_mask);
     sa.sa_flags = 0;  // No SA_RESTART - force EINTR
     sigaction(SIGINT, &sa, NULL);
     sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGUSR2, &sa, NULL);
+    sigaction(SIGHUP, &sa, NULL);
     
-    // Load server configuration
-    server_config config;
-    config_init(&config);
+    // Writes to a peer that went away (or was shut down by a timeout) must fail with EPIPE, not kill the server
+    struct sigaction ignore;
+    ignore.sa_handler = SIG_IGN;
+    sigemptyset(&ignore.sa_mask);
+    ignore.sa_flags = 0;
+    sigaction(SIGPIPE, &ignore, NULL);
     
+    // Load server configuration
     // Try to load config file from parent directory (as in original code)
-    if (!config_load(&config, "../config.ini")) {
+    config_file = "../config.ini";
+    server_config *loaded = config_snapshot_load(config_file);
+    if (!loaded) {
         LOG_WARN("Failed to load config from ../config.ini, trying ./config.ini");
-        if (!config_load(&config, "./config.ini")) {
+        config_file = "./config.ini";
+        loaded = config_snapshot_load(config_file);
+        if (!loaded) {
             LOG_ERROR("Failed to load server configuration from both ../config.ini and ./config.ini");
-            config_cleanup(&config);
+            free(executable_path);
             return 1;
         }
     }
+    config_snapshot_publish(loaded);
+    // Startup settings (listeners, engine) stay with this snapshot for the lifetime of the process
+    server_config *config = config_snapshot_acquire();
+    log_set_level(config->log_level);
+    affinity_configure(config->cpu_affinity);
     
     if (argc >= 2) {
         LOG_WARN("Extra command line parameters ignored. Edit config.ini to change settings.");
     }
     
+    metrics_init();
+    canned_responses_init();
+    admission_init(config);
+    metrics_add_section(admission_render_stats, NULL);
+    
+    // The timer thread must not take signals away from the main thread
+    sigset_t previous_mask;
+    block_control_signals(&previous_mask);
+    connection_timers = timer_wheel_create(TIMER_WHEEL_DEFAULT_TICK_MS);
+    pthread_sigmask(SIG_SETMASK, &previous_mask, NULL);
+    if (!connection_timers) {
+        LOG_WARN("Failed to start connection timer thread, timeouts are not enforced");
+    }
+    
     LOG_INFO("Server configuration loaded successfully");
-    LOG_INFO("Port: %s", config.port);
-    LOG_INFO("Document Root: %s", config.document_root);
-    LOG_INFO("Server Name: %s", config.server_name);
-    
-    // Open listening socket
-    int listen_fd = open_listenfd(config.port);
-    if (listen_fd < 0) {
-        LOG_ERROR("Failed to open listening socket on port %s", config.port);
-        config_cleanup(&config);
-        return 1;
+    LOG_INFO("Port: %s", config->port);
+    LOG_INFO("Document Root: %s", config->document_root);
+    LOG_INFO("Server Name: %s", config->server_name);
+    
+    // Loaded once, before any request is served: MIME lookups do not lock
+    if (config->mime_types_file && mime_load_types(config->mime_types_file) < 0) {
+        LOG_WARN("Serving with the built-in MIME types only");
+    }
+    // Shared by every snapshot, a reload only changes its size and TTLs (see reload_configuration)
+    path_cache_init(config->path_cache_entries, config->path_cache_ttl, config->path_cache_missing_ttl);
+    metrics_add_section(path_cache_render_stats, NULL);
+    if (config->path_cache_watch) {
+        block_control_signals(&previous_mask);
+        path_cache_watch(config->document_root, config->path_cache_bloom);
+        pthread_sigmask(SIG_SETMASK, &previous_mask, NULL);
+    } else if (config->path_cache_bloom) {
+        LOG_WARN("PathCacheBloom needs PathCacheWatch, serving without the bloom filter");
     }
     
-    LOG_INFO("Server listening on port %s (fd=%d)", config.port, listen_fd);
-    LOG_INFO("Server ready to accept connections...");
+    // Open (or take over) the listening sockets
+    int listen_fds[HANDOFF_MAX_LISTENERS];
+    int listen_count = open_listeners(config, listen_fds, HANDOFF_MAX_LISTENERS);
+    if (listen_count < 0) {
+        timer_wheel_destroy(connection_timers);
+        config_snapshot_release(config);
+        config_snapshot_publish(NULL);
+        free(executable_path);
+        return 1;
+    }
     
-    // Main server loop - sequential processing
-    while (server_running) {
-        struct sockaddr_storage client_addr;
-        socklen_t addr_len = sizeof(client_addr);
-        
-        // Accept incoming connection
-        int client_fd = accept(listen_fd, (struct sockaddr *)&client_addr, &addr_len);
-        
-        if (client_fd < 0) {
-            if (errno == EINTR) {
-                // Interrupted by signal - check if we should shutdown
-                if (!server_running) {
-                    LOG_INFO("Accept interrupted, shutting down...");
-                    break;
-                }
-                // Otherwise just retry accept
-                continue;
-            }
-            LOG_ERROR("Failed to accept connection: %s", strerror(errno));
-            continue;
-        }
-        
-        // Check shutdown flag even on successful accept
-        if (!server_running) {
-            LOG_INFO("Shutdown requested, closing new connection");
-            close(client_fd);
-            break;
-        }
-        
-        // Get client address information
-        char client_ip[INET6_ADDRSTRLEN];
-        char client_port[MAX_PORT_STRLEN];
-        
-        int gni_result = getnameinfo(
-            (struct sockaddr *)&client_addr, addr_len,
-            client_ip, sizeof(client_ip),
-            client_port, sizeof(client_port),
-            NI_NUMERICHOST | NI_NUMERICSERV
-        );
-        
-        if (gni_result == 0) {
-            LOG_INFO("Connection accepted from %s:%s (fd=%d)", client_ip, client_port, client_fd);
+    // Workers only serve connections, signals are left to the main thread
+    thread_pool *pool = NULL;
+    if (!config->reuseport_listeners && !config->io_uring_engine) {
+        block_control_signals(&previous_mask);
+        pool = thread_pool_create(config->thread_pool_size, pool_serve_connection, pin_worker);
+        pthread_sigmask(SIG_SETMASK, &previous_mask, NULL);
+        if (pool) {
+            metrics_add_section(thread_pool_render_stats, pool);
         } else {
-            LOG_INFO("Connection accepted from unknown client (fd=%d)", client_fd);
-            LOG_WARN("getnameinfo failed: %s", gai_strerror(gni_result));
-        }
-        
-        // Handle the client request (sequential processing)
-        handle_client(client_fd, &config);
-        
-        // Close client connection
-        if (close(client_fd) < 0) {
-            LOG_ERROR("Failed to close client connection (fd=%d): %s", client_fd, strerror(errno));
-        } else {
-            LOG_INFO("Client connection closed (fd=%d)", client_fd);
+            LOG_WARN("Failed to start thread pool, serving connections sequentially");
         }
     }
     
+    // Main server loop
+    int status = run_server(config, listen_fds, listen_count, pool);
+    
     // Cleanup and shutdown
     LOG_INFO("Shutting down server...");
+    if (status > 0) {
+        LOG_WARN("Exiting with connections still open");
+        return 1;
+    }
     
-    if (close(listen_fd) < 0) {
-        LOG_ERROR("Failed to close listening socket: %s", strerror(errno));
+    // Empty after a complete drain, stops the workers
+    if (pool) {
+        metrics_remove_section(thread_pool_render_stats, pool);
+        thread_pool_destroy(pool);
     }
+    timer_wheel_destroy(connection_timers);
     
-    config_cleanup(&config);
+    for (int i = 0; i < listen_count; ++i) {
+        if (close(listen_fds[i]) < 0) {
+            LOG_ERROR("Failed to close listening socket: %s", strerror(errno));
+        }
+    }
+    
+    mime_unload_types();
+    metrics_remove_section(path_cache_render_stats, NULL);
+    path_cache_destroy();
+    config_snapshot_release(config);
+    config_snapshot_publish(NULL);
+    free(executable_path);
     LOG_INFO("Server shutdown complete");
     
-    return 0;
-}
\ No newline at end of file
+    return status == 0 ? 0 : 1;
+}
@@ -0,0 +1,525 @@
+#include "thread_pool.h"
+#include "metrics.h"
+#include "logger.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+#define CACHE_LINE_SIZE 64
+#define PARK_TIMEOUT_NS 100000000L // upper bound on a parked worker's sleep, guards against a missed wakeup
+
+/*
+Chase-Lev work-stealing deque with a fixed capacity ("Correct and Efficient Work-Stealing for Weak
+Memory Models", Le et al. 2013). top and bottom grow without bound and are masked into slots.
+*/
+typedef struct {
+    int64_t top;     // next slot a thief takes
+    char top_pad[CACHE_LINE_SIZE - sizeof(int64_t)];
+    int64_t bottom;  // next slot the owner pushes to
+    char bottom_pad[CACHE_LINE_SIZE - sizeof(int64_t)];
+    void *slots[THREAD_POOL_DEQUE_CAPACITY];
+} work_deque;
+
+/*
+Bounded MPMC queue (Vyukov). Each cell carries a sequence number telling producers and consumers
+whose turn it is, so both sides only need one CAS on their own index.
+*/
+typedef struct {
+    uint64_t sequence;
+    void *item;
+} inbox_cell;
+
+typedef struct {
+    uint64_t head;
+    char head_pad[CACHE_LINE_SIZE - sizeof(uint64_t)];
+    uint64_t tail;
+    char tail_pad[CACHE_LINE_SIZE - sizeof(uint64_t)];
+    inbox_cell cells[THREAD_POOL_INBOX_CAPACITY];
+} work_inbox;
+
+/*
+Workers are cache line aligned, so the deque indices of one never share a line with the counters of
+the worker before it. stolen is written by thieves and gets a line of its own, the rest of the tail
+is written by the owner only
+*/
+typedef struct {
+    work_deque deque;
+    work_inbox inbox;
+    thread_pool *pool;
+    unsigned int index;
+    unsigned int rng;  // xorshift state for picking steal victims
+    pthread_t thread;
+    bool started;      // thread created and not joined yet
+    bool initialized;  // queues set up by the worker's first thread, guarded by the pool lock
+    bool exited;       // retired after a shrink, guarded by the pool lock
+    uint64_t handled;  // items run by this worker
+    uint64_t steals;   // items this worker took from peers
+    uint64_t stolen __attribute__((aligned(CACHE_LINE_SIZE))); // items peers took from this worker
+} __attribute__((aligned(CACHE_LINE_SIZE))) worker;
+
+struct thread_pool {
+    worker *workers;             // THREAD_POOL_MAX_WORKERS slots, cache line aligned
+    void *worker_memory;         // allocation holding workers
+    unsigned int slot_count;     // slots initialized so far, scanned by thieves even once retired
+    unsigned int worker_count;   // workers taking submissions, slots past it retire
+    thread_pool_handler handler;
+    thread_pool_thread_init thread_init;
+    unsigned int next_worker;  // round-robin cursor for external submissions
+    int stopping;
+    int sleepers;              // workers parked (or about to park) on wake
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t ready;      // a fresh worker finished setting up its queues
+};
+
+static __thread worker *current_worker;
+
+static void deque_init(work_deque *deque) {
+    deque->top = 0;
+    deque->bottom = 0;
+}
+
+/*
+Owner only. Returns 0 on success, -1 if the deque is full
+*/
+static int deque_push(work_deque *deque, void *item) {
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    if (bottom - top >= THREAD_POOL_DEQUE_CAPACITY) {
+        return -1;
+    }
+    __atomic_store_n(&deque->slots[bottom & (THREAD_POOL_DEQUE_CAPACITY - 1)], item, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+/*
+Owner only. Returns the most recently pushed item, NULL if the deque is empty
+*/
+static void *deque_take(work_deque *deque) {
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&deque->bottom, bottom, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+
+    void *item = NULL;
+    if (top <= bottom) {
+        item = __atomic_load_n(&deque->slots[bottom & (THREAD_POOL_DEQUE_CAPACITY - 1)], __ATOMIC_RELAXED);
+        if (top == bottom) {
+            // Last item - race the thieves for it
+            if (!__atomic_compare_exchange_n(&deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+                item = NULL;
+            }
+            __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+        }
+    } else {
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+    }
+    return item;
+}
+
+/*
+Any thread. Returns the oldest item, NULL if the deque is empty or another thread won the race
+*/
+static void *deque_steal(work_deque *deque) {
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+    if (top >= bottom) {
+        return NULL;
+    }
+    void *item = __atomic_load_n(&deque->slots[top & (THREAD_POOL_DEQUE_CAPACITY - 1)], __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        return NULL;
+    }
+    return item;
+}
+
+static int64_t deque_length(work_deque *deque) {
+    int64_t length = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE) - __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    return length > 0 ? length : 0;
+}
+
+static void inbox_init(work_inbox *inbox) {
+    inbox->head = 0;
+    inbox->tail = 0;
+    for (uint64_t i = 0; i < THREAD_POOL_INBOX_CAPACITY; ++i) {
+        inbox->cells[i].sequence = i;
+        inbox->cells[i].item = NULL;
+    }
+}
+
+/*
+Returns 0 on success, -1 if the inbox is full
+*/
+static int inbox_push(work_inbox *inbox, void *item) {
+    uint64_t position = __atomic_load_n(&inbox->tail, __ATOMIC_RELAXED);
+    inbox_cell *cell;
+    for (;;) {
+        cell = &inbox->cells[position & (THREAD_POOL_INBOX_CAPACITY - 1)];
+        uint64_t sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        int64_t diff = (int64_t)sequence - (int64_t)position;
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&inbox->tail, &position, position + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return -1;
+        } else {
+            position = __atomic_load_n(&inbox->tail, __ATOMIC_RELAXED);
+        }
+    }
+    cell->item = item;
+    __atomic_store_n(&cell->sequence, position + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/*
+Returns the oldest item, NULL if the inbox is empty
+*/
+static void *inbox_pop(work_inbox *inbox) {
+    uint64_t position = __atomic_load_n(&inbox->head, __ATOMIC_RELAXED);
+    inbox_cell *cell;
+    for (;;) {
+        cell = &inbox->cells[position & (THREAD_POOL_INBOX_CAPACITY - 1)];
+        uint64_t sequence = __atomic_load_n(&cell->sequence, __ATOMIC_ACQUIRE);
+        int64_t diff = (int64_t)sequence - (int64_t)(position + 1);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&inbox->head, &position, position + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return NULL;
+        } else {
+            position = __atomic_load_n(&inbox->head, __ATOMIC_RELAXED);
+        }
+    }
+    void *item = cell->item;
+    __atomic_store_n(&cell->sequence, position + THREAD_POOL_INBOX_CAPACITY, __ATOMIC_RELEASE);
+    return item;
+}
+
+static uint64_t inbox_length(work_inbox *inbox) {
+    uint64_t tail = __atomic_load_n(&inbox->tail, __ATOMIC_ACQUIRE);
+    uint64_t head = __atomic_load_n(&inbox->head, __ATOMIC_ACQUIRE);
+    return tail > head ? tail - head : 0;
+}
+
+static bool pool_has_work(thread_pool *pool) {
+    unsigned int slots = __atomic_load_n(&pool->slot_count, __ATOMIC_ACQUIRE);
+    for (unsigned int i = 0; i < slots; ++i) {
+        if (deque_length(&pool->workers[i].deque) > 0 || inbox_length(&pool->workers[i].inbox) > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+Wakes one parked worker, if any. Called after an item was published
+*/
+static void pool_wake_one(thread_pool *pool) {
+    // Pairs with the increment of sleepers in worker_park: either the parking worker sees the new item
+    // or this thread sees the sleeper
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&pool->sleepers, __ATOMIC_RELAXED) > 0) {
+        pthread_mutex_lock(&pool->lock);
+        pthread_cond_signal(&pool->wake);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+static void worker_park(worker *self) {
+    thread_pool *pool = self->pool;
+    pthread_mutex_lock(&pool->lock);
+    __atomic_add_fetch(&pool->sleepers, 1, __ATOMIC_SEQ_CST);
+    if (!__atomic_load_n(&pool->stopping, __ATOMIC_ACQUIRE) && !pool_has_work(pool)) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += PARK_TIMEOUT_NS;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&pool->wake, &pool->lock, &deadline);
+    }
+    __atomic_sub_fetch(&pool->sleepers, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/*
+Takes from peers starting at a random victim: deques first (oldest items), then inboxes
+*/
+static void *worker_steal(worker *self) {
+    thread_pool *pool = self->pool;
+    unsigned int count = __atomic_load_n(&pool->slot_count, __ATOMIC_ACQUIRE);
+    if (count < 2) return NULL;
+
+    self->rng ^= self->rng << 13;
+    self->rng ^= self->rng >> 17;
+    self->rng ^= self->rng << 5;
+    unsigned int start = self->rng % count;
+
+    for (int pass = 0; pass < 2; ++pass) {
+        for (unsigned int i = 0; i < count; ++i) {
+            worker *victim = &pool->workers[(start + i) % count];
+            if (victim == self) continue;
+            void *item = pass == 0 ? deque_steal(&victim->deque) : inbox_pop(&victim->inbox);
+            if (item) {
+                __atomic_add_fetch(&self->steals, 1, __ATOMIC_RELAXED);
+                __atomic_add_fetch(&victim->stolen, 1, __ATOMIC_RELAXED);
+                return item;
+            }
+        }
+    }
+    return NULL;
+}
+
+static void *worker_find_work(worker *self) {
+    void *item = deque_take(&self->deque);
+    if (item) return item;
+    item = inbox_pop(&self->inbox);
+    if (item) return item;
+    return worker_steal(self);
+}
+
+/*
+A worker past worker_count exits once its own queues are empty. Decided under the pool lock so a
+resize can't miss a worker that is about to exit. Returns true if the worker must exit
+*/
+static bool worker_retire(worker *self) {
+    thread_pool *pool = self->pool;
+    pthread_mutex_lock(&pool->lock);
+    // Slots past slot_count are still being brought up by a resize, their worker count isn't published yet
+    bool retire = self->index < pool->slot_count &&
+                  self->index >= __atomic_load_n(&pool->worker_count, __ATOMIC_ACQUIRE) &&
+                  deque_length(&self->deque) == 0 && inbox_length(&self->inbox) == 0;
+    if (retire) {
+        self->exited = true;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return retire;
+}
+
+static void *worker_main(void *arg) {
+    worker *self = (worker *)arg;
+    thread_pool *pool = self->pool;
+    current_worker = self;
+
+    if (pool->thread_init) {
+        pool->thread_init(self->index);
+    }
+    // Set up here rather than by the creator so the queues are first touched, and therefore placed,
+    // on the worker's own CPU and NUMA node
+    if (!self->initialized) {
+        deque_init(&self->deque);
+        inbox_init(&self->inbox);
+        pthread_mutex_lock(&pool->lock);
+        self->initialized = true;
+        pthread_cond_broadcast(&pool->ready);
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    for (;;) {
+        // A retiring worker only finishes what was queued to it, late submissions to its inbox are
+        // left to thieves
+        bool retiring = self->index >= __atomic_load_n(&pool->worker_count, __ATOMIC_ACQUIRE);
+        void *item = retiring ? deque_take(&self->deque) : worker_find_work(self);
+        if (!item && retiring) {
+            item = inbox_pop(&self->inbox);
+        }
+        if (item) {
+            pool->handler(item);
+            __atomic_add_fetch(&self->handled, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        // Queues are drained before exiting so no submitted item is lost
+        if (__atomic_load_n(&pool->stopping, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+        if (retiring && worker_retire(self)) {
+            break;
+        }
+        worker_park(self);
+    }
+    current_worker = NULL;
+    return NULL;
+}
+
+/*
+Brings the workers below worker_count up, then publishes worker_count. Fresh slots get a thread that
+sets up its own queues, and submissions may target any slot below worker_count, so the count is only
+published once they are ready. Retired workers that have not exited yet simply stay, exited ones get
+a new thread (their inbox may still hold items). Called with the pool lock held.
+Returns 0 on success, -1 if a thread could not be started (the pool keeps the workers it has)
+*/
+static int pool_start_workers(thread_pool *pool, unsigned int worker_count) {
+    int status = 0;
+    unsigned int slots = pool->slot_count;
+    for (unsigned int i = slots; i < worker_count; ++i) {
+        worker *w = &pool->workers[i];
+        w->pool = pool;
+        w->index = i;
+        w->rng = 2654435761u * (i + 1); // any non-zero seed works for xorshift
+        if (pthread_create(&w->thread, NULL, worker_main, w) != 0) {
+            LOG_ERROR("Failed to start worker thread %u", i);
+            status = -1;
+            break;
+        }
+        w->started = true;
+        slots = i + 1;
+    }
+    for (unsigned int i = pool->slot_count; i < slots; ++i) {
+        while (!pool->workers[i].initialized) {
+            pthread_cond_wait(&pool->ready, &pool->lock);
+        }
+    }
+    __atomic_store_n(&pool->slot_count, slots, __ATOMIC_RELEASE);
+    if (worker_count > slots) {
+        worker_count = slots;
+    }
+    __atomic_store_n(&pool->worker_count, worker_count, __ATOMIC_RELEASE);
+
+    for (unsigned int i = 0; i < worker_count; ++i) {
+        worker *w = &pool->workers[i];
+        if (!w->exited) {
+            continue;
+        }
+        pthread_join(w->thread, NULL);
+        w->started = false;
+        w->exited = false;
+        if (pthread_create(&w->thread, NULL, worker_main, w) != 0) {
+            LOG_ERROR("Failed to restart worker thread %u", i);
+            status = -1;
+            continue;
+        }
+        w->started = true;
+    }
+    // Fresh workers may have parked before the count covered them
+    pthread_cond_broadcast(&pool->wake);
+    return status;
+}
+
+thread_pool *thread_pool_create(unsigned int worker_count, thread_pool_handler handler,
+                                thread_pool_thread_init thread_init) {
+    if (worker_count == 0 || worker_count > THREAD_POOL_MAX_WORKERS || !handler) {
+        LOG_ERROR("Invalid parameters passed to thread_pool_create");
+        return NULL;
+    }
+    thread_pool *pool = calloc(1, sizeof(thread_pool));
+    if (!pool) {
+        LOG_ERROR("Failed to allocate thread pool");
+        return NULL;
+    }
+    // Slots for a later resize only cost address space until they are first used. calloc rather than
+    // posix_memalign plus memset, which would touch every page from this thread
+    pool->worker_memory = calloc(1, THREAD_POOL_MAX_WORKERS * sizeof(worker) + CACHE_LINE_SIZE);
+    pool->workers = (worker *)(((uintptr_t)pool->worker_memory + CACHE_LINE_SIZE - 1) & ~(uintptr_t)(CACHE_LINE_SIZE - 1));
+    if (!pool->worker_memory) {
+        LOG_ERROR("Failed to allocate %u workers", THREAD_POOL_MAX_WORKERS);
+        free(pool);
+        return NULL;
+    }
+    pool->handler = handler;
+    pool->thread_init = thread_init;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->ready, NULL);
+
+    pthread_mutex_lock(&pool->lock);
+    int started = pool_start_workers(pool, worker_count);
+    pthread_mutex_unlock(&pool->lock);
+    if (started < 0) {
+        thread_pool_destroy(pool);
+        return NULL;
+    }
+    LOG_INFO("Thread pool started with %u workers", worker_count);
+    return pool;
+}
+
+int thread_pool_resize(thread_pool *pool, unsigned int worker_count) {
+    if (!pool || worker_count == 0 || worker_count > THREAD_POOL_MAX_WORKERS) {
+        LOG_ERROR("Invalid parameters passed to thread_pool_resize");
+        return -1;
+    }
+    pthread_mutex_lock(&pool->lock);
+    unsigned int previous = pool->worker_count;
+    int status = 0;
+    if (worker_count > previous) {
+        status = pool_start_workers(pool, worker_count);
+    } else {
+        __atomic_store_n(&pool->worker_count, worker_count, __ATOMIC_RELEASE);
+        // Parked workers past the new count exit once woken
+        pthread_cond_broadcast(&pool->wake);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    if (status == 0 && worker_count != previous) {
+        LOG_INFO("Thread pool resized from %u to %u workers", previous, worker_count);
+    }
+    return status;
+}
+
+int thread_pool_submit(thread_pool *pool, void *item) {
+    if (!pool || !item || __atomic_load_n(&pool->stopping, __ATOMIC_ACQUIRE)) {
+        return -1;
+    }
+    if (current_worker && current_worker->pool == pool && deque_push(&current_worker->deque, item) == 0) {
+        pool_wake_one(pool);
+        return 0;
+    }
+    unsigned int start = __atomic_fetch_add(&pool->next_worker, 1, __ATOMIC_RELAXED);
+    unsigned int count = __atomic_load_n(&pool->worker_count, __ATOMIC_ACQUIRE);
+    for (unsigned int i = 0; i < count; ++i) {
+        if (inbox_push(&pool->workers[(start + i) % count].inbox, item) == 0) {
+            pool_wake_one(pool);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void thread_pool_destroy(thread_pool *pool) {
+    if (!pool) return;
+    __atomic_store_n(&pool->stopping, 1, __ATOMIC_RELEASE);
+    pthread_mutex_lock(&pool->lock);
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (unsigned int i = 0; i < pool->slot_count; ++i) {
+        if (pool->workers[i].started) {
+            pthread_join(pool->workers[i].thread, NULL);
+        }
+    }
+    pthread_cond_destroy(&pool->wake);
+    pthread_cond_destroy(&pool->ready);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->worker_memory);
+    free(pool);
+}
+
+size_t thread_pool_render_stats(char *buf, size_t size, void *arg) {
+    thread_pool *pool = (thread_pool *)arg;
+    if (!buf || size == 0) return 0;
+    buf[0] = '\0';
+    size_t offset = 0;
+    if (!pool) return 0;
+
+    unsigned int active = __atomic_load_n(&pool->worker_count, __ATOMIC_ACQUIRE);
+    unsigned int slots = __atomic_load_n(&pool->slot_count, __ATOMIC_ACQUIRE);
+    metrics_appendf(buf, size, &offset, "thread pool (%u workers):\n", active);
+    for (unsigned int i = 0; i < slots; ++i) {
+        worker *w = &pool->workers[i];
+        metrics_appendf(buf, size, &offset,
+                        "worker %-3u%s deque=%" PRId64 " inbox=%" PRIu64 " handled=%" PRIu64 " steals=%" PRIu64 " stolen=%" PRIu64 "\n",
+                        i, i < active ? "" : " (retired)", deque_length(&w->deque), inbox_length(&w->inbox),
+                        __atomic_load_n(&w->handled, __ATOMIC_RELAXED),
+                        __atomic_load_n(&w->steals, __ATOMIC_RELAXED),
+                        __atomic_load_n(&w->stolen, __ATOMIC_RELAXED));
+    }
+    return offset;
+}
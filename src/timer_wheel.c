@@ -0,0 +1,188 @@
+#include "timer_wheel.h"
+#include "logger.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SLOT_MASK       (TIMER_WHEEL_SLOTS - 1)
+#define MAX_DELTA_TICKS ((UINT64_C(1) << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOT_BITS)) - 1)
+
+struct timer_wheel {
+    pthread_mutex_t lock;
+    timer_entry *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    uint64_t now;             // ticks processed so far
+    unsigned int tick_ms;
+    struct timespec started;  // CLOCK_MONOTONIC time of tick 0
+    pthread_t thread;
+    int running;
+};
+
+static void unlink_timer(timer_entry *timer) {
+    if (!timer->pprev) return;
+    *timer->pprev = timer->next;
+    if (timer->next) {
+        timer->next->pprev = timer->pprev;
+    }
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+/*
+Links timer into the slot matching its expiry. wheel must be locked
+*/
+static void place_timer(timer_wheel *wheel, timer_entry *timer) {
+    uint64_t delta = timer->expires > wheel->now ? timer->expires - wheel->now : 0;
+    if (delta > MAX_DELTA_TICKS) {
+        delta = MAX_DELTA_TICKS;
+        timer->expires = wheel->now + delta;
+    }
+
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (UINT64_C(1) << ((level + 1) * TIMER_WHEEL_SLOT_BITS))) {
+        level++;
+    }
+    // Expired timers go into the current slot so the next expiry pass picks them up
+    uint64_t tick = timer->expires > wheel->now ? timer->expires : wheel->now;
+    timer_entry **slot = &wheel->slots[level][(tick >> (level * TIMER_WHEEL_SLOT_BITS)) & SLOT_MASK];
+
+    timer->next = *slot;
+    if (timer->next) {
+        timer->next->pprev = &timer->next;
+    }
+    timer->pprev = slot;
+    *slot = timer;
+}
+
+/*
+Moves every timer of a higher level slot down to the level its remaining time belongs to
+*/
+static void cascade(timer_wheel *wheel, int level) {
+    unsigned int index = (unsigned int)((wheel->now >> (level * TIMER_WHEEL_SLOT_BITS)) & SLOT_MASK);
+    timer_entry *timer = wheel->slots[level][index];
+    wheel->slots[level][index] = NULL;
+    while (timer) {
+        timer_entry *next = timer->next;
+        timer->pprev = NULL;
+        place_timer(wheel, timer);
+        timer = next;
+    }
+}
+
+/*
+Advances the wheel by one tick and fires everything due. wheel must be locked
+*/
+static void advance(timer_wheel *wheel) {
+    wheel->now++;
+    // Cascade from the highest wrapping level down so timers can fall through several levels
+    int wrapped = 0;
+    while (wrapped < TIMER_WHEEL_LEVELS - 1 &&
+           ((wheel->now >> (wrapped * TIMER_WHEEL_SLOT_BITS)) & SLOT_MASK) == 0) {
+        wrapped++;
+    }
+    for (int level = wrapped; level > 0; --level) {
+        cascade(wheel, level);
+    }
+
+    timer_entry **slot = &wheel->slots[0][wheel->now & SLOT_MASK];
+    while (*slot) {
+        timer_entry *timer = *slot;
+        unlink_timer(timer);
+        timer->callback(timer);
+    }
+}
+
+static uint64_t elapsed_ticks(timer_wheel *wheel) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t elapsed_ms = (int64_t)(now.tv_sec - wheel->started.tv_sec) * 1000 +
+                         (now.tv_nsec - wheel->started.tv_nsec) / 1000000;
+    return elapsed_ms > 0 ? (uint64_t)elapsed_ms / wheel->tick_ms : 0;
+}
+
+static void *timer_thread_main(void *arg) {
+    timer_wheel *wheel = (timer_wheel *)arg;
+    struct timespec tick = {
+        .tv_sec = wheel->tick_ms / 1000,
+        .tv_nsec = (long)(wheel->tick_ms % 1000) * 1000000L
+    };
+
+    while (__atomic_load_n(&wheel->running, __ATOMIC_ACQUIRE)) {
+        nanosleep(&tick, NULL);
+        // Catch up on every tick that passed, sleeps may overshoot
+        uint64_t due = elapsed_ticks(wheel);
+        pthread_mutex_lock(&wheel->lock);
+        while (wheel->now < due) {
+            advance(wheel);
+        }
+        pthread_mutex_unlock(&wheel->lock);
+    }
+    return NULL;
+}
+
+timer_wheel *timer_wheel_create(unsigned int tick_ms) {
+    if (tick_ms == 0) {
+        LOG_ERROR("Invalid tick passed to timer_wheel_create");
+        return NULL;
+    }
+    timer_wheel *wheel = calloc(1, sizeof(timer_wheel));
+    if (!wheel) {
+        LOG_ERROR("Failed to allocate timer wheel");
+        return NULL;
+    }
+    pthread_mutex_init(&wheel->lock, NULL);
+    wheel->tick_ms = tick_ms;
+    clock_gettime(CLOCK_MONOTONIC, &wheel->started);
+    wheel->running = 1;
+
+    if (pthread_create(&wheel->thread, NULL, timer_thread_main, wheel) != 0) {
+        LOG_ERROR("Failed to start timer thread");
+        pthread_mutex_destroy(&wheel->lock);
+        free(wheel);
+        return NULL;
+    }
+    return wheel;
+}
+
+void timer_wheel_destroy(timer_wheel *wheel) {
+    if (!wheel) return;
+    __atomic_store_n(&wheel->running, 0, __ATOMIC_RELEASE);
+    pthread_join(wheel->thread, NULL);
+    pthread_mutex_destroy(&wheel->lock);
+    free(wheel);
+}
+
+void timer_init(timer_entry *timer, timer_wheel *wheel, timer_callback callback, void *arg) {
+    if (!timer) return;
+    memset(timer, 0, sizeof(*timer));
+    timer->wheel = wheel;
+    timer->callback = callback;
+    timer->arg = arg;
+}
+
+void timer_arm(timer_entry *timer, unsigned int timeout_ms) {
+    if (!timer || !timer->wheel || !timer->callback) return;
+    timer_wheel *wheel = timer->wheel;
+
+    pthread_mutex_lock(&wheel->lock);
+    unlink_timer(timer);
+    timer->timeout_ms = timeout_ms;
+    if (timeout_ms > 0) {
+        // Round up and add the partially elapsed current tick so a timer never fires early
+        timer->expires = wheel->now + (timeout_ms + wheel->tick_ms - 1) / wheel->tick_ms + 1;
+        place_timer(wheel, timer);
+    }
+    pthread_mutex_unlock(&wheel->lock);
+}
+
+void timer_refresh(timer_entry *timer) {
+    if (!timer) return;
+    timer_arm(timer, timer->timeout_ms);
+}
+
+void timer_disarm(timer_entry *timer) {
+    if (!timer || !timer->wheel) return;
+    pthread_mutex_lock(&timer->wheel->lock);
+    unlink_timer(timer);
+    pthread_mutex_unlock(&timer->wheel->lock);
+}
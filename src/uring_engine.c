@@ -0,0 +1,913 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // accept4
+#endif
+#include "uring_engine.h"
+#include "logger.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define URING_ENGINE_AVAILABLE 1
+#endif
+#endif
+
+#ifndef URING_ENGINE_AVAILABLE
+
+int uring_engine_run(int listen_fd, timer_wheel *timers, volatile sig_atomic_t *running) {
+    (void) listen_fd;
+    (void) timers;
+    (void) running;
+    LOG_WARN("io_uring engine is not available on this platform");
+    return -1;
+}
+
+#else
+
+#include "rio.h"
+#include "http_parser.h"
+#include "request_handler.h"
+#include "metrics.h"
+#include "probes.h"
+#include "admission.h"
+#include "scan.h"
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+
+/*
+liburing is not assumed to be installed, so the ring is driven with the raw system calls and the
+shared ring memory is accessed with explicit acquire/release atomics (see io_uring(7)).
+*/
+
+#define REQUEST_BUFFER_SIZE (BUFFER_SIZE * 4) // same limit as the blocking read path
+#define SEND_BUFFER_SIZE    (BUFFER_SIZE * 2) // response header plus one file chunk
+#define WAIT_TIMEOUT_NS     500000000LL       // how often an idle loop re-checks *running
+#define HELPER_THREADS      4                 // threads running the blocking handlers of non-static routes
+#define ACCEPT_BACKOFF_NS   100000000LL       // pause before accepting again when out of descriptors
+
+// Operation tags stored in the low bits of user_data. Connections are malloc'd so these bits are free
+typedef enum {
+    OP_ACCEPT = 1,
+    OP_RECV,
+    OP_READ,
+    OP_SEND,
+    OP_CLOSE,
+    OP_CANCEL,
+    OP_WAKE
+} uring_op;
+
+#define OP_MASK UINT64_C(7)
+
+typedef struct {
+    int fd;
+    unsigned features;
+
+    // Submission queue
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    unsigned sq_entries;
+    unsigned pending;   // SQEs queued since the last io_uring_enter
+
+    // Completion queue
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *ring_ptr;
+    size_t ring_size;
+    size_t sqes_size;
+
+    // Provided receive buffers
+    struct io_uring_buf_ring *buf_ring;
+    size_t buf_ring_size;
+    char *buffers;
+    unsigned short buf_tail;
+} uring;
+
+/*
+One client connection. Exactly one operation is in flight per connection at any time, so the
+connection is released when the completion of its close operation arrives.
+*/
+typedef struct connection {
+    int fd;
+    request_timing timing;
+    http_request request;
+    bool request_parsed;
+
+    // Snapshot current at accept, the whole connection is served with it
+    server_config *config;
+
+    // Idle, header or send deadline. Fires on the timer thread
+    timer_entry deadline;
+    int sending;    // deadline guards the response, not the request
+    int timed_out;
+
+    char request_buffer[REQUEST_BUFFER_SIZE];
+    size_t request_length;
+
+    // Static file being streamed
+    int file_fd;
+    off_t file_offset;
+    size_t file_remaining;
+
+    // Bytes of the response waiting to be sent
+    char send_buffer[SEND_BUFFER_SIZE];
+    size_t send_length;
+    size_t send_offset;
+
+    struct connection *prev;
+    struct connection *next;
+    struct connection *offload_next; // in the engine's offload or done list
+} connection;
+
+typedef struct {
+    uring ring;
+    int listen_fd;
+    bool accept_armed;        // an accept or its backoff timeout is pending
+    // Spare descriptor given up on EMFILE/ENFILE so the pending connection can be accepted and closed,
+    // as in the blocking accept loop. Without it accept is retried after accept_backoff
+    int reserve_fd;
+    struct __kernel_timespec accept_backoff;
+    timer_wheel *timers;
+    connection *connections; // every live connection, so they can be shut down when the engine stops
+    unsigned active;
+
+    /*
+    Requests of CGI, native and redirect routes run the blocking handlers on helper threads, started
+    with the first such request, so a slow script does not stall the loop. A helper hands the
+    connection back through done and wakes the loop with a write to wake_fd, whose read is always
+    pending on the ring. The lists are guarded by offload_lock
+    */
+    int wake_fd;
+    uint64_t wake_count;      // buffer of the pending wake_fd read
+    pthread_t helpers[HELPER_THREADS];
+    unsigned helper_count;
+    bool helpers_stopping;
+    pthread_mutex_t offload_lock;
+    pthread_cond_t offload_ready;
+    connection *offload_head; // waiting for a helper, oldest first
+    connection *offload_tail;
+    connection *done;         // handled, waiting to be closed by the loop
+} engine;
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *params) {
+    return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags, void *arg, size_t arg_size) {
+    return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, arg_size);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+    return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void uring_destroy(uring *ring) {
+    if (ring->buf_ring) munmap(ring->buf_ring, ring->buf_ring_size);
+    free(ring->buffers);
+    if (ring->sqes) munmap(ring->sqes, ring->sqes_size);
+    if (ring->ring_ptr) munmap(ring->ring_ptr, ring->ring_size);
+    if (ring->fd >= 0) close(ring->fd);
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+}
+
+/*
+Creates the ring, maps its queues and registers URING_BUFFER_COUNT receive buffers of BUFFER_SIZE bytes.
+Returns 0 on success, -1 on error (ring is left destroyed)
+*/
+static int uring_init(uring *ring) {
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring->fd = sys_io_uring_setup(URING_QUEUE_DEPTH, &params);
+    if (ring->fd < 0) {
+        LOG_ERROR("io_uring_setup failed: %s", strerror(errno));
+        return -1;
+    }
+    ring->features = params.features;
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG)) {
+        LOG_ERROR("Kernel io_uring is too old (features 0x%x)", params.features);
+        uring_destroy(ring);
+        return -1;
+    }
+
+    // With IORING_FEAT_SINGLE_MMAP the submission and completion rings share one mapping
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->ring_size = sq_size > cq_size ? sq_size : cq_size;
+    ring->ring_ptr = mmap(NULL, ring->ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          ring->fd, IORING_OFF_SQ_RING);
+    if (ring->ring_ptr == MAP_FAILED) {
+        ring->ring_ptr = NULL;
+        LOG_ERROR("Failed to map io_uring queues: %s", strerror(errno));
+        uring_destroy(ring);
+        return -1;
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        LOG_ERROR("Failed to map io_uring submission entries: %s", strerror(errno));
+        uring_destroy(ring);
+        return -1;
+    }
+
+    char *base = ring->ring_ptr;
+    ring->sq_head = (unsigned *)(base + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(base + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(base + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(base + params.sq_off.array);
+    ring->sq_entries = params.sq_entries;
+    ring->cq_head = (unsigned *)(base + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(base + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(base + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(base + params.cq_off.cqes);
+
+    // The buffer ring must be page aligned, an anonymous mapping guarantees that
+    ring->buf_ring_size = URING_BUFFER_COUNT * sizeof(struct io_uring_buf);
+    ring->buf_ring = mmap(NULL, ring->buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ring->buffers = malloc((size_t)URING_BUFFER_COUNT * BUFFER_SIZE);
+    if (ring->buf_ring == MAP_FAILED || !ring->buffers) {
+        if (ring->buf_ring == MAP_FAILED) ring->buf_ring = NULL;
+        LOG_ERROR("Failed to allocate io_uring receive buffers");
+        uring_destroy(ring);
+        return -1;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)ring->buf_ring;
+    reg.ring_entries = URING_BUFFER_COUNT;
+    reg.bgid = URING_BUFFER_GROUP;
+    if (sys_io_uring_register(ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        LOG_ERROR("Failed to register io_uring receive buffers: %s", strerror(errno));
+        uring_destroy(ring);
+        return -1;
+    }
+
+    for (unsigned short bid = 0; bid < URING_BUFFER_COUNT; ++bid) {
+        struct io_uring_buf *buf = &ring->buf_ring->bufs[ring->buf_tail & (URING_BUFFER_COUNT - 1)];
+        buf->addr = (uint64_t)(uintptr_t)(ring->buffers + (size_t)bid * BUFFER_SIZE);
+        buf->len = BUFFER_SIZE;
+        buf->bid = bid;
+        ring->buf_tail++;
+    }
+    __atomic_store_n(&ring->buf_ring->tail, ring->buf_tail, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/*
+Hands receive buffer bid back to the kernel
+*/
+static void uring_recycle_buffer(uring *ring, unsigned short bid) {
+    struct io_uring_buf *buf = &ring->buf_ring->bufs[ring->buf_tail & (URING_BUFFER_COUNT - 1)];
+    buf->addr = (uint64_t)(uintptr_t)(ring->buffers + (size_t)bid * BUFFER_SIZE);
+    buf->len = BUFFER_SIZE;
+    buf->bid = bid;
+    ring->buf_tail++;
+    __atomic_store_n(&ring->buf_ring->tail, ring->buf_tail, __ATOMIC_RELEASE);
+}
+
+/*
+Submits queued SQEs and, if wait is set, waits up to WAIT_TIMEOUT_NS for at least one completion.
+Returns 0 on success (including timeouts and signals), -1 on error
+*/
+static int uring_submit(uring *ring, bool wait) {
+    unsigned flags = IORING_ENTER_EXT_ARG;
+    struct __kernel_timespec timeout = { .tv_sec = 0, .tv_nsec = WAIT_TIMEOUT_NS };
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = (uint64_t)(uintptr_t)&timeout;
+    if (wait) flags |= IORING_ENTER_GETEVENTS;
+
+    int submitted = sys_io_uring_enter(ring->fd, ring->pending, wait ? 1 : 0, flags, &arg, sizeof(arg));
+    if (submitted < 0) {
+        if (errno == EINTR || errno == ETIME || errno == EAGAIN || errno == EBUSY) {
+            return 0;
+        }
+        LOG_ERROR("io_uring_enter failed: %s", strerror(errno));
+        return -1;
+    }
+    ring->pending -= (unsigned)submitted < ring->pending ? (unsigned)submitted : ring->pending;
+    return 0;
+}
+
+/*
+Returns a zeroed SQE, submitting the queued ones first if the submission queue is full
+*/
+static struct io_uring_sqe *uring_get_sqe(uring *ring) {
+    unsigned tail = *ring->sq_tail;
+    while (tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries) {
+        if (uring_submit(ring, false) < 0) return NULL;
+    }
+    unsigned index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->pending++;
+    return sqe;
+}
+
+static uint64_t tag(void *ptr, uring_op op) {
+    return (uint64_t)(uintptr_t)ptr | (uint64_t)op;
+}
+
+static void queue_accept(engine *eng) {
+    struct io_uring_sqe *sqe = uring_get_sqe(&eng->ring);
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = eng->listen_fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC; // CGI children must not inherit other connections
+    sqe->user_data = tag(eng, OP_ACCEPT);
+    eng->accept_armed = true;
+}
+
+/*
+Arms a timeout instead of the accept, its completion (tagged with accept_backoff rather than the engine)
+clears accept_armed so the loop arms the accept again
+*/
+static void queue_accept_backoff(engine *eng) {
+    struct io_uring_sqe *sqe = uring_get_sqe(&eng->ring);
+    if (!sqe) return;
+    eng->accept_backoff.tv_sec = 0;
+    eng->accept_backoff.tv_nsec = ACCEPT_BACKOFF_NS;
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = (uint64_t)(uintptr_t)&eng->accept_backoff;
+    sqe->len = 1;
+    sqe->user_data = tag(&eng->accept_backoff, OP_ACCEPT);
+    eng->accept_armed = true;
+}
+
+static void queue_cancel_accept(engine *eng) {
+    struct io_uring_sqe *sqe = uring_get_sqe(&eng->ring);
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = tag(eng, OP_ACCEPT);
+    sqe->user_data = tag(eng, OP_CANCEL);
+}
+
+static void queue_recv(engine *eng, connection *conn) {
+    struct io_uring_sqe *sqe = uring_get_sqe(&eng->ring);
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = conn->fd;
+    sqe->len = BUFFER_SIZE;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    sqe->user_data = tag(conn, OP_RECV);
+}
+
+/*
+Timer callback. Shutting down the read side completes a pending recv with 0 so a 408 can still be
+sent, a stalled response is cut off in both directions
+*/
+static void expire_connection(timer_entry *timer) {
+    connection *conn = (connection *)timer->arg;
+    int sending = __atomic_load_n(&conn->sending, __ATOMIC_RELAXED);
+    __atomic_store_n(&conn->timed_out, 1, __ATOMIC_RELEASE);
+    LOG_WARN("Connection fd=%d timed out while %s", conn->fd, sending ? "sending" : "reading the request");
+    shutdown(conn->fd, sending ? SHUT_RDWR : SHUT_RD);
+}
+
+static void queue_read(engine *eng, connection *conn) {
+    size_t space = SEND_BUFFER_SIZE - conn->send_length;
+    size_t length = conn->file_remaining < space ? conn->file_remaining : space;
+    struct io_uring_sqe *sqe = uring_get_sqe(&eng->ring);
+    if (!sqe) return;
+    timer_refresh(&conn->deadline);
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = conn->file_fd;
+    sqe->addr = (uint64_t)(uintptr_t)(conn->send_buffer + conn->send_length);
+    sqe->len = (unsigned)length;
+    sqe->off = (uint64_t)conn->file_offset;
+    sqe->user_data = tag(conn, OP_READ);
+}
+
+static void queue_send(engine *eng, connection *conn) {
+    struct io_uring_sqe *sqe = uring_get_sqe(&eng->ring);
+    if (!sqe) return;
+    timer_refresh(&conn->deadline);
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = conn->fd;
+    sqe->addr = (uint64_t)(uintptr_t)(conn->send_buffer + conn->send_offset);
+    sqe->len = (unsigned)(conn->send_length - conn->send_offset);
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = tag(conn, OP_SEND);
+}
+
+/*
+Reports the request to the metrics module and queues the close of the connection
+*/
+static void finish_connection(engine *eng, connection *conn) {
+    // The timer must not fire once the descriptor is closed and possibly reused
+    timer_disarm(&conn->deadline);
+    if (conn->file_fd >= 0) {
+        close(conn->file_fd);
+        conn->file_fd = -1;
+    }
+    const char *path = conn->request_parsed ? conn->request.path : NULL;
+    timing_mark(&conn->timing, PHASE_LAST_BYTE);
+    metrics_record_request(&conn->timing, path, conn->config);
+    PROBE4(request__done, conn->fd, path, conn->timing.status_code, timing_offset_ns(&conn->timing, PHASE_LAST_BYTE));
+
+    struct io_uring_sqe *sqe = uring_get_sqe(&eng->ring);
+    if (!sqe) {
+        close(conn->fd);
+        conn->fd = -1;
+        return;
+    }
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = conn->fd;
+    sqe->user_data = tag(conn, OP_CLOSE);
+}
+
+static void release_connection(engine *eng, connection *conn) {
+    if (conn->prev) conn->prev->next = conn->next;
+    else eng->connections = conn->next;
+    if (conn->next) conn->next->prev = conn->prev;
+    if (conn->request_parsed) destroy_request(&conn->request);
+    config_snapshot_release(conn->config);
+    free(conn);
+    eng->active--;
+    admission_connection_closed();
+}
+
+static void queue_wake(engine *eng) {
+    struct io_uring_sqe *sqe = uring_get_sqe(&eng->ring);
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = eng->wake_fd;
+    sqe->addr = (uint64_t)(uintptr_t)&eng->wake_count;
+    sqe->len = sizeof(eng->wake_count);
+    sqe->user_data = tag(eng, OP_WAKE);
+}
+
+static void *helper_main(void *arg) {
+    engine *eng = arg;
+    pthread_mutex_lock(&eng->offload_lock);
+    for (;;) {
+        while (!eng->offload_head && !eng->helpers_stopping) {
+            pthread_cond_wait(&eng->offload_ready, &eng->offload_lock);
+        }
+        connection *conn = eng->offload_head;
+        if (!conn) break;
+        eng->offload_head = conn->offload_next;
+        if (!eng->offload_head) eng->offload_tail = NULL;
+        pthread_mutex_unlock(&eng->offload_lock);
+
+        if (execute_request(&conn->request, conn->fd, conn->config) < 0) {
+            LOG_ERROR("Request execution failed");
+        }
+
+        pthread_mutex_lock(&eng->offload_lock);
+        conn->offload_next = eng->done;
+        eng->done = conn;
+        uint64_t one = 1;
+        ssize_t written = write(eng->wake_fd, &one, sizeof(one));
+        (void) written; // the counter only saturates after 2^64 - 1 wakeups
+    }
+    pthread_mutex_unlock(&eng->offload_lock);
+    return NULL;
+}
+
+static bool start_helpers(engine *eng) {
+    eng->wake_fd = eventfd(0, EFD_CLOEXEC);
+    if (eng->wake_fd < 0) {
+        LOG_ERROR("Failed to create the io_uring helper eventfd: %s", strerror(errno));
+        return false;
+    }
+    for (; eng->helper_count < HELPER_THREADS; eng->helper_count++) {
+        if (pthread_create(&eng->helpers[eng->helper_count], NULL, helper_main, eng) != 0) break;
+    }
+    if (eng->helper_count == 0) {
+        LOG_ERROR("Failed to start io_uring helper threads");
+        close(eng->wake_fd);
+        eng->wake_fd = -1;
+        return false;
+    }
+    queue_wake(eng);
+    return true;
+}
+
+static void stop_helpers(engine *eng) {
+    pthread_mutex_lock(&eng->offload_lock);
+    eng->helpers_stopping = true;
+    pthread_cond_broadcast(&eng->offload_ready);
+    pthread_mutex_unlock(&eng->offload_lock);
+    for (unsigned i = 0; i < eng->helper_count; ++i) pthread_join(eng->helpers[i], NULL);
+    eng->helper_count = 0;
+    if (eng->wake_fd >= 0) close(eng->wake_fd);
+    eng->wake_fd = -1;
+}
+
+/*
+Passes a request of a non-static route to the helper threads. Returns false if they cannot be
+started, the request is then handled on the loop
+*/
+static bool offload_request(engine *eng, connection *conn) {
+    if (eng->helper_count == 0 && !start_helpers(eng)) return false;
+    conn->offload_next = NULL;
+    pthread_mutex_lock(&eng->offload_lock);
+    if (eng->offload_tail) eng->offload_tail->offload_next = conn;
+    else eng->offload_head = conn;
+    eng->offload_tail = conn;
+    pthread_cond_signal(&eng->offload_ready);
+    pthread_mutex_unlock(&eng->offload_lock);
+    return true;
+}
+
+// Closes the connections the helpers are done with
+static void handle_wake(engine *eng, struct io_uring_cqe *cqe) {
+    if (cqe->res < 0 && cqe->res != -ECANCELED) {
+        LOG_ERROR("Failed to read the io_uring helper eventfd: %s", strerror(-cqe->res));
+    }
+    pthread_mutex_lock(&eng->offload_lock);
+    connection *done = eng->done;
+    eng->done = NULL;
+    pthread_mutex_unlock(&eng->offload_lock);
+    while (done) {
+        connection *next = done->offload_next;
+        finish_connection(eng, done);
+        done = next;
+    }
+    if (cqe->res != -ECANCELED) queue_wake(eng);
+}
+
+/*
+Builds the response for a complete request and starts sending it
+*/
+static void start_response(engine *eng, connection *conn) {
+    __atomic_store_n(&conn->sending, 1, __ATOMIC_RELAXED);
+    timer_arm(&conn->deadline, conn->config->send_timeout * 1000);
+
+    initialize_request(&conn->request);
+    conn->request.timing = &conn->timing;
+    conn->request.deadline = &conn->deadline;
+    conn->request_parsed = true;
+
+    http_request *parsed = parse_http_request(conn->request_buffer, &conn->request, conn->config);
+    timing_mark(&conn->timing, PHASE_PARSE_DONE);
+    if (!parsed) {
+        LOG_ERROR("Failed to parse HTTP request");
+        send_error_response(conn->fd, 400);
+        conn->timing.status_code = 400;
+        finish_connection(eng, conn);
+        return;
+    }
+
+    const route *target = conn->request.route;
+    if (target && target->action != ROUTE_STATIC) {
+        // The blocking handlers are used as they are, on a helper thread
+        if (offload_request(eng, conn)) return;
+        if (execute_request(&conn->request, conn->fd, conn->config) < 0) {
+            LOG_ERROR("Request execution failed");
+        }
+        finish_connection(eng, conn);
+        return;
+    }
+
+    PROBE2(static__start, conn->fd, conn->request.path);
+    http_response response;
+    initialize_response(&response);
+    conn->file_fd = open_static_file(&conn->request, &response, conn->config);
+    conn->timing.status_code = response.status_code;
+    ssize_t header_length;
+    if (conn->file_fd < 0) {
+        // The complete error response, body included, comes from the canned ones
+        header_length = format_error_response(response.status_code, conn->send_buffer, SEND_BUFFER_SIZE);
+    } else {
+        char *header = generate_response_header(&response);
+        header_length = header && strlen(header) <= SEND_BUFFER_SIZE ? (ssize_t) strlen(header) : -1;
+        if (header_length >= 0) memcpy(conn->send_buffer, header, (size_t) header_length);
+        free(header);
+    }
+
+    if (header_length < 0) {
+        LOG_ERROR("Error in generating response header");
+        destroy_response(&response);
+        conn->timing.status_code = 0;
+        finish_connection(eng, conn);
+        return;
+    }
+    conn->send_length = (size_t) header_length;
+    conn->send_offset = 0;
+    conn->file_offset = 0;
+    conn->file_remaining = conn->file_fd >= 0 ? response.content_length : 0;
+    PROBE4(static__done, conn->fd, conn->request.path, response.content_length, response.status_code);
+    destroy_response(&response);
+
+    // Fill the rest of the first packet with the start of the file
+    if (conn->file_remaining > 0 && conn->send_length < SEND_BUFFER_SIZE) {
+        queue_read(eng, conn);
+    } else {
+        queue_send(eng, conn);
+    }
+}
+
+static void handle_accept(engine *eng, struct io_uring_cqe *cqe) {
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        eng->accept_armed = false;
+    }
+    if (cqe->res == -EMFILE || cqe->res == -ENFILE) {
+        // Nothing was accepted and the connection is still pending, arming the accept again right away
+        // would fail the same way in a busy loop
+        if (eng->reserve_fd >= 0) {
+            LOG_WARN("Out of file descriptors, dropping a pending connection");
+            close(eng->reserve_fd);
+            int dropped_fd = accept4(eng->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+            if (dropped_fd >= 0) {
+                close(dropped_fd);
+                admission_record_fd_limit_drop();
+            }
+            eng->reserve_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+        } else if (!eng->accept_armed) {
+            LOG_WARN("Out of file descriptors, pausing accept");
+            queue_accept_backoff(eng);
+        }
+        return;
+    }
+    if (cqe->res < 0) {
+        if (cqe->res != -ECANCELED) {
+            LOG_ERROR("Failed to accept connection: %s", strerror(-cqe->res));
+        }
+        return;
+    }
+
+    int client_fd = cqe->res;
+    // Past the high watermark, closing right away is the cheapest way to say no
+    if (!admission_connection_opened()) {
+        LOG_WARN("Too many open connections, closing fd %d", client_fd);
+        close(client_fd);
+        return;
+    }
+    connection *conn = malloc(sizeof(connection));
+    if (!conn) {
+        LOG_ERROR("Failed to allocate connection state, dropping fd %d", client_fd);
+        close(client_fd);
+        admission_connection_closed();
+        return;
+    }
+    conn->fd = client_fd;
+    conn->config = config_snapshot_acquire();
+    timing_init(&conn->timing);
+    timing_mark(&conn->timing, PHASE_ACCEPT);
+    conn->request_parsed = false;
+    conn->request_length = 0;
+    conn->file_fd = -1;
+    conn->file_remaining = 0;
+    conn->send_length = 0;
+    conn->send_offset = 0;
+    conn->sending = 0;
+    conn->timed_out = 0;
+    timer_init(&conn->deadline, eng->timers, expire_connection, conn);
+    timer_arm(&conn->deadline, conn->config->keepalive_timeout * 1000);
+    conn->prev = NULL;
+    conn->next = eng->connections;
+    if (eng->connections) eng->connections->prev = conn;
+    eng->connections = conn;
+    eng->active++;
+
+    LOG_INFO("Connection accepted (fd=%d)", client_fd);
+    PROBE1(request__start, client_fd);
+    queue_recv(eng, conn);
+}
+
+static void handle_recv(engine *eng, connection *conn, struct io_uring_cqe *cqe) {
+    if (cqe->res == -ENOBUFS) {
+        // Every receive buffer is in use, try again once some are recycled
+        queue_recv(eng, conn);
+        return;
+    }
+    if (cqe->res <= 0) {
+        __atomic_store_n(&conn->sending, 1, __ATOMIC_RELAXED);
+        timer_arm(&conn->deadline, conn->config->send_timeout * 1000);
+        if (cqe->res == 0 && __atomic_load_n(&conn->timed_out, __ATOMIC_ACQUIRE)) {
+            send_error_response(conn->fd, 408);
+            conn->timing.status_code = 408;
+            finish_connection(eng, conn);
+            return;
+        }
+        LOG_ERROR("Failed to read HTTP request: %s", cqe->res == 0 ? "connection closed" : strerror(-cqe->res));
+        if (cqe->res == 0 && conn->request_length > 0) {
+            send_error_response(conn->fd, 400);
+            conn->timing.status_code = 400;
+        }
+        finish_connection(eng, conn);
+        return;
+    }
+
+    unsigned short bid = (unsigned short)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+    const char *data = eng->ring.buffers + (size_t)bid * BUFFER_SIZE;
+    size_t length = (size_t)cqe->res;
+    if (conn->request_length == 0) {
+        timing_mark(&conn->timing, PHASE_FIRST_BYTE);
+        timer_arm(&conn->deadline, conn->config->header_timeout * 1000);
+    }
+
+    if (conn->request_length + length >= REQUEST_BUFFER_SIZE) {
+        uring_recycle_buffer(&eng->ring, bid);
+        LOG_ERROR("HTTP request too large for buffer");
+        send_error_response(conn->fd, 400);
+        conn->timing.status_code = 400;
+        finish_connection(eng, conn);
+        return;
+    }
+    memcpy(conn->request_buffer + conn->request_length, data, length);
+    // The terminator can start up to 3 bytes before the new data
+    size_t scan_from = conn->request_length > 3 ? conn->request_length - 3 : 0;
+    conn->request_length += length;
+    conn->request_buffer[conn->request_length] = '\0';
+    uring_recycle_buffer(&eng->ring, bid);
+
+    const char *request_end = conn->request_buffer + conn->request_length;
+    if (scan_header_end(conn->request_buffer + scan_from, request_end) == request_end) {
+        queue_recv(eng, conn);
+        return;
+    }
+    timing_mark(&conn->timing, PHASE_HEADERS_DONE);
+    LOG_DEBUG("Complete HTTP request read (%zu bytes)", conn->request_length);
+    start_response(eng, conn);
+}
+
+static void handle_read(engine *eng, connection *conn, struct io_uring_cqe *cqe) {
+    if (cqe->res < 0) {
+        LOG_ERROR("Failed to read static file: %s", strerror(-cqe->res));
+        conn->timing.status_code = 500;
+        finish_connection(eng, conn);
+        return;
+    }
+    if (cqe->res == 0) {
+        // File shrank since it was opened, send what we have
+        conn->file_remaining = 0;
+    } else {
+        conn->send_length += (size_t)cqe->res;
+        conn->file_offset += cqe->res;
+        conn->file_remaining -= (size_t)cqe->res;
+    }
+    if (conn->send_length > conn->send_offset) {
+        queue_send(eng, conn);
+    } else {
+        finish_connection(eng, conn);
+    }
+}
+
+static void handle_send(engine *eng, connection *conn, struct io_uring_cqe *cqe) {
+    if (cqe->res < 0) {
+        LOG_ERROR("Failed to send response (fd=%d): %s", conn->fd, strerror(-cqe->res));
+        finish_connection(eng, conn);
+        return;
+    }
+    timing_mark(&conn->timing, PHASE_FIRST_RESPONSE_BYTE);
+    conn->send_offset += (size_t)cqe->res;
+    if (conn->send_offset < conn->send_length) {
+        queue_send(eng, conn);
+        return;
+    }
+    conn->send_length = 0;
+    conn->send_offset = 0;
+    if (conn->file_remaining > 0) {
+        queue_read(eng, conn);
+    } else {
+        finish_connection(eng, conn);
+    }
+}
+
+static void handle_completion(engine *eng, struct io_uring_cqe *cqe) {
+    uring_op op = (uring_op)(cqe->user_data & OP_MASK);
+    void *target = (void *)(uintptr_t)(cqe->user_data & ~OP_MASK);
+
+    switch (op) {
+        case OP_ACCEPT:
+            if (target == &eng->accept_backoff) {
+                eng->accept_armed = false;
+            } else {
+                handle_accept(eng, cqe);
+            }
+            break;
+        case OP_RECV:
+            handle_recv(eng, target, cqe);
+            break;
+        case OP_READ:
+            handle_read(eng, target, cqe);
+            break;
+        case OP_SEND:
+            handle_send(eng, target, cqe);
+            break;
+        case OP_CLOSE: {
+            connection *conn = target;
+            if (cqe->res < 0) {
+                LOG_ERROR("Failed to close client connection (fd=%d): %s", conn->fd, strerror(-cqe->res));
+            } else {
+                LOG_INFO("Client connection closed (fd=%d)", conn->fd);
+            }
+            release_connection(eng, conn);
+            break;
+        }
+        case OP_WAKE:
+            handle_wake(eng, cqe);
+            break;
+        case OP_CANCEL:
+            break;
+    }
+}
+
+int uring_engine_run(int listen_fd, timer_wheel *timers, volatile sig_atomic_t *running) {
+    engine eng;
+    memset(&eng, 0, sizeof(eng));
+    eng.listen_fd = listen_fd;
+    eng.timers = timers;
+    eng.wake_fd = -1;
+    if (uring_init(&eng.ring) < 0) {
+        return -1;
+    }
+    eng.reserve_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    pthread_mutex_init(&eng.offload_lock, NULL);
+    pthread_cond_init(&eng.offload_ready, NULL);
+    LOG_INFO("io_uring engine started on fd %d (features 0x%x)", listen_fd, eng.ring.features);
+
+    queue_accept(&eng);
+    bool stopping = false;
+    bool aborted = false;
+    struct timespec stop_time = { 0, 0 };
+    unsigned int drain_timeout = 0;
+
+    // After a shutdown request the loop keeps going until every in-flight operation has completed,
+    // because the kernel may still be writing into connection buffers until then. Connections get
+    // DrainTimeout seconds to finish before they are shut down
+    while (!stopping || eng.accept_armed || eng.active > 0) {
+        if (!stopping && !*running) {
+            stopping = true;
+            clock_gettime(CLOCK_MONOTONIC, &stop_time);
+            server_config *current = config_snapshot_acquire();
+            drain_timeout = current->drain_timeout;
+            config_snapshot_release(current);
+            if (eng.accept_armed) queue_cancel_accept(&eng);
+        }
+        if (stopping && !aborted && eng.connections) {
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            if (now.tv_sec - stop_time.tv_sec >= (time_t)drain_timeout) {
+                aborted = true;
+                for (connection *conn = eng.connections; conn; conn = conn->next) {
+                    shutdown(conn->fd, SHUT_RDWR);
+                }
+            }
+        }
+        if (!stopping && !eng.accept_armed) {
+            queue_accept(&eng);
+        }
+
+        if (uring_submit(&eng.ring, true) < 0) {
+            break;
+        }
+
+        unsigned head = *eng.ring.cq_head;
+        unsigned tail = __atomic_load_n(eng.ring.cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            struct io_uring_cqe *cqe = &eng.ring.cqes[head & *eng.ring.cq_mask];
+            handle_completion(&eng, cqe);
+        }
+        __atomic_store_n(eng.ring.cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    // Every offloaded request is done unless io_uring_enter failed, the helpers finish the rest first
+    stop_helpers(&eng);
+    pthread_mutex_destroy(&eng.offload_lock);
+    pthread_cond_destroy(&eng.offload_ready);
+    uring_destroy(&eng.ring);
+    if (eng.reserve_fd >= 0) {
+        close(eng.reserve_fd);
+    }
+    // Only reached with connections left if io_uring_enter failed, their operations died with the ring
+    while (eng.connections) {
+        connection *conn = eng.connections;
+        if (conn->file_fd >= 0) close(conn->file_fd);
+        if (conn->fd >= 0) close(conn->fd);
+        release_connection(&eng, conn);
+    }
+    LOG_INFO("io_uring engine stopped");
+    return 0;
+}
+
+#endif
@@ -0,0 +1,533 @@
+// compilation command for now
+// clang -std=c99 -Wall -Wextra -Werror -g -O2 -I./include testing/bench/bench_hot_paths.c src/http_parser.c src/request_handler.c src/config.c src/rio.c src/net.c src/metrics.c src/timer_wheel.c src/logger.c src/scan.c src/mime.c src/mime_table.c src/router.c src/path_cache.c -pthread -lm -o executables/bench_hot_paths
+//
+// Usage: ./executables/bench_hot_paths [filter] [min_seconds_per_run]
+//
+// Times the request hot paths on realistic inputs and reports, per operation:
+//    ns       median wall time over BENCH_RUNS runs
+//    allocs   heap allocations (malloc/calloc/realloc, including the ones libc makes for strdup). glibc only
+//    cycles   user-space CPU cycles from perf_event_open. Linux only and needs perf_event_paranoid <= 2
+//    instrs   user-space retired instructions, same requirements as cycles
+// Unavailable counters are printed as "-".
+//
+// Cases ending in /scalar, /sse2 or /avx2 pin the scan kernels (see scan.h) and sit next to the
+// strstr/strchr/sscanf code they replace. Kernels this CPU lacks are reported as unsupported.
+//
+// The functions under test log through LOG_*, which costs a formatted write per call. stderr is
+// redirected to /dev/null for the run so the numbers include formatting and the syscall but not a terminal.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "http_parser.h"
+#include "request_handler.h"
+#include "config.h"
+#include "rio.h"
+#include "scan.h"
+#include "path_cache.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#endif
+
+#define BENCH_RUNS 5
+#define BENCH_WARMUP_OPS 1000
+
+/* ---------- allocation counting ---------- */
+
+static volatile uint64_t allocation_count;
+
+#ifdef __GLIBC__
+// glibc routes its own internal allocations (strdup, getline, ...) through these symbols too
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+void *malloc(size_t size) {
+    allocation_count++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+    allocation_count++;
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    allocation_count++;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+#define ALLOCATION_COUNTING 1
+#endif
+
+/* ---------- hardware counters ---------- */
+
+typedef struct {
+    int cycles_fd;
+    int instructions_fd;
+} hw_counters;
+
+#ifdef __linux__
+static int open_counter(uint64_t config, int group_fd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.disabled = group_fd == -1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+#endif
+
+static void counters_open(hw_counters *counters) {
+    counters->cycles_fd = -1;
+    counters->instructions_fd = -1;
+#ifdef __linux__
+    counters->cycles_fd = open_counter(PERF_COUNT_HW_CPU_CYCLES, -1);
+    if (counters->cycles_fd >= 0) {
+        counters->instructions_fd = open_counter(PERF_COUNT_HW_INSTRUCTIONS, counters->cycles_fd);
+    }
+#endif
+}
+
+static void counters_start(hw_counters *counters) {
+#ifdef __linux__
+    if (counters->cycles_fd < 0) return;
+    ioctl(counters->cycles_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(counters->cycles_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#else
+    (void)counters;
+#endif
+}
+
+static void counters_stop(hw_counters *counters, int64_t *cycles, int64_t *instructions) {
+    *cycles = -1;
+    *instructions = -1;
+#ifdef __linux__
+    if (counters->cycles_fd < 0) return;
+    ioctl(counters->cycles_fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    uint64_t value;
+    if (read(counters->cycles_fd, &value, sizeof(value)) == sizeof(value)) *cycles = (int64_t)value;
+    if (counters->instructions_fd >= 0 &&
+        read(counters->instructions_fd, &value, sizeof(value)) == sizeof(value)) *instructions = (int64_t)value;
+#else
+    (void)counters;
+#endif
+}
+
+/* ---------- request corpora ---------- */
+
+static const char simple_request[] =
+    "GET /static/html/index.html HTTP/1.1\r\n"
+    "Host: localhost:8080\r\n"
+    "\r\n";
+
+static const char browser_request[] =
+    "GET /static/css/styles.css HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "Connection: keep-alive\r\n"
+    "sec-ch-ua: \"Chromium\";v=\"124\", \"Google Chrome\";v=\"124\", \"Not-A.Brand\";v=\"99\"\r\n"
+    "sec-ch-ua-mobile: ?0\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/124.0.0.0 Safari/537.36\r\n"
+    "sec-ch-ua-platform: \"Linux\"\r\n"
+    "Accept: text/css,*/*;q=0.1\r\n"
+    "Sec-Fetch-Site: same-origin\r\n"
+    "Sec-Fetch-Mode: no-cors\r\n"
+    "Sec-Fetch-Dest: style\r\n"
+    "Referer: https://www.example.com/static/html/index.html\r\n"
+    "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+    "Accept-Language: en-US,en;q=0.9,de;q=0.8\r\n"
+    "If-None-Match: \"5f2b-61a8c3e4d2f80\"\r\n"
+    "If-Modified-Since: Tue, 14 May 2024 08:12:31 GMT\r\n"
+    "Cookie: _ga=GA1.1.1523469874.1715672343; _ga_ABCDEF1234=GS1.1.1715672343.1.1.1715672401.0.0.0; "
+    "session_id=7c4a8d09ca3762af61e59520943dc26494f8941b; csrftoken=Vw3nQ2JmK9xLp4RtY8uZ1aB6cD0eF5gH; "
+    "preferences=%7B%22theme%22%3A%22dark%22%2C%22lang%22%3A%22en%22%2C%22tz%22%3A%22Europe%2FBerlin%22%7D\r\n"
+    "\r\n";
+
+static const char query_request[] =
+    "GET /cgi-bin/params.cgi?q=concurrent+web+server+in+c&filter%5Bcategory%5D=systems%20programming"
+    "&filter%5Btags%5D%5B%5D=epoll&filter%5Btags%5D%5B%5D=io_uring&sort=-relevance&page=3&per_page=50"
+    "&redirect=https%3A%2F%2Fwww.example.com%2Fsearch%3Fq%3Dhttp%252Fserver%26lang%3Den"
+    "&utm_source=newsletter&utm_medium=email&utm_campaign=spring_launch_2024&debug HTTP/1.1\r\n"
+    "Host: api.example.com\r\n"
+    "Accept: application/json\r\n"
+    "\r\n";
+
+static const char *mime_paths[] = {
+    "/static/html/index.html", "/static/css/styles.css", "/static/js/script.js", "/static/media/dummy.png",
+    "/static/media/dummy.webm", "/static/misc/dummy.woff2", "/static/misc/no_extension", "/static/misc/dummy.tar.gz"
+};
+// Built by build_large_request: the browser request with a few KB of cookies, the size where
+// the width of the scan kernels shows
+static char large_request[BUFFER_SIZE * 2];
+
+#define MIME_PATH_COUNT (sizeof(mime_paths) / sizeof(mime_paths[0]))
+
+/* ---------- benchmark cases ---------- */
+
+static server_config bench_config;
+static char scratch[BUFFER_SIZE * 4];
+static volatile size_t sink; // keeps results alive so the optimizer can't drop the work
+
+typedef struct {
+    const char *name;
+    void (*run)(const void *input);
+    const void *input;
+    const char *kernel; // scan kernels to pin, NULL for the detected ones
+} bench_case;
+
+static void bench_parse_http_request(const void *input) {
+    const char *corpus = (const char *)input;
+    // the parser may modify its input, so every op works on a fresh copy
+    strcpy(scratch, corpus);
+    http_request request;
+    initialize_request(&request);
+    sink += parse_http_request(scratch, &request, &bench_config) != NULL;
+    destroy_request(&request);
+}
+
+static void bench_parse_uri(const void *input) {
+    strcpy(scratch, (const char *)input);
+    http_request request;
+    initialize_request(&request);
+    sink += (size_t)parse_uri(scratch, &request, &bench_config);
+    destroy_request(&request);
+}
+
+static void bench_url_decode(const void *input) {
+    strcpy(scratch, (const char *)input);
+    sink += (size_t)url_decode(scratch);
+}
+
+static void bench_get_mime_type(const void *input) {
+    (void)input;
+    for (size_t i = 0; i < MIME_PATH_COUNT; ++i) {
+        sink += (size_t)get_mime_type(mime_paths[i]);
+    }
+}
+
+// Built by build_route_table: a deployment sized route table, a few hundred prefix, exact and extension rules
+static route_table *bench_routes;
+
+static void bench_router_match(const void *input) {
+    (void)input;
+    for (size_t i = 0; i < MIME_PATH_COUNT; ++i) {
+        sink += (size_t)router_match(bench_routes, mime_paths[i]);
+    }
+}
+
+static int readline_pipe[2];
+
+static void bench_rio_readline(const void *input) {
+    const char *corpus = (const char *)input;
+    size_t length = strlen(corpus);
+    if (write(readline_pipe[1], corpus, length) != (ssize_t)length) return;
+
+    rio_buf buf;
+    rio_init_buffer(readline_pipe[0], &buf);
+    char line[BUFFER_SIZE];
+    size_t consumed = 0;
+    while (consumed < length) {
+        ssize_t line_length = rio_buffered_readline(&buf, line, sizeof(line));
+        if (line_length <= 0) break;
+        consumed += (size_t)line_length;
+    }
+    sink += consumed;
+}
+
+static void bench_generate_response_header(const void *input) {
+    (void)input;
+    http_response response;
+    initialize_response(&response);
+    response.content_type = strdup("text/css");
+    response.content_length = 18273;
+    response.last_modified = strdup("Tue, 14 May 2024 08:12:31 GMT");
+    response.cache_control = strdup("public, max-age=3600");
+    response.etag = strdup("\"5f2b-61a8c3e4d2f80\"");
+    char *header = generate_response_header(&response);
+    sink += header ? strlen(header) : 0;
+    free(header);
+    destroy_response(&response);
+}
+
+static int devnull_fd = -1;
+
+static void bench_send_error_response(const void *input) {
+    (void)input;
+    sink += (size_t)send_error_response(devnull_fd, 404);
+}
+
+// Run from the repository root, the file is below the default DocumentRoot. A non-NULL input turns the
+// path cache on (with a TTL longer than any run), NULL turns it off
+static bool bench_path_cache_enabled;
+
+static void bench_open_static_file(const void *input) {
+    bool cached = input != NULL;
+    if (cached != bench_path_cache_enabled) {
+        if (cached) path_cache_init(1024, 3600, 3600);
+        else path_cache_destroy();
+        bench_path_cache_enabled = cached;
+    }
+    http_request request;
+    initialize_request(&request);
+    request.path = "/static/html/index.html";
+    http_response response;
+    initialize_response(&response);
+    int fd = open_static_file(&request, &response, &bench_config);
+    sink += response.content_length;
+    if (fd >= 0) close(fd);
+    destroy_response(&response);
+}
+
+/* scan kernels against the library calls they replace */
+
+// The server knows how much it has read, so the kernels get the length instead of finding the NUL
+typedef struct {
+    const char *text;
+    size_t length;
+} sized_text;
+
+static const sized_text browser_text = { browser_request, sizeof(browser_request) - 1 };
+static const sized_text query_text = { query_request, sizeof(query_request) - 1 };
+static sized_text large_text = { large_request, 0 }; // length set by build_large_request
+
+static void bench_header_end_strstr(const void *input) {
+    const char *corpus = ((const sized_text *)input)->text;
+    sink += (size_t)(strstr(corpus, "\r\n\r\n") - corpus);
+}
+
+static void bench_header_end_scan(const void *input) {
+    const sized_text *corpus = (const sized_text *)input;
+    sink += (size_t)(scan_header_end(corpus->text, corpus->text + corpus->length) - corpus->text);
+}
+
+static void bench_request_line_sscanf(const void *input) {
+    char method[16], uri[BUFFER_SIZE], version[16];
+    sink += (size_t)sscanf(((const sized_text *)input)->text, "%15s %8191s %15s", method, uri, version);
+}
+
+static void bench_request_line_scan(const void *input) {
+    const char *corpus = ((const sized_text *)input)->text;
+    const char *end = corpus + ((const sized_text *)input)->length;
+    const char *line_end = scan_find_pair(corpus, end, '\r', '\n');
+    const char *cursor = corpus;
+    for (int token = 0; token < 3 && cursor < line_end; ++token) {
+        const char *stop = scan_find_either(cursor, line_end, ' ', '\t');
+        sink += (size_t)(stop - cursor);
+        cursor = stop + 1;
+    }
+}
+
+// Finds the colon and the end of every header line
+static void bench_header_lines_strchr(const void *input) {
+    const char *line = strstr(((const sized_text *)input)->text, "\r\n") + 2;
+    while (*line != '\r') {
+        const char *colon = strchr(line, ':');
+        const char *line_end = strchr(colon, '\n');
+        sink += (size_t)(colon - line);
+        line = line_end + 1;
+    }
+}
+
+static void bench_header_lines_scan(const void *input) {
+    const char *corpus = ((const sized_text *)input)->text;
+    const char *end = corpus + ((const sized_text *)input)->length;
+    const char *line = scan_find_pair(corpus, end, '\r', '\n') + 2;
+    while (*line != '\r') {
+        const char *colon = scan_find_either(line, end, ':', '\n');
+        const char *line_end = scan_find_either(colon, end, '\n', '\n');
+        sink += (size_t)(colon - line);
+        line = line_end + 1;
+    }
+}
+
+static void build_large_request(void) {
+    size_t length = strlen(browser_request) - 2; // without the blank line
+    memcpy(large_request, browser_request, length);
+    length += (size_t)sprintf(large_request + length, "X-Tracking: ");
+    while (length < sizeof(large_request) - 64) {
+        length += (size_t)sprintf(large_request + length, "segment_%04zu=a3f9c2e71b; ", length);
+    }
+    strcpy(large_request + length, "end=1\r\n\r\n");
+    large_text.length = strlen(large_request);
+}
+
+static void build_route_table(void) {
+    bench_routes = router_create();
+    char pattern[64];
+    for (int i = 0; i < 100; ++i) {
+        snprintf(pattern, sizeof(pattern), "/app%03d/*", i);
+        router_add(bench_routes, pattern, "static cache=max-age=60");
+        snprintf(pattern, sizeof(pattern), "/app%03d/api/*", i);
+        router_add(bench_routes, pattern, "cgi");
+        snprintf(pattern, sizeof(pattern), "/static/legacy/page%03d.html", i);
+        router_add(bench_routes, pattern, "redirect /static/html/index.html");
+    }
+    router_add(bench_routes, "/static/*", "static cache=public,max-age=86400");
+    router_add(bench_routes, "/static/media/*", "static");
+    router_add(bench_routes, "*.gz", "static");
+    router_compile(bench_routes);
+}
+
+#define SCAN_CASES(name, run, input) \
+    { name "/scalar", run, input, "scalar" }, \
+    { name "/sse2",   run, input, "sse2" }, \
+    { name "/avx2",   run, input, "avx2" }
+
+// The decoded forms of the query corpus URI and a path with no escapes at all
+static const char encoded_uri[] =
+    "/cgi-bin/params.cgi?q=concurrent+web+server+in+c&filter%5Bcategory%5D=systems%20programming"
+    "&redirect=https%3A%2F%2Fwww.example.com%2Fsearch%3Fq%3Dhttp%252Fserver%26lang%3Den&utm_source=newsletter";
+static const char plain_uri[] = "/static/media/a/rather/long/path/to/some/deeply/nested/asset/bundle.min.js";
+
+static const bench_case cases[] = {
+    { "parse_http_request/simple",   bench_parse_http_request, simple_request, NULL },
+    { "parse_http_request/browser",  bench_parse_http_request, browser_request, NULL },
+    { "parse_http_request/query",    bench_parse_http_request, query_request, NULL },
+    { "parse_uri/static",            bench_parse_uri, plain_uri, NULL },
+    { "parse_uri/query",             bench_parse_uri, encoded_uri, NULL },
+    { "url_decode/plain",            bench_url_decode, plain_uri, NULL },
+    { "url_decode/escaped",          bench_url_decode, encoded_uri, NULL },
+    { "get_mime_type/x8",            bench_get_mime_type, NULL, NULL },
+    { "router_match/303routes/x8",   bench_router_match, NULL, NULL },
+    { "rio_buffered_readline/browser", bench_rio_readline, browser_request, NULL },
+    { "generate_response_header",    bench_generate_response_header, NULL, NULL },
+    { "send_error_response/404",     bench_send_error_response, NULL, NULL },
+    { "open_static_file/uncached",   bench_open_static_file, NULL, NULL },
+    { "open_static_file/cached",     bench_open_static_file, "cached", NULL },
+    { "parse_http_request/large",    bench_parse_http_request, large_request, NULL },
+    SCAN_CASES("parse_http_request/large", bench_parse_http_request, large_request),
+    { "header_end/browser/strstr",   bench_header_end_strstr, &browser_text, NULL },
+    SCAN_CASES("header_end/browser", bench_header_end_scan, &browser_text),
+    { "header_end/large/strstr",     bench_header_end_strstr, &large_text, NULL },
+    SCAN_CASES("header_end/large", bench_header_end_scan, &large_text),
+    { "request_line/query/sscanf",   bench_request_line_sscanf, &query_text, NULL },
+    SCAN_CASES("request_line/query", bench_request_line_scan, &query_text),
+    { "header_lines/large/strchr",   bench_header_lines_strchr, &large_text, NULL },
+    SCAN_CASES("header_lines/large", bench_header_lines_scan, &large_text),
+    SCAN_CASES("url_decode/plain", bench_url_decode, plain_uri),
+    SCAN_CASES("url_decode/escaped", bench_url_decode, encoded_uri),
+};
+#define CASE_COUNT (sizeof(cases) / sizeof(cases[0]))
+
+/* ---------- harness ---------- */
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+typedef struct {
+    double ns;
+    double allocations;
+    double cycles;
+    double instructions;
+} bench_result;
+
+static int compare_results(const void *a, const void *b) {
+    double x = ((const bench_result *)a)->ns, y = ((const bench_result *)b)->ns;
+    return (x > y) - (x < y);
+}
+
+static bench_result run_case(const bench_case *bench, double min_seconds, hw_counters *counters) {
+    for (int i = 0; i < BENCH_WARMUP_OPS; ++i) bench->run(bench->input);
+
+    // Grow the op count until a run takes long enough to time reliably
+    uint64_t ops = 1000;
+    while (true) {
+        uint64_t start = now_ns();
+        for (uint64_t i = 0; i < ops; ++i) bench->run(bench->input);
+        double elapsed = (double)(now_ns() - start) / 1e9;
+        if (elapsed >= min_seconds || ops >= (1ULL << 32)) break;
+        ops = elapsed > 0 ? (uint64_t)((double)ops * min_seconds * 1.2 / elapsed) + 1 : ops * 10;
+    }
+
+    bench_result runs[BENCH_RUNS];
+    for (int run = 0; run < BENCH_RUNS; ++run) {
+        uint64_t allocations_before = allocation_count;
+        counters_start(counters);
+        uint64_t start = now_ns();
+        for (uint64_t i = 0; i < ops; ++i) bench->run(bench->input);
+        uint64_t elapsed = now_ns() - start;
+        int64_t cycles, instructions;
+        counters_stop(counters, &cycles, &instructions);
+
+        runs[run].ns = (double)elapsed / (double)ops;
+        runs[run].allocations = (double)(allocation_count - allocations_before) / (double)ops;
+        runs[run].cycles = cycles >= 0 ? (double)cycles / (double)ops : -1;
+        runs[run].instructions = instructions >= 0 ? (double)instructions / (double)ops : -1;
+    }
+    qsort(runs, BENCH_RUNS, sizeof(bench_result), compare_results);
+    return runs[BENCH_RUNS / 2];
+}
+
+static void print_metric(double value) {
+    if (value < 0) printf(" %10s", "-");
+    else printf(" %10.1f", value);
+}
+
+int main(int argc, char **argv) {
+    const char *filter = argc > 1 ? argv[1] : NULL;
+    double min_seconds = argc > 2 ? atof(argv[2]) : 0.2;
+    if (min_seconds <= 0) min_seconds = 0.2;
+
+    if (!freopen("/dev/null", "w", stderr)) {
+        fprintf(stdout, "warning: could not silence stderr, LOG_* output will skew results\n");
+    }
+
+    config_init(&bench_config);
+    build_large_request();
+    build_route_table();
+    devnull_fd = open("/dev/null", O_WRONLY);
+    if (pipe(readline_pipe) < 0) {
+        perror("pipe");
+        return 1;
+    }
+
+    hw_counters counters;
+    counters_open(&counters);
+
+    printf("%-34s %10s %10s %10s %10s\n", "benchmark", "ns/op", "allocs/op", "cycles/op", "instrs/op");
+    for (size_t i = 0; i < CASE_COUNT; ++i) {
+        if (filter && !strstr(cases[i].name, filter)) continue;
+        if (scan_select_kernel(cases[i].kernel) < 0) {
+            printf("%-34s %10s\n", cases[i].name, "unsupported");
+            continue;
+        }
+        bench_result result = run_case(&cases[i], min_seconds, &counters);
+        printf("%-34s", cases[i].name);
+        print_metric(result.ns);
+#ifdef ALLOCATION_COUNTING
+        print_metric(result.allocations);
+#else
+        print_metric(-1);
+#endif
+        print_metric(result.cycles);
+        print_metric(result.instructions);
+        printf("\n");
+        fflush(stdout);
+    }
+
+    close(devnull_fd);
+    close(readline_pipe[0]);
+    close(readline_pipe[1]);
+    path_cache_destroy();
+    router_destroy(bench_routes);
+    config_cleanup(&bench_config);
+    return 0;
+}
@@ -1,13 +1,19 @@
 // compilation command for now
-// clang -std=c99 -Wall -Wextra -Werror -g -O0 -I./include -I./testing $(pkg-config --cflags check) testing/unit/test_http_parser.c src/http_parser.c src/config.c src/rio.c $(pkg-config --libs check) -pthread -lm -o executables/test_http_parser
+// clang -std=c99 -Wall -Wextra -Werror -g -O0 -I./include -I./testing $(pkg-config --cflags check) testing/unit/test_http_parser.c src/http_parser.c src/config.c src/rio.c src/logger.c src/scan.c src/mime.c src/mime_table.c src/router.c $(pkg-config --libs check) -pthread -lm -o executables/test_http_parser
 #include <check.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 #include "http_parser.h"
+#include "scan.h"
 #include "rio.h"
 #include "logger.h"
 #include "config.h"
 
+// Parameters are views of the request buffer, not NUL terminated strings
+#define ck_assert_view_eq(view, text) ck_assert_msg(str_view_equals((view), (text)), \
+    "Assertion '%s == \"%s\"' failed: got \"%.*s\"", #view, (text), (int) (view).length, (view).data)
+
 /* Test fixture setup and teardown */
 static http_request request;
 static server_config config;
@@ -85,6 +91,14 @@ START_TEST(test_url_decode_invalid_hex)
 }
 END_TEST
 
+START_TEST(test_url_decode_hex_digits_only)
+{
+    char str[] = "%2f%2F%+1%-1%0x%4";  // both cases decode, signs and 0x are not hex digits (the + still becomes a space)
+    ck_assert_int_eq(url_decode(str), 0);
+    ck_assert_str_eq(str, "//% 1%-1%0x%4");
+}
+END_TEST
+
 START_TEST(test_url_decode_mixed_valid_invalid)
 {
     char str[] = "Test%20with%ZZmixed%2G%21sequences";
@@ -139,6 +153,35 @@ START_TEST(test_mime_type_unusual_extensions)
 }
 END_TEST
 
+START_TEST(test_mime_types_file)
+{
+    char path[] = "/tmp/test_mime_types_XXXXXX";
+    int fd = mkstemp(path);
+    ck_assert_int_ge(fd, 0);
+    const char *types = "# comment\n"
+                        "application/gzip gz TGZ\n"
+                        "text/plain md # overrides the built-in text/markdown\n"
+                        "text/html shtml\n";
+    ck_assert_int_eq(write(fd, types, strlen(types)), (ssize_t) strlen(types));
+    close(fd);
+
+    ck_assert_int_eq(mime_load_types(path), 4);
+    unlink(path);
+    const mime_entry *gzip = mime_for_path("/static/misc/dummy.tar.gz");
+    ck_assert_int_eq(gzip->type, MIME_OTHER);
+    ck_assert_str_eq(gzip->header, "Content-Type: application/gzip\r\n");
+    ck_assert_ptr_eq(mime_for_path("bundle.tgz"), gzip);
+    ck_assert_str_eq(mime_for_path("README.md")->name, "text/plain");
+    ck_assert_int_eq(get_mime_type("page.shtml"), TEXT_HTML); // loaded names map back to built-in types
+    ck_assert_int_eq(get_mime_type("index.html"), TEXT_HTML); // built-in types still found
+
+    mime_unload_types();
+    ck_assert_str_eq(mime_for_path("README.md")->name, "text/markdown");
+    ck_assert_int_eq(get_mime_type("archive.gz"), APPLICATION_OCTET_STREAM);
+    ck_assert_int_eq(mime_load_types("/nonexistent/mime.types"), -1);
+}
+END_TEST
+
 START_TEST(test_mime_type_dot_only)
 {
     ck_assert_int_eq(get_mime_type("."), TEXT_PLAIN); // Just a dot
@@ -165,11 +208,15 @@ START_TEST(test_parse_uri_dynamic)
     ck_assert_int_eq(parse_uri(uri, &request, &config), 0);
     ck_assert_str_eq(request.path, "/cgi-bin/script.cgi");
     ck_assert_int_eq(request.is_dynamic, true);
+    ck_assert_view_eq(request.query, "name=value&flag");
+    // The parameters are only split out on demand
+    ck_assert_int_eq(request.param_count, 0);
+    ck_assert_int_eq(parse_query_params(&request), 2);
     ck_assert_int_eq(request.param_count, 2);
-    ck_assert_str_eq(request.param_names[0], "name");
-    ck_assert_str_eq(request.param_values[0], "value");
-    ck_assert_str_eq(request.param_names[1], "flag");
-    ck_assert_str_eq(request.param_values[1], "");
+    ck_assert_view_eq(request.param_names[0], "name");
+    ck_assert_view_eq(request.param_values[0], "value");
+    ck_assert_view_eq(request.param_names[1], "flag");
+    ck_assert_view_eq(request.param_values[1], "");
 }
 END_TEST
 
@@ -199,17 +246,33 @@ START_TEST(test_parse_uri_complex_query)
     ck_assert_int_eq(parse_uri(uri, &request, &config), 0);
     ck_assert_str_eq(request.path, "/cgi-bin/script.cgi");
     ck_assert_int_eq(request.is_dynamic, true);
+    ck_assert_int_eq(parse_query_params(&request), 5);
     ck_assert_int_eq(request.param_count, 5);
-    ck_assert_str_eq(request.param_names[0], "param1");
-    ck_assert_str_eq(request.param_values[0], "value1");
-    ck_assert_str_eq(request.param_names[1], "param2");
-    ck_assert_str_eq(request.param_values[1], "value with spaces");
-    ck_assert_str_eq(request.param_names[2], "empty");
-    ck_assert_str_eq(request.param_values[2], "");
-    ck_assert_str_eq(request.param_names[3], "");
-    ck_assert_str_eq(request.param_values[3], "noname");
-    ck_assert_str_eq(request.param_names[4], "novalue");
-    ck_assert_str_eq(request.param_values[4], "");
+    ck_assert_view_eq(request.param_names[0], "param1");
+    ck_assert_view_eq(request.param_values[0], "value1");
+    ck_assert_view_eq(request.param_names[1], "param2");
+    ck_assert_view_eq(request.param_values[1], "value with spaces");
+    ck_assert_view_eq(request.param_names[2], "empty");
+    ck_assert_view_eq(request.param_values[2], "");
+    ck_assert_view_eq(request.param_names[3], "");
+    ck_assert_view_eq(request.param_values[3], "noname");
+    ck_assert_view_eq(request.param_names[4], "novalue");
+    ck_assert_view_eq(request.param_values[4], "");
+    // Decoding the parameters leaves the query as it was sent, a second call reuses them
+    ck_assert_view_eq(request.query, "param1=value1&param2=value%20with%20spaces&empty=&=noname&novalue");
+    ck_assert_int_eq(parse_query_params(&request), 5);
+}
+END_TEST
+
+START_TEST(test_parse_uri_escaped_question_mark)
+{
+    // Only a literal '?' starts the query, an escaped one is part of the path
+    char uri[] = "/static/what%3F.html?q=%3F";
+    ck_assert_int_eq(parse_uri(uri, &request, &config), 0);
+    ck_assert_str_eq(request.path, "/static/what?.html");
+    ck_assert_view_eq(request.query, "q=%3F");
+    ck_assert_int_eq(parse_query_params(&request), 1);
+    ck_assert_view_eq(request.param_values[0], "?");
 }
 END_TEST
 
@@ -223,6 +286,137 @@ START_TEST(test_parse_uri_root)
 }
 END_TEST
 
+START_TEST(test_normalize_path)
+{
+    char collapsed[] = "//static//./css/../js///app.js";
+    ck_assert_int_eq(normalize_path(collapsed), 0);
+    ck_assert_str_eq(collapsed, "/static/js/app.js");
+    
+    // A path naming a directory keeps its trailing slash
+    char directory[] = "/static/css/..";
+    ck_assert_int_eq(normalize_path(directory), 0);
+    ck_assert_str_eq(directory, "/static/");
+    char root[] = "/a/b/../../.";
+    ck_assert_int_eq(normalize_path(root), 0);
+    ck_assert_str_eq(root, "/");
+    
+    // Dots that are part of a name stay
+    char dotted[] = "/.well-known/..hidden/a..b";
+    ck_assert_int_eq(normalize_path(dotted), 0);
+    ck_assert_str_eq(dotted, "/.well-known/..hidden/a..b");
+    
+    char escape[] = "/static/../../etc/passwd";
+    ck_assert_int_eq(normalize_path(escape), -1);
+    char control[] = "/static/a\tb";
+    ck_assert_int_eq(normalize_path(control), -1);
+    char relative[] = "static/index.html";
+    ck_assert_int_eq(normalize_path(relative), -1);
+}
+END_TEST
+
+/* Test cases for the router */
+START_TEST(test_router_match)
+{
+    route_table *table = router_create();
+    ck_assert_ptr_nonnull(table);
+    ck_assert_int_eq(router_add(table, "/*", "static"), 0);
+    ck_assert_int_eq(router_add(table, "/docs/*", "static ./public/static cache=max-age=60 compress"), 0);
+    ck_assert_int_eq(router_add(table, "/docs/api/*", "cgi"), 0);
+    ck_assert_int_eq(router_add(table, "/docs/api/index.html", "native status"), 0);
+    ck_assert_int_eq(router_add(table, "*.CGI", "cgi"), 0);
+    ck_assert_int_eq(router_add(table, "/old/*", "redirect /new/ 308"), 0);
+    ck_assert_int_eq(router_add(table, "/docs/*", "cgi"), 0); // listed twice, the first rule stays
+    // Malformed routes are rejected
+    ck_assert_int_eq(router_add(table, "docs", "static"), -1);
+    ck_assert_int_eq(router_add(table, "/a*b", "static"), -1);
+    ck_assert_int_eq(router_add(table, "/x", "proxy"), -1);
+    ck_assert_int_eq(router_add(table, "/x", "native nosuchhandler"), -1);
+    ck_assert_int_eq(router_add(table, "/x", "redirect"), -1);
+    ck_assert_int_eq(router_add(table, "/x", "redirect /y 200"), -1);
+    ck_assert_uint_eq(router_count(table), 7);
+    ck_assert_ptr_null(router_match(table, "/docs/")); // nothing matches before compiling
+    ck_assert_int_eq(router_compile(table), 0);
+
+    const route *docs = router_match(table, "/docs/guide.html");
+    ck_assert_ptr_nonnull(docs);
+    ck_assert_str_eq(docs->pattern, "/docs/*");
+    ck_assert_int_eq(docs->match, MATCH_PREFIX);
+    ck_assert_int_eq(docs->action, ROUTE_STATIC);
+    ck_assert_str_eq(docs->root, "./public/static/");
+    ck_assert_str_eq(docs->cache_control, "max-age=60");
+    ck_assert(docs->compress);
+    ck_assert_ptr_eq(router_match(table, "/docs/"), docs);
+    ck_assert_str_eq(router_match(table, "/docs")->pattern, "/*"); // "/docs/*" needs the slash
+    // The longest prefix wins, an exact route beats both and an extension route beats prefixes
+    ck_assert_str_eq(router_match(table, "/docs/api/v1")->pattern, "/docs/api/*");
+    ck_assert_int_eq(router_match(table, "/docs/api/index.html")->action, ROUTE_NATIVE);
+    ck_assert_str_eq(router_match(table, "/docs/run.cgi")->pattern, "*.CGI");
+    ck_assert_str_eq(router_match(table, "/docs/run.Cgi")->pattern, "*.CGI");
+    ck_assert_str_eq(router_match(table, "/docs/run.cgi.bak")->pattern, "/docs/*");
+    ck_assert_str_eq(router_match(table, "/run.d/file")->pattern, "/*"); // dots in directories don't count
+    const route *old = router_match(table, "/old/page");
+    ck_assert_int_eq(old->action, ROUTE_REDIRECT);
+    ck_assert_str_eq(old->location, "/new/");
+    ck_assert_int_eq(old->redirect_status, 308);
+    router_destroy(table);
+
+    // Without a catch-all route unmatched paths have none, "/" is an exact pattern
+    table = router_create();
+    ck_assert_int_eq(router_add(table, "/a", "static"), 0);
+    ck_assert_int_eq(router_add(table, "/", "static"), 0);
+    ck_assert_int_eq(router_compile(table), 0);
+    ck_assert_ptr_null(router_match(table, "/ab"));
+    ck_assert_ptr_null(router_match(table, "/b"));
+    ck_assert_str_eq(router_match(table, "/")->pattern, "/");
+    router_destroy(table);
+}
+END_TEST
+
+START_TEST(test_routes_from_config)
+{
+    char path[] = "/tmp/test_routes_XXXXXX";
+    int fd = mkstemp(path);
+    ck_assert_int_ge(fd, 0);
+    const char *ini = "[Server]\n"
+                      "Port = 8080\n"
+                      "DocumentRoot = ./public/\n"
+                      "[Routes]\n"
+                      "/cgi-bin/legacy/* = static\n"
+                      "/scripts/* = cgi\n"
+                      "no-leading-slash = static\n"
+                      "[Monitoring]\n"
+                      "StatusUri = /stats\n";
+    ck_assert_int_eq(write(fd, ini, strlen(ini)), (ssize_t) strlen(ini));
+    close(fd);
+
+    server_config loaded;
+    config_init(&loaded);
+    ck_assert(config_load(&loaded, path));
+    unlink(path);
+    // Two configured routes, plus the CGI directory (with and without the slash) and the status page
+    ck_assert_uint_eq(router_count(loaded.routes), 5);
+
+    char scripts[] = "/scripts/run.sh?a=1";
+    ck_assert_int_eq(parse_uri(scripts, &request, &loaded), 0);
+    ck_assert(request.is_dynamic);
+    char legacy[] = "/cgi-bin/legacy/page.html";
+    ck_assert_int_eq(parse_uri(legacy, &request, &loaded), 0);
+    ck_assert(!request.is_dynamic);
+    ck_assert_int_eq(request.route->action, ROUTE_STATIC);
+    char cgi[] = "/cgi-bin/test.cgi";
+    ck_assert_int_eq(parse_uri(cgi, &request, &loaded), 0);
+    ck_assert(request.is_dynamic);
+    char stats[] = "/stats";
+    ck_assert_int_eq(parse_uri(stats, &request, &loaded), 0);
+    ck_assert_int_eq(request.route->action, ROUTE_NATIVE);
+    ck_assert_int_eq(request.route->native, NATIVE_STATUS);
+    char plain[] = "/static/index.html";
+    ck_assert_int_eq(parse_uri(plain, &request, &loaded), 0);
+    ck_assert_ptr_null(request.route);
+    config_cleanup(&loaded);
+}
+END_TEST
+
 /* Test cases for parse_http_request function */
 START_TEST(test_parse_http_request_valid)
 {
@@ -287,6 +481,110 @@ START_TEST(test_parse_http_request_invalid_uri_path)
 }
 END_TEST
 
+START_TEST(test_parse_http_request_control_characters)
+{
+    // A bare LF in the target would let the query of a redirect add response headers
+    char split[] = "GET /old/x?a\nSet-Cookie:evil=1 HTTP/1.1\r\nHost: example.com\r\n\r\n";
+    ck_assert_ptr_null(parse_http_request(split, &request, &config));
+    char carriage_return[] = "GET /a\rb HTTP/1.1\r\n\r\n";
+    ck_assert_ptr_null(parse_http_request(carriage_return, &request, &config));
+    char delete[] = "GET /a?b=\x7f HTTP/1.1\r\n\r\n";
+    ck_assert_ptr_null(parse_http_request(delete, &request, &config));
+    // Escaped in the query they stay escaped, the query is never decoded in place
+    char escaped[] = "GET /a?c=%0D%0A HTTP/1.1\r\n\r\n";
+    ck_assert_ptr_nonnull(parse_http_request(escaped, &request, &config));
+    ck_assert_view_eq(request.query, "c=%0D%0A");
+}
+END_TEST
+
+/* Test cases for parse_request_headers function */
+START_TEST(test_parse_headers_known)
+{
+    char request_str[] = "GET /index.html HTTP/1.1\r\nhOST:  example.com \r\nAccept-Encoding:gzip, br\r\n\r\n";
+    ck_assert_ptr_nonnull(parse_http_request(request_str, &request, &config));
+    ck_assert_int_eq(request.headers.count, 2);
+    ck_assert_int_eq(request.headers.entries[0].id, HEADER_HOST);
+    ck_assert_view_eq(*get_request_header(&request.headers, HEADER_HOST), "example.com");
+    ck_assert_view_eq(*get_request_header(&request.headers, HEADER_ACCEPT_ENCODING), "gzip, br");
+    ck_assert_ptr_null(get_request_header(&request.headers, HEADER_RANGE));
+}
+END_TEST
+
+START_TEST(test_parse_headers_other)
+{
+    char headers[] = "X-Request-Id: 42\r\nHost: a\r\nHost: b\r\nHosts: c\r\n\r\n";
+    ck_assert_int_eq(parse_request_headers(headers, &request.headers), 0);
+    ck_assert_int_eq(request.headers.count, 4);
+    ck_assert_view_eq(*find_request_header(&request.headers, "x-request-id"), "42");
+    ck_assert_view_eq(*get_request_header(&request.headers, HEADER_HOST), "a"); // first one wins
+    ck_assert_int_eq(request.headers.entries[3].id, HEADER_OTHER);
+    ck_assert_ptr_null(find_request_header(&request.headers, "Missing"));
+}
+END_TEST
+
+START_TEST(test_parse_headers_malformed)
+{
+    ck_assert_int_eq(parse_request_headers("NoColon\r\n\r\n", &request.headers), -1);
+    ck_assert_int_eq(parse_request_headers(": empty name\r\n\r\n", &request.headers), -1);
+    ck_assert_int_eq(parse_request_headers("Bad Name: x\r\n\r\n", &request.headers), -1);
+
+    char many[MAX_REQUEST_HEADERS * 8 + 16] = "";
+    for (int i = 0; i <= MAX_REQUEST_HEADERS; i++) {
+        strcat(many, "A: b\r\n");
+    }
+    strcat(many, "\r\n");
+    ck_assert_int_eq(parse_request_headers(many, &request.headers), -1);
+}
+END_TEST
+
+START_TEST(test_scan_kernels_agree)
+{
+    // Every kernel must find the same position for each start offset, including the block tails
+    const char text[] = "GET /a%20b+c HTTP/1.1\r\nHost: example.com\r\nX-Long: aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
+                        "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa\r\r\n\r\n";
+    const char *end = text + sizeof(text) - 1;
+    const char *kernels[] = { "sse2", "avx2" };
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        for (const char *start = text; start <= end; start++) {
+            ck_assert_int_eq(scan_select_kernel("scalar"), 0);
+            const char *either = scan_find_either(start, end, ':', '%');
+            const char *pair = scan_find_pair(start, end, '\r', '\n');
+            const char *header_end = scan_header_end(start, end);
+            if (scan_select_kernel(kernels[k]) < 0) break; // not supported by this CPU or build
+            ck_assert_ptr_eq(scan_find_either(start, end, ':', '%'), either);
+            ck_assert_ptr_eq(scan_find_pair(start, end, '\r', '\n'), pair);
+            ck_assert_ptr_eq(scan_header_end(start, end), header_end);
+        }
+    }
+    ck_assert_ptr_eq(scan_header_end(text, end), end - 4);
+    scan_select_kernel(NULL);
+}
+END_TEST
+
+START_TEST(test_scan_kernels_agree_long)
+{
+    // Past the first KB the vector kernels hand over to memchr, a match can straddle the handover
+    char text[1200];
+    memset(text, 'a', sizeof(text));
+    memcpy(text + 1000, "\r\n", 2);
+    memcpy(text + 1080, "%\r\n\r\n", 5);
+    const char *end = text + sizeof(text);
+    const char *kernels[] = { "sse2", "avx2" };
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        for (const char *start = text; start <= text + 80; start++) {
+            ck_assert_int_eq(scan_select_kernel("scalar"), 0);
+            const char *either = scan_find_either(start, end, ':', '%');
+            const char *pair = scan_find_pair(start, end, '\r', '\n');
+            if (scan_select_kernel(kernels[k]) < 0) break; // not supported by this CPU or build
+            ck_assert_ptr_eq(scan_find_either(start, end, ':', '%'), either);
+            ck_assert_ptr_eq(scan_find_pair(start, end, '\r', '\n'), pair);
+            ck_assert_ptr_eq(scan_header_end(start, end), text + 1081);
+        }
+    }
+    scan_select_kernel(NULL);
+}
+END_TEST
+
 START_TEST(test_initialize_destroy_request)
 {
     http_request test_req;
@@ -301,21 +599,23 @@ START_TEST(test_initialize_destroy_request)
     ck_assert_int_eq(test_req.version, HTTP_1_1);
     ck_assert_int_eq(test_req.is_dynamic, false);
     
-    // Setup a request with allocated resources
-    test_req.path = strdup("/test.html");
-    test_req.param_count = 2;
-    test_req.param_names = malloc(2 * sizeof(char*));
-    test_req.param_values = malloc(2 * sizeof(char*));
-    test_req.param_names[0] = strdup("name1");
-    test_req.param_values[0] = strdup("value1");
-    test_req.param_names[1] = strdup("name2");
-    test_req.param_values[1] = strdup("value2");
+    // Setup a request with allocated resources, the path and parameters point into the request buffer
+    server_config test_config;
+    config_init(&test_config);
+    char uri[] = "/cgi-bin/test.cgi?name1=value1&name2=value2";
+    ck_assert_int_eq(parse_uri(uri, &test_req, &test_config), 0);
+    config_cleanup(&test_config);
+    ck_assert_int_eq(parse_query_params(&test_req), 2);
+    ck_assert_view_eq(test_req.query, "name1=value1&name2=value2");
     
     // Test destruction
     destroy_request(&test_req);
     
-    // After destruction, pointers should be freed, but struct still exists
-    // We can't easily check if memory was freed, but we can ensure no crashes
+    // After destruction the parameter arrays are freed and reset, the buffer is untouched
+    ck_assert_ptr_null(test_req.param_names);
+    ck_assert_ptr_null(test_req.param_values);
+    ck_assert_int_eq(test_req.param_count, 0);
+    ck_assert_str_eq(test_req.path, "/cgi-bin/test.cgi");
 }
 END_TEST
 
@@ -506,9 +806,9 @@ START_TEST(test_many_query_parameters)
     // Should handle this gracefully
     http_request *result = parse_http_request(request_str, &request, &config);
     
-    free(request_str);
-    
     ck_assert_ptr_nonnull(result);
+    ck_assert_int_eq(parse_query_params(&request), 100);
+    free(request_str);
     ck_assert_int_eq(request.param_count, 100);
     ck_assert_ptr_nonnull(request.param_names);
     ck_assert_ptr_nonnull(request.param_values);
@@ -595,8 +895,10 @@ START_TEST(test_malformed_http_request)
         teardown();
         setup();
         
-        // We just want to make sure it doesn't crash
-        parse_http_request(malformed_requests[i], &request, &config);
+        // We just want to make sure it doesn't crash. The parser works in place, so it gets a writable copy
+        char buffer[256];
+        strcpy(buffer, malformed_requests[i]);
+        parse_http_request(buffer, &request, &config);
         
         // Whether it succeeds or fails, we just want it to handle the case
         // No assertion here - we're just checking it doesn't crash
@@ -624,6 +926,7 @@ Suite *http_parser_suite(void)
     tcase_add_test(tc_url_decode, test_url_decode_trailing_percent);
     tcase_add_test(tc_url_decode, test_url_decode_invalid_hex);
     tcase_add_test(tc_url_decode, test_url_decode_mixed_valid_invalid);
+    tcase_add_test(tc_url_decode, test_url_decode_hex_digits_only);
     suite_add_tcase(s, tc_url_decode);
     
     // Test case for MIME type detection
@@ -636,6 +939,7 @@ Suite *http_parser_suite(void)
     tcase_add_test(tc_mime_type, test_mime_type_multiple_extensions);
     tcase_add_test(tc_mime_type, test_mime_type_unusual_extensions);
     tcase_add_test(tc_mime_type, test_mime_type_dot_only);
+    tcase_add_test(tc_mime_type, test_mime_types_file);
     suite_add_tcase(s, tc_mime_type);
     
     // Test case for URI parsing
@@ -646,7 +950,11 @@ Suite *http_parser_suite(void)
     tcase_add_test(tc_uri, test_parse_uri_encoded);
     tcase_add_test(tc_uri, test_parse_uri_dynamic_similar_name);
     tcase_add_test(tc_uri, test_parse_uri_complex_query);
+    tcase_add_test(tc_uri, test_parse_uri_escaped_question_mark);
+    tcase_add_test(tc_uri, test_router_match);
+    tcase_add_test(tc_uri, test_routes_from_config);
     tcase_add_test(tc_uri, test_parse_uri_root);
+    tcase_add_test(tc_uri, test_normalize_path);
     suite_add_tcase(s, tc_uri);
     
     // Test case for HTTP request parsing
@@ -659,8 +967,19 @@ Suite *http_parser_suite(void)
     tcase_add_test(tc_request, test_parse_http_request_malformed_request_line);
     tcase_add_test(tc_request, test_parse_http_request_no_crlf);
     tcase_add_test(tc_request, test_parse_http_request_invalid_uri_path);
+    tcase_add_test(tc_request, test_parse_http_request_control_characters);
     suite_add_tcase(s, tc_request);
     
+    // Test case for request header parsing
+    TCase *tc_headers = tcase_create("Header Parsing");
+    tcase_add_checked_fixture(tc_headers, setup, teardown);
+    tcase_add_test(tc_headers, test_parse_headers_known);
+    tcase_add_test(tc_headers, test_parse_headers_other);
+    tcase_add_test(tc_headers, test_parse_headers_malformed);
+    tcase_add_test(tc_headers, test_scan_kernels_agree);
+    tcase_add_test(tc_headers, test_scan_kernels_agree_long);
+    suite_add_tcase(s, tc_headers);
+    
     // Test case for request initialization and cleanup
     TCase *tc_lifecycle = tcase_create("Request Lifecycle");
     tcase_add_test(tc_lifecycle, test_initialize_destroy_request);
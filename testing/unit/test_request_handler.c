@@ -1,5 +1,5 @@
 // compilation command for now - 
-// clang -std=c99 -Wall -Wextra -Werror -g -O0 -I./include -I./testing $(pkg-config --cflags check) testing/unit/test_request_handler.c src/request_handler.c src/http_parser.c src/config.c src/rio.c $(pkg-config --libs check) -pthread -lm -o executables/test_request_handler
+// clang -std=c99 -Wall -Wextra -Werror -g -O0 -I./include -I./testing $(pkg-config --cflags check) testing/unit/test_request_handler.c src/request_handler.c src/http_parser.c src/config.c src/rio.c src/net.c src/metrics.c src/timer_wheel.c src/logger.c src/scan.c src/mime.c src/mime_table.c src/router.c src/path_cache.c $(pkg-config --libs check) -pthread -lm -o executables/test_request_handler
 #include <check.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -17,6 +17,7 @@
 #include "http_parser.h"
 #include "config.h"
 #include "rio.h"
+#include "path_cache.h"
 
 /* Test fixtures */
 static http_request request;
@@ -228,7 +229,7 @@ END_TEST
 /* ===== Tests for get_absolute_path ===== */
 START_TEST(test_get_absolute_path_normal)
 {
-    request.path = strdup("/static/text/readme.txt");
+    request.path = "/static/text/readme.txt"; // points into the request buffer in the server, never freed
     
     char *abs_path = get_absolute_path(&request, &config);
     ck_assert_ptr_nonnull(abs_path);
@@ -240,7 +241,7 @@ END_TEST
 
 START_TEST(test_get_absolute_path_root)
 {
-    request.path = strdup("/");
+    request.path = "/";
     
     char *abs_path = get_absolute_path(&request, &config);
     ck_assert_ptr_nonnull(abs_path);
@@ -253,7 +254,7 @@ END_TEST
 START_TEST(test_get_absolute_path_special_chars)
 {
     // Test with the file that has spaces and special characters
-    request.path = strdup("/static/text/file with spaces & symbols #@!.txt");
+    request.path = "/static/text/file with spaces & symbols #@!.txt";
     
     char *abs_path = get_absolute_path(&request, &config);
     ck_assert_ptr_nonnull(abs_path);
@@ -266,7 +267,7 @@ END_TEST
 START_TEST(test_get_absolute_path_long_filename)
 {
     // Test with the extremely long filename
-    request.path = strdup("/static/text/aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa.txt");
+    request.path = "/static/text/aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa.txt";
     
     char *abs_path = get_absolute_path(&request, &config);
     ck_assert_ptr_nonnull(abs_path);
@@ -282,13 +283,162 @@ START_TEST(test_get_absolute_path_too_long)
     memset(long_path, 'a', PATH_MAX - 1);
     long_path[0] = '/';
     long_path[PATH_MAX - 1] = '\0';
-    request.path = strdup(long_path);
+    request.path = long_path;
     
     char *abs_path = get_absolute_path(&request, &config);
     ck_assert_ptr_null(abs_path);
 }
 END_TEST
 
+START_TEST(test_path_cache_lookup_store)
+{
+    char resolved[PATH_MAX];
+    struct stat st, cached;
+    ck_assert_int_eq(stat("./public/static/text/readme.txt", &st), 0);
+    
+    // Disabled until initialized: the path is still resolved
+    ck_assert_int_eq(path_cache_lookup("./public/", "/static/text/readme.txt", resolved, sizeof(resolved), &cached), 0);
+    ck_assert_str_eq(resolved, "./public/static/text/readme.txt");
+    
+    ck_assert_int_eq(path_cache_init(16, 60, 60), 0);
+    ck_assert_int_eq(path_cache_lookup("./public/", "/static/text/readme.txt", resolved, sizeof(resolved), &cached), 0);
+    path_cache_store(resolved, &st);
+    ck_assert_int_eq(path_cache_lookup("./public/", "/static/text/readme.txt", resolved, sizeof(resolved), &cached), 1);
+    ck_assert_int_eq(cached.st_size, st.st_size);
+    ck_assert_int_eq(cached.st_ino, st.st_ino);
+    
+    // The root is part of the key, and the result must fit
+    ck_assert_int_eq(path_cache_lookup("./other/", "/static/text/readme.txt", resolved, sizeof(resolved), &cached), 0);
+    ck_assert_int_eq(path_cache_lookup("./public/", "/static/text/readme.txt", resolved, 16, &cached), -1);
+    
+    // Every file served through the cache is stored once and then hit
+    request.path = "/static/text/readme.txt";
+    for (int i = 0; i < 2; ++i) {
+        int fd = open_static_file(&request, &response, &config);
+        ck_assert_int_ge(fd, 0);
+        ck_assert_int_eq(response.content_length, (size_t) st.st_size);
+        close(fd);
+    }
+
+    // A stale entry only resolves the path, the headers come from the opened file and refresh the entry
+    struct stat stale = st;
+    stale.st_size += 4096;
+    path_cache_store(resolved, &stale);
+    int fd = open_static_file(&request, &response, &config);
+    ck_assert_int_ge(fd, 0);
+    ck_assert_int_eq(response.content_length, (size_t) st.st_size);
+    close(fd);
+    ck_assert_int_eq(path_cache_lookup("./public/", "/static/text/readme.txt", resolved, sizeof(resolved), &cached), 1);
+    ck_assert_int_eq(cached.st_size, st.st_size);
+
+    // Missing files are cached as such, the second 404 needs no open
+    request.path = "/static/text/not_there.txt";
+    for (int i = 0; i < 2; ++i) {
+        ck_assert_int_eq(open_static_file(&request, &response, &config), -1);
+        ck_assert_int_eq(response.status_code, 404);
+    }
+    ck_assert_int_eq(path_cache_lookup("./public/", "/static/text/not_there.txt", resolved, sizeof(resolved), &cached),
+                     PATH_CACHE_MISSING);
+    path_cache_destroy();
+    ck_assert_int_eq(path_cache_lookup("./public/", "/static/text/readme.txt", resolved, sizeof(resolved), &cached), 0);
+}
+END_TEST
+
+START_TEST(test_path_cache_configure)
+{
+    char resolved[PATH_MAX], stats[512];
+    struct stat st, cached;
+    ck_assert_int_eq(stat("./public/static/text/readme.txt", &st), 0);
+    ck_assert_int_eq(path_cache_init(16, 60, 0), 0);
+    path_cache_lookup("./public/", "/static/text/readme.txt", resolved, sizeof(resolved), &cached);
+    path_cache_store(resolved, &st);
+
+    // New TTLs keep the entries, missing paths are cached from now on
+    ck_assert_int_eq(path_cache_configure(16, 30, 5), 0);
+    ck_assert_int_eq(path_cache_lookup("./public/", "/static/text/readme.txt", resolved, sizeof(resolved), &cached),
+                     PATH_CACHE_FOUND);
+    path_cache_lookup("./public/", "/static/text/not_there.txt", resolved, sizeof(resolved), &cached);
+    path_cache_store_missing(resolved);
+    ck_assert_int_eq(path_cache_lookup("./public/", "/static/text/not_there.txt", resolved, sizeof(resolved), &cached),
+                     PATH_CACHE_MISSING);
+
+    // A new size starts empty
+    ck_assert_int_eq(path_cache_configure(64, 30, 5), 0);
+    ck_assert_int_eq(path_cache_lookup("./public/", "/static/text/readme.txt", resolved, sizeof(resolved), &cached),
+                     PATH_CACHE_MISS);
+    path_cache_render_stats(stats, sizeof(stats), NULL);
+    ck_assert_ptr_nonnull(strstr(stats, "entries: 64\n"));
+
+    // 0 entries disables it, stores are dropped
+    ck_assert_int_eq(path_cache_configure(0, 30, 5), 0);
+    path_cache_store(resolved, &st);
+    ck_assert_int_eq(path_cache_lookup("./public/", "/static/text/readme.txt", resolved, sizeof(resolved), &cached),
+                     PATH_CACHE_MISS);
+    path_cache_destroy();
+}
+END_TEST
+
+#ifdef __linux__
+/*
+Waits up to a second for the watch thread to notice a change, returns the last lookup result
+*/
+static int lookup_until(const char *root, const char *path, int expected) {
+    char resolved[PATH_MAX];
+    struct stat st;
+    int result = -1;
+    for (int i = 0; i < 100 && (result = path_cache_lookup(root, path, resolved, sizeof(resolved), &st)) != expected; ++i) {
+        usleep(10000);
+    }
+    return result;
+}
+
+START_TEST(test_path_cache_watch)
+{
+    char root[] = "/tmp/path_cache_testXXXXXX/";
+    root[strlen(root) - 1] = '\0';
+    ck_assert_ptr_nonnull(mkdtemp(root));
+    root[strlen(root)] = '/';
+    char file[PATH_MAX];
+    snprintf(file, sizeof(file), "%snew.txt", root);
+    
+    ck_assert_int_eq(path_cache_init(16, 60, 60), 0);
+    ck_assert_int_eq(path_cache_watch(root, true), 0);
+    
+    // Never existed: the bloom filter answers without an entry
+    char resolved[PATH_MAX];
+    struct stat st;
+    ck_assert_int_eq(path_cache_lookup(root, "/new.txt", resolved, sizeof(resolved), &st), PATH_CACHE_MISSING);
+    
+    // Creating the file drops the answer
+    int fd = open(file, O_CREAT | O_WRONLY, 0644);
+    ck_assert_int_ge(fd, 0);
+    close(fd);
+    ck_assert_int_eq(lookup_until(root, "/new.txt", PATH_CACHE_MISS), PATH_CACHE_MISS);
+    ck_assert_int_eq(stat(file, &st), 0);
+    path_cache_store(resolved, &st);
+    ck_assert_int_eq(lookup_until(root, "/new.txt", PATH_CACHE_FOUND), PATH_CACHE_FOUND);
+    
+    // Writing to it drops the entry while the writer still holds it open
+    fd = open(file, O_WRONLY | O_APPEND);
+    ck_assert_int_ge(fd, 0);
+    ck_assert_int_eq(write(fd, "x", 1), 1);
+    ck_assert_int_eq(lookup_until(root, "/new.txt", PATH_CACHE_MISS), PATH_CACHE_MISS);
+    close(fd);
+    usleep(50000); // the close drops the entries once more
+    
+    // Removing it drops the entry long before it would expire, the failed open then caches the miss
+    unlink(file);
+    ck_assert_int_eq(lookup_until(root, "/new.txt", PATH_CACHE_MISS), PATH_CACHE_MISS);
+    path_cache_store_missing(resolved);
+    ck_assert_int_eq(path_cache_lookup(root, "/new.txt", resolved, sizeof(resolved), &st), PATH_CACHE_MISSING);
+    
+    path_cache_destroy();
+    root[strlen(root) - 1] = '\0';
+    rmdir(root);
+}
+END_TEST
+#endif
+
 /* ===== Tests for set_content_headers ===== */
 START_TEST(test_set_content_headers_text_file)
 {
@@ -302,7 +452,10 @@ START_TEST(test_set_content_headers_text_file)
     ck_assert_int_eq(result, 0);
     
     // Verify headers were set
-    ck_assert_str_eq(response.content_type, "text/plain");
+    ck_assert_ptr_nonnull(response.mime);
+    ck_assert_str_eq(response.mime->name, "text/plain");
+    ck_assert_str_eq(response.mime->header, "Content-Type: text/plain\r\n");
+    ck_assert_uint_eq(response.mime->header_length, strlen(response.mime->header));
     ck_assert_ptr_nonnull(response.last_modified);
     ck_assert(strstr(response.last_modified, "GMT") != NULL);
     ck_assert_ptr_null(response.content_encoding);
@@ -356,7 +509,7 @@ START_TEST(test_set_content_headers_all_mime_types)
         
         int result = set_content_headers(fd, &request, &response, test_files[i].path);
         ck_assert_int_eq(result, 0);
-        ck_assert_str_eq(response.content_type, test_files[i].expected);
+        ck_assert_str_eq(response.mime->name, test_files[i].expected);
         
         // Clean up for next iteration
         free(response.last_modified);
@@ -457,7 +610,7 @@ END_TEST
 START_TEST(test_serve_static_small_text_file)
 {
     // Use existing readme.txt
-    request.path = strdup("/static/text/readme.txt");
+    request.path = "/static/text/readme.txt";
     request.mime_type = TEXT_PLAIN;
     request.is_dynamic = false;
     
@@ -481,7 +634,7 @@ END_TEST
 START_TEST(test_serve_static_html_file)
 {
     // Use existing index.html
-    request.path = strdup("/static/html/index.html");
+    request.path = "/static/html/index.html";
     request.mime_type = TEXT_HTML;
     request.is_dynamic = false;
     
@@ -505,7 +658,7 @@ END_TEST
 START_TEST(test_serve_static_binary_file)
 {
     // Use our created binary file
-    request.path = strdup("/static/misc/binary.dat");
+    request.path = "/static/misc/binary.dat";
     request.mime_type = APPLICATION_OCTET_STREAM;
     request.is_dynamic = false;
     
@@ -539,7 +692,7 @@ END_TEST
 START_TEST(test_serve_static_large_file)
 {
     // Use the 10KB file
-    request.path = strdup("/static/text/atleast_10Kb_file.txt");
+    request.path = "/static/text/atleast_10Kb_file.txt";
     request.mime_type = TEXT_PLAIN;
     request.is_dynamic = false;
     
@@ -563,7 +716,7 @@ END_TEST
 START_TEST(test_serve_static_special_filename)
 {
     // Use file with special characters
-    request.path = strdup("/static/text/file with spaces & symbols #@!.txt");
+    request.path = "/static/text/file with spaces & symbols #@!.txt";
     request.mime_type = TEXT_PLAIN;
     request.is_dynamic = false;
     
@@ -584,7 +737,7 @@ END_TEST
 
 START_TEST(test_serve_static_nonexistent_file)
 {
-    request.path = strdup("/static/text/nonexistent.txt");
+    request.path = "/static/text/nonexistent.txt";
     request.mime_type = TEXT_PLAIN;
     request.is_dynamic = false;
     
@@ -598,7 +751,7 @@ END_TEST
 START_TEST(test_serve_static_permission_denied)
 {
     // Use our created file with no read permissions
-    request.path = strdup("/static/text/noread.txt");
+    request.path = "/static/text/noread.txt";
     request.mime_type = TEXT_PLAIN;
     request.is_dynamic = false;
     
@@ -613,7 +766,7 @@ END_TEST
 START_TEST(test_serve_dynamic_hello_cgi)
 {
     // Use existing hello.cgi
-    request.path = strdup("/cgi-bin/hello.cgi");
+    request.path = "/cgi-bin/hello.cgi";
     request.is_dynamic = true;
     request.param_count = 0;
     
@@ -637,15 +790,10 @@ END_TEST
 START_TEST(test_serve_dynamic_with_parameters)
 {
     // Use our params_test.cgi
-    request.path = strdup("/cgi-bin/params_test.cgi");
+    request.path = "/cgi-bin/params_test.cgi";
     request.is_dynamic = true;
-    request.param_count = 2;
-    request.param_names = malloc(2 * sizeof(char*));
-    request.param_values = malloc(2 * sizeof(char*));
-    request.param_names[0] = strdup("name");
-    request.param_values[0] = strdup("John");
-    request.param_names[1] = strdup("age");
-    request.param_values[1] = strdup("25");
+    char query[] = "name=John&age=25";
+    request.query = (str_view){ query, strlen(query) };
     
     int result = serve_dynamic(&request, &response, pipe_fds[1], &config);
     ck_assert_int_eq(result, 0);
@@ -666,7 +814,7 @@ END_TEST
 START_TEST(test_serve_dynamic_cgi_with_status)
 {
     // Use our status.cgi that returns 404
-    request.path = strdup("/cgi-bin/status.cgi");
+    request.path = "/cgi-bin/status.cgi";
     request.is_dynamic = true;
     request.param_count = 0;
     
@@ -689,7 +837,7 @@ END_TEST
 START_TEST(test_serve_dynamic_cgi_binary_output)
 {
     // Use our binary.cgi
-    request.path = strdup("/cgi-bin/binary.cgi");
+    request.path = "/cgi-bin/binary.cgi";
     request.is_dynamic = true;
     request.param_count = 0;
     
@@ -721,7 +869,7 @@ END_TEST
 
 START_TEST(test_serve_dynamic_nonexistent_cgi)
 {
-    request.path = strdup("/cgi-bin/nonexistent.cgi");
+    request.path = "/cgi-bin/nonexistent.cgi";
     request.is_dynamic = true;
     request.param_count = 0;
     
@@ -735,7 +883,7 @@ END_TEST
 START_TEST(test_serve_dynamic_non_executable_cgi)
 {
     // Use our noexec.cgi
-    request.path = strdup("/cgi-bin/noexec.cgi");
+    request.path = "/cgi-bin/noexec.cgi";
     request.is_dynamic = true;
     request.param_count = 0;
     
@@ -749,7 +897,7 @@ END_TEST
 START_TEST(test_serve_dynamic_failing_cgi)
 {
     // Use our fail.cgi
-    request.path = strdup("/cgi-bin/fail.cgi");
+    request.path = "/cgi-bin/fail.cgi";
     request.is_dynamic = true;
     request.param_count = 0;
     
@@ -763,7 +911,7 @@ END_TEST
 /* ===== Tests for execute_request ===== */
 START_TEST(test_execute_request_static_success)
 {
-    request.path = strdup("/static/text/readme.txt");
+    request.path = "/static/text/readme.txt";
     request.mime_type = TEXT_PLAIN;
     request.is_dynamic = false;
     
@@ -782,7 +930,7 @@ END_TEST
 
 START_TEST(test_execute_request_static_error_handled)
 {
-    request.path = strdup("/static/text/nonexistent.txt");
+    request.path = "/static/text/nonexistent.txt";
     request.mime_type = TEXT_PLAIN;
     request.is_dynamic = false;
     
@@ -799,9 +947,97 @@ START_TEST(test_execute_request_static_error_handled)
 }
 END_TEST
 
+START_TEST(test_execute_request_redirect)
+{
+    route_table *table = router_create();
+    ck_assert_int_eq(router_add(table, "/old/*", "redirect https://example.com/new/ 302 cache=no-store"), 0);
+    ck_assert_int_eq(router_compile(table), 0);
+    request.path = "/old/docs/page.html";
+    request.route = router_match(table, request.path);
+    ck_assert_ptr_nonnull(request.route);
+
+    ck_assert_int_eq(execute_request(&request, pipe_fds[1], &config), 0);
+    close(pipe_fds[1]);
+    router_destroy(table);
+
+    char *output = read_pipe_output();
+    ck_assert_ptr_nonnull(output);
+    ck_assert(strncmp(output, "HTTP/1.1 302 Found\r\n", 20) == 0);
+    // The rest of the path after the prefix is kept
+    ck_assert(strstr(output, "Location: https://example.com/new/docs/page.html\r\n") != NULL);
+    ck_assert(strstr(output, "Cache-Control: no-store\r\n") != NULL);
+    ck_assert(strstr(output, "Content-Length: 0\r\n\r\n") != NULL);
+    free(output);
+}
+END_TEST
+
+START_TEST(test_execute_request_redirect_escaped)
+{
+    route_table *table = router_create();
+    ck_assert_int_eq(router_add(table, "/old/*", "redirect /new/ 301"), 0);
+    ck_assert_int_eq(router_compile(table), 0);
+    // As parse_uri leaves them: the path decoded, the query as it was sent
+    request.path = "/old/a b/caf\xc3\xa9?+%.html";
+    // A control byte in the query can only come from a caller that skipped the parser, it is still encoded
+    request.query = (str_view) { "q=a%20b&lang=fr\r\nX:1", 20 };
+    request.route = router_match(table, request.path);
+    ck_assert_ptr_nonnull(request.route);
+
+    ck_assert_int_eq(execute_request(&request, pipe_fds[1], &config), 0);
+    close(pipe_fds[1]);
+    router_destroy(table);
+
+    char *output = read_pipe_output();
+    ck_assert_ptr_nonnull(output);
+    ck_assert(strncmp(output, "HTTP/1.1 301 Moved Permanently\r\n", 32) == 0);
+    ck_assert(strstr(output, "Location: /new/a%20b/caf%C3%A9%3F%2B%25.html?q=a%20b&lang=fr%0D%0AX:1\r\n") != NULL);
+    ck_assert(strstr(output, "\nX:1") == NULL);
+    free(output);
+}
+END_TEST
+
+START_TEST(test_send_error_response_canned)
+{
+    ck_assert_int_eq(send_error_response(pipe_fds[1], 404), 0);
+    close(pipe_fds[1]);
+
+    char *output = read_pipe_output();
+    ck_assert_ptr_nonnull(output);
+    ck_assert(strncmp(output, "HTTP/1.1 404 Not Found\r\nDate: ", 30) == 0);
+    ck_assert(strstr(output, " GMT\r\nServer: ") != NULL); // the Date placeholder was replaced
+    ck_assert(strstr(output, "Connection: close\r\n") != NULL);
+
+    // Content-Length matches the HTML body after the blank line
+    const char *body = strstr(output, "\r\n\r\n");
+    ck_assert_ptr_nonnull(body);
+    body += 4;
+    size_t content_length = 0;
+    ck_assert_int_eq(sscanf(strstr(output, "Content-Length: "), "Content-Length: %zu", &content_length), 1);
+    ck_assert_uint_eq(content_length, strlen(body));
+    ck_assert(strstr(body, "<h1>404 Not Found</h1>") != NULL);
+    free(output);
+}
+END_TEST
+
+START_TEST(test_format_error_response)
+{
+    char canned[512], rendered[512];
+    ssize_t length = format_error_response(503, canned, sizeof(canned));
+    ck_assert_int_gt(length, 0);
+    ck_assert(strncmp(canned, "HTTP/1.1 503 Service Unavailable\r\n", 34) == 0);
+
+    // Codes without a canned response are rendered the same way
+    length = format_error_response(418, rendered, sizeof(rendered));
+    ck_assert_int_gt(length, 0);
+    ck_assert(strncmp(rendered, "HTTP/1.1 418 ", 13) == 0);
+
+    ck_assert_int_eq(format_error_response(404, canned, 64), -1);
+}
+END_TEST
+
 START_TEST(test_execute_request_dynamic_success)
 {
-    request.path = strdup("/cgi-bin/hello.cgi");
+    request.path = "/cgi-bin/hello.cgi";
     request.is_dynamic = true;
     request.param_count = 0;
     
@@ -822,7 +1058,7 @@ END_TEST
 START_TEST(test_serve_static_no_extension)
 {
     // Use the file with no extension
-    request.path = strdup("/static/misc/no_extension");
+    request.path = "/static/misc/no_extension";
     request.mime_type = TEXT_PLAIN;
     request.is_dynamic = false;
     
@@ -843,7 +1079,7 @@ END_TEST
 START_TEST(test_serve_static_css_file)
 {
     // Test CSS file
-    request.path = strdup("/static/css/styles.css");
+    request.path = "/static/css/styles.css";
     request.mime_type = TEXT_CSS;
     request.is_dynamic = false;
     
@@ -864,7 +1100,7 @@ END_TEST
 START_TEST(test_serve_static_javascript_file)
 {
     // Test JavaScript file
-    request.path = strdup("/static/js/script.js");
+    request.path = "/static/js/script.js";
     request.mime_type = APPLICATION_JAVASCRIPT;
     request.is_dynamic = false;
     
@@ -903,6 +1139,11 @@ Suite *request_handler_suite(void)
     tcase_add_test(tc_path, test_get_absolute_path_special_chars);
     tcase_add_test(tc_path, test_get_absolute_path_long_filename);
     tcase_add_test(tc_path, test_get_absolute_path_too_long);
+    tcase_add_test(tc_path, test_path_cache_lookup_store);
+    tcase_add_test(tc_path, test_path_cache_configure);
+#ifdef __linux__
+    tcase_add_test(tc_path, test_path_cache_watch);
+#endif
     suite_add_tcase(s, tc_path);
     
     // Content headers tests
@@ -955,6 +1196,10 @@ Suite *request_handler_suite(void)
     tcase_add_test(tc_execute, test_execute_request_static_success);
     tcase_add_test(tc_execute, test_execute_request_static_error_handled);
     tcase_add_test(tc_execute, test_execute_request_dynamic_success);
+    tcase_add_test(tc_execute, test_execute_request_redirect);
+    tcase_add_test(tc_execute, test_execute_request_redirect_escaped);
+    tcase_add_test(tc_execute, test_send_error_response_canned);
+    tcase_add_test(tc_execute, test_format_error_response);
     suite_add_tcase(s, tc_execute);
     
     return s;
@@ -0,0 +1,125 @@
+// compilation command for now
+// clang -std=c99 -Wall -Wextra -Werror -g -O0 -I./include -I./testing $(pkg-config --cflags check) testing/unit/test_thread_pool.c src/thread_pool.c src/metrics.c src/logger.c $(pkg-config --libs check) -pthread -lm -o executables/test_thread_pool
+#include <check.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "thread_pool.h"
+
+/*
+Every item is a slot of runs, the handler counts how often it ran. Parents are submitted from outside
+the pool and go through the inboxes, each parent submits its children from the worker running it, so
+they land on that worker's deque and idle workers have to steal them. The items do no work, so the
+owner and the thieves race for the last items of a deque as often as possible
+*/
+#define SUBMITTERS         4
+#define PARENTS_PER_THREAD 2000
+#define CHILDREN           64
+#define PARENTS            (SUBMITTERS * PARENTS_PER_THREAD)
+#define TASKS              (PARENTS * (1 + CHILDREN))
+
+static unsigned int runs[TASKS];
+static thread_pool *pool;
+
+static void run_task(void *item) {
+    size_t index = (size_t)((unsigned int *)item - runs);
+    __atomic_add_fetch(&runs[index], 1, __ATOMIC_RELAXED);
+    if (index >= PARENTS) {
+        return;
+    }
+    for (size_t child = 0; child < CHILDREN; ++child) {
+        void *child_item = &runs[PARENTS + index * CHILDREN + child];
+        if (thread_pool_submit(pool, child_item) < 0) {
+            run_task(child_item);
+        }
+    }
+}
+
+static void submit_all(size_t first, size_t count) {
+    for (size_t i = first; i < first + count; ++i) {
+        while (thread_pool_submit(pool, &runs[i]) < 0) {
+            sched_yield();
+        }
+    }
+}
+
+static void *submitter(void *arg) {
+    size_t thread = (size_t)(uintptr_t)arg;
+    submit_all(thread * PARENTS_PER_THREAD, PARENTS_PER_THREAD);
+    return NULL;
+}
+
+static void setup(void) {
+    memset(runs, 0, sizeof(runs));
+}
+
+static void assert_each_ran_once(void) {
+    for (size_t i = 0; i < TASKS; ++i) {
+        ck_assert_msg(runs[i] == 1, "task %zu ran %u times", i, runs[i]);
+    }
+}
+
+START_TEST(test_pool_runs_every_item_once)
+{
+    pool = thread_pool_create(8, run_task, NULL);
+    ck_assert_ptr_nonnull(pool);
+
+    pthread_t threads[SUBMITTERS];
+    for (size_t i = 0; i < SUBMITTERS; ++i) {
+        ck_assert_int_eq(pthread_create(&threads[i], NULL, submitter, (void *)(uintptr_t)i), 0);
+    }
+    for (size_t i = 0; i < SUBMITTERS; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    // Waits for every queued item
+    thread_pool_destroy(pool);
+    assert_each_ran_once();
+}
+END_TEST
+
+START_TEST(test_pool_resize_under_load)
+{
+    pool = thread_pool_create(2, run_task, NULL);
+    ck_assert_ptr_nonnull(pool);
+
+    // Items queued to workers that retire are finished by them or taken by their peers
+    static const unsigned int sizes[] = { 8, 1, 6, 3, 2, 4 };
+    size_t steps = sizeof(sizes) / sizeof(sizes[0]);
+    size_t batch = PARENTS / steps;
+    for (size_t i = 0; i < steps; ++i) {
+        submit_all(i * batch, i + 1 < steps ? batch : PARENTS - i * batch);
+        ck_assert_int_eq(thread_pool_resize(pool, sizes[i]), 0);
+    }
+    thread_pool_destroy(pool);
+    assert_each_ran_once();
+}
+END_TEST
+
+Suite *thread_pool_suite(void)
+{
+    Suite *s = suite_create("Thread Pool");
+
+    TCase *tc_stress = tcase_create("Stress");
+    tcase_add_checked_fixture(tc_stress, setup, NULL);
+    tcase_set_timeout(tc_stress, 30);
+    tcase_add_test(tc_stress, test_pool_runs_every_item_once);
+    tcase_add_test(tc_stress, test_pool_resize_under_load);
+    suite_add_tcase(s, tc_stress);
+
+    return s;
+}
+
+int main(void)
+{
+    Suite *s = thread_pool_suite();
+    SRunner *sr = srunner_create(s);
+
+    // Use CK_VERBOSE for detailed output, CK_NORMAL for normal output
+    srunner_run_all(sr, CK_VERBOSE);
+    int number_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}